@@ -0,0 +1,241 @@
+/**
+    Benchmarks each stage of the pipeline on its own, over generated
+    programs of 10 to 10^6 instructions. Every stage gets its input
+    prepared outside the timed loop, reports instructions/s as its item
+    throughput and counts heap allocations per iteration through the
+    replaced global operator new below.
+*/
+
+#include "ion/CFG.h"
+#include "ion/Cleanup.h"
+#include "ion/GraphColoring.h"
+#include "ion/InterferenceGraph.h"
+#include "ion/Liveness.h"
+#include "ion/Reader.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Target.h"
+#include "ion/Writer.h"
+#include "utils/h/IRGenerator.h"
+#include "utils/h/Parser.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <new>
+
+namespace {
+std::atomic<size_t> gAllocations{0};
+}
+
+void* operator new(size_t size) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+/* Options the benchmarks scale with the instruction count */
+GeneratorOptions optionsFor(size_t instructions) {
+    GeneratorOptions opts;
+    opts.seed = 42;
+    opts.instructions = instructions;
+    opts.loopDepth = 3;
+    opts.vregs = static_cast<int>(std::clamp<size_t>(instructions / 8, 16, 4096));
+    opts.pressure = 12;
+    opts.copyDensity = 0.15;
+    return opts;
+}
+
+// Chain: no loops and no diamonds, so no block has two predecessors
+enum class Shape { Structured, Chain };
+
+/* Generated once per size and shape and kept for the whole run */
+const std::string& programFile(size_t instructions, Shape shape = Shape::Structured) {
+    static std::map<std::pair<size_t, Shape>, std::string> files;
+    auto it = files.find({instructions, shape});
+    if (it != files.end()) return it->second;
+
+    GeneratorOptions opts = optionsFor(instructions);
+    std::string name = "ion_bench_" + std::to_string(instructions);
+    if (shape == Shape::Chain) {
+        opts.loopDepth = 0;
+        opts.diamonds = false;
+        name = "ion_bench_chain_" + std::to_string(instructions);
+    }
+    std::string path = (std::filesystem::temp_directory_path() / (name + ".ion")).string();
+    generateIRFile(opts, path);
+    return files.emplace(std::pair{instructions, shape}, path).first->second;
+}
+
+Function readProgram(size_t instructions, Shape shape = Shape::Structured) {
+    Reader reader;
+    return reader.BuildCFG(programFile(instructions, shape));
+}
+
+size_t countInstructions(const Function& fn) {
+    size_t n = 0;
+    for (const auto& block : fn.blocks)
+        n += block->instructions.size();
+    return n;
+}
+
+/* Runs body once per iteration and reports allocations and throughput */
+template <typename Body>
+void measure(benchmark::State& state, size_t items, Body&& body) {
+    size_t before = gAllocations.load(std::memory_order_relaxed);
+    for (auto _ : state)
+        body();
+    size_t allocs = gAllocations.load(std::memory_order_relaxed) - before;
+    state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocs), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * items));
+}
+
+/*
+    For stages that rewrite the function: every iteration reads a fresh
+    copy with the timer paused, and its allocations are not counted.
+**/
+template <typename Body>
+void measureOnFreshCopy(benchmark::State& state, Body&& body, Shape shape = Shape::Structured) {
+    size_t n = static_cast<size_t>(state.range(0));
+    size_t items = countInstructions(readProgram(n, shape));
+    size_t before = gAllocations.load(std::memory_order_relaxed);
+    size_t excluded = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        size_t mark = gAllocations.load(std::memory_order_relaxed);
+        Function fn = readProgram(n, shape);
+        excluded += gAllocations.load(std::memory_order_relaxed) - mark;
+        state.ResumeTiming();
+        body(fn);
+    }
+    size_t allocs = gAllocations.load(std::memory_order_relaxed) - before - excluded;
+    state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocs), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * items));
+}
+
+std::vector<uint8_t> classesOf(const Function& fn, const TargetDesc& target) {
+    int maxID = 0;
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.def) maxID = std::max(maxID, instr.def->id);
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use)) maxID = std::max(maxID, reg->id);
+            }
+        }
+    }
+    std::vector<uint8_t> regClass(maxID + 1);
+    for (int v = 0; v <= maxID; ++v) regClass[v] = target.classOf(v);
+    return regClass;
+}
+
+/* The parser alone, over the text in memory */
+void BM_Parse(benchmark::State& state) {
+    size_t n = static_cast<size_t>(state.range(0));
+    std::ifstream file(programFile(n), std::ios::binary);
+    std::string source{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    measure(state, countInstructions(readProgram(n)), [&] {
+        InstrParser parser;
+        parser.parseText(source, [](const ParsedInstr& parsed) { benchmark::DoNotOptimize(parsed); });
+    });
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+}
+
+void BM_BuildCFG(benchmark::State& state) {
+    size_t n = static_cast<size_t>(state.range(0));
+    const std::string& path = programFile(n);
+    size_t items = countInstructions(readProgram(n));
+    measure(state, items, [&] {
+        Reader reader;
+        benchmark::DoNotOptimize(reader.BuildCFG(path));
+    });
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * std::filesystem::file_size(path)));
+}
+
+void BM_ComputeUseDef(benchmark::State& state) {
+    Function fn = readProgram(static_cast<size_t>(state.range(0)));
+    measure(state, countInstructions(fn), [&] { benchmark::DoNotOptimize(computeUseDef(fn)); });
+}
+
+void BM_Liveness(benchmark::State& state) {
+    Function fn = readProgram(static_cast<size_t>(state.range(0)));
+    LivenessAnalysis la;
+    measure(state, countInstructions(fn), [&] { benchmark::DoNotOptimize(la.analyse(fn)); });
+}
+
+void BM_InterferenceGraph(benchmark::State& state) {
+    Function fn = readProgram(static_cast<size_t>(state.range(0)));
+    LivenessResult lr = LivenessAnalysis().analyse(fn);
+    std::vector<uint8_t> regClass = classesOf(fn, targets::RISC16);
+    std::vector<unsigned> classBank{0};
+    measure(state, countInstructions(fn), [&] {
+        benchmark::DoNotOptimize(buildInterferenceGraph(fn, lr, regClass, classBank, 0));
+    });
+}
+
+void BM_Coloring(benchmark::State& state) {
+    Function fn = readProgram(static_cast<size_t>(state.range(0)));
+    LivenessResult lr = LivenessAnalysis().analyse(fn);
+    std::vector<uint8_t> regClass = classesOf(fn, targets::RISC16);
+    InterferenceGraph graph = buildInterferenceGraph(fn, lr, regClass, {0}, 0);
+    std::vector<float> cost(regClass.size(), 1.0f);
+    measure(state, countInstructions(fn), [&] {
+        benchmark::DoNotOptimize(colorGraph(graph, targets::RISC16.allocatable(0), 0, cost));
+    });
+}
+
+void BM_Cleanup(benchmark::State& state) {
+    measureOnFreshCopy(state, [](Function& fn) { benchmark::DoNotOptimize(cleanupFunction(fn)); });
+}
+
+void BM_Allocate(benchmark::State& state) {
+    measureOnFreshCopy(state, [](Function& fn) {
+        benchmark::DoNotOptimize(RegisterAllocator(targets::RISC16).allocate(fn));
+    });
+}
+
+/* A chain of blocks, which goes to the local allocator */
+void BM_AllocateChain(benchmark::State& state) {
+    measureOnFreshCopy(state, [](Function& fn) {
+        benchmark::DoNotOptimize(RegisterAllocator(targets::RISC16).allocate(fn));
+    }, Shape::Chain);
+}
+
+void BM_Write(benchmark::State& state) {
+    Function fn = readProgram(static_cast<size_t>(state.range(0)));
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    std::string out;
+    measure(state, countInstructions(fn), [&] {
+        out.clear();
+        Writer writer(out);
+        writer.write(fn, alloc, targets::RISC16);
+    });
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * out.size()));
+}
+
+void sizes(benchmark::internal::Benchmark* b) {
+    b->RangeMultiplier(10)->Range(10, 1'000'000)->Unit(benchmark::kMicrosecond);
+}
+
+}   // namespace
+
+BENCHMARK(BM_Parse)->Apply(sizes);
+BENCHMARK(BM_BuildCFG)->Apply(sizes);
+BENCHMARK(BM_ComputeUseDef)->Apply(sizes);
+BENCHMARK(BM_Liveness)->Apply(sizes);
+BENCHMARK(BM_InterferenceGraph)->Apply(sizes);
+BENCHMARK(BM_Coloring)->Apply(sizes);
+BENCHMARK(BM_Cleanup)->Apply(sizes);
+BENCHMARK(BM_Allocate)->Apply(sizes);
+BENCHMARK(BM_AllocateChain)->Apply(sizes);
+BENCHMARK(BM_Write)->Apply(sizes);
+
+BENCHMARK_MAIN();
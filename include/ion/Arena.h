@@ -0,0 +1,80 @@
+/**
+    Per-function memory. A function's blocks and instructions, its
+    liveness sets and its interference graph all come from one arena,
+    a std::pmr::monotonic_buffer_resource: allocation is a pointer bump,
+    nothing is freed piece by piece, and release() drops the lot once
+    the function has been written out.
+
+    An arena keeps its memory across functions. It starts on a buffer
+    of its own and, after a function needed more than that, grows the
+    buffer to the function's high-water mark on release(), so a warm
+    worker serves every function no larger than those it has already
+    seen without touching the global heap.
+
+    An arena is not thread-safe. Each thread has one (forThisThread),
+    and a function stays on the thread that read it; work a function
+    fans out to other threads must use a resource of its own.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+class FunctionArena final : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kDefaultSize = size_t{256} << 10;
+    // Beyond this a released arena gives memory back rather than keep it for the next function
+    static constexpr size_t kMaxRetained = size_t{64} << 20;
+
+    explicit FunctionArena(size_t initialSize = kDefaultSize);
+
+    /* Frees everything allocated since the last release, keeping the buffer */
+    void release();
+
+    size_t capacity() const { return bufferSize; }
+    /* Bytes the current function took from the heap because the buffer was full */
+    size_t overflow() const { return upstream.bytes; }
+
+    static FunctionArena& forThisThread();
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    /* The heap, counting what the arena had to take from it */
+    struct Upstream final : std::pmr::memory_resource {
+        size_t bytes = 0;
+        void* do_allocate(size_t n, size_t alignment) override;
+        void do_deallocate(void* p, size_t n, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    Upstream upstream;
+    std::unique_ptr<std::byte[]> buffer;
+    size_t bufferSize;
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+};
+
+/**
+    Lends the calling thread's arena to the function being processed.
+    Scopes nest; only the outermost one releases the arena, when it
+    ends, so declare it before the Function it backs.
+*/
+class ArenaScope {
+public:
+    ArenaScope();
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    std::pmr::memory_resource* resource() const { return arena; }
+
+private:
+    FunctionArena* arena;
+    bool outermost;
+};
@@ -0,0 +1,39 @@
+/**
+    Batch mode: allocates many files in one process on a ThreadPool.
+    Files are processed in any order, but their results are handed to
+    the caller's emit callback strictly in input order, on the calling
+    thread, as soon as every earlier file has been emitted. Output is
+    therefore identical for any number of workers, and only the results
+    that finished ahead of a slow file are ever held in memory.
+*/
+
+#pragma once
+
+#include "Pipeline.h"
+#include "ThreadPool.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct BatchItem {
+    std::string file;
+    PipelineResult result;
+    std::string error;      // empty when the file was allocated
+};
+
+struct BatchSummary {
+    size_t files = 0;
+    size_t failed = 0;
+    double seconds = 0;
+
+    double functionsPerSecond() const {
+        return seconds > 0 ? static_cast<double>(files - failed) / seconds : 0;
+    }
+};
+
+/* Input files listed one per line; blank lines and lines starting with # are skipped */
+std::vector<std::string> readManifest(const std::string& filename);
+
+BatchSummary runBatch(const std::vector<std::string>& files, const PipelineOptions& opts, ThreadPool& pool,
+                      const std::function<void(BatchItem&)>& emit);
@@ -2,15 +2,18 @@
 
 #include "IR.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <memory>
+#include <memory_resource>
+#include <new>
 #include <unordered_map>
 
 struct BasicBlock {
     int id;
     std::string label;
-    std::vector<Instruction> instructions;
+    std::pmr::vector<Instruction> instructions;
 
     /**
         Each block will have an array of predecessors and successors,
@@ -18,16 +21,81 @@ struct BasicBlock {
         shared ownership. Raw pointers are used instead of shared_ptr because
         of the overhead incurred with using shared_ptr
     */
-    std::vector<BasicBlock*> predecessors;
-    std::vector<BasicBlock*> successors;
+    std::pmr::vector<BasicBlock*> predecessors;
+    std::pmr::vector<BasicBlock*> successors;
 };
 
+/*
+    Frees a block made by Function::addBlock back to the function's
+    memory resource. A block made with new, as tests do, is deleted.
+**/
+struct BlockDeleter {
+    std::pmr::memory_resource* resource = nullptr;
+
+    BlockDeleter() = default;
+    explicit BlockDeleter(std::pmr::memory_resource* r) : resource(r) {}
+    BlockDeleter(std::default_delete<BasicBlock>) {}
+
+    void operator()(BasicBlock* block) const {
+        if (!resource) {
+            delete block;
+            return;
+        }
+        block->~BasicBlock();
+        resource->deallocate(block, sizeof(BasicBlock), alignof(BasicBlock));
+    }
+};
+
+using BlockPtr = std::unique_ptr<BasicBlock, BlockDeleter>;
+
+/**
+    A function and everything hanging off it (blocks, instruction
+    lists, edges) allocate from one memory resource, normally the
+    FunctionArena of the thread that runs it (Arena.h), so the passes
+    neither contend on the global heap nor free piece by piece. The
+    resource must outlive the function.
+*/
 struct Function {
     std::string name;
-    std::vector<std::unique_ptr<BasicBlock>> blocks;
-    std::unordered_map<std::string, BasicBlock*> labelToBlock;
+    std::pmr::vector<BlockPtr> blocks;
+    std::pmr::unordered_map<std::string, BasicBlock*> labelToBlock;
+
+    explicit Function(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : blocks(resource), labelToBlock(resource) {}
+
+    std::pmr::memory_resource* resource() const { return blocks.get_allocator().resource(); }
+
+    /* Appends an empty block whose storage comes from resource() */
+    BasicBlock* addBlock(int id, std::string label) {
+        std::pmr::memory_resource* r = resource();
+        BlockPtr block(new (r->allocate(sizeof(BasicBlock), alignof(BasicBlock))) BasicBlock{
+                           .id           = id,
+                           .label        = std::move(label),
+                           .instructions = std::pmr::vector<Instruction>(r),
+                           .predecessors = std::pmr::vector<BasicBlock*>(r),
+                           .successors   = std::pmr::vector<BasicBlock*>(r)},
+                       BlockDeleter(r));
+        blocks.push_back(std::move(block));
+        return blocks.back().get();
+    }
 };
 
+/* Highest VR id defined or used in fn; 0 for a function without VRs */
+inline int maxVRegID(const Function& fn) {
+    int maxID = 0;
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.def.has_value())
+                maxID = std::max(maxID, instr.def->id);
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use))
+                    maxID = std::max(maxID, reg->id);
+            }
+        }
+    }
+    return maxID;
+}
+
 inline std::ostream& operator<<(std::ostream& os, const BasicBlock& block) {
     os << "BasicBlock " << block.id << " [" << block.label << "]\n";
 
@@ -0,0 +1,64 @@
+/**
+    A content-addressed cache of allocation results on disk, so an
+    incremental rebuild only allocates the functions that changed.
+
+    The key of a function is its binary encoding as Writer produces it
+    before allocation, preceded by everything else the output depends
+    on: the version of the passes that produced it, the target's
+    register file, the output format and whether clean-up and
+    speculative spilling run. The encoding normalises the input: whitespace, the
+    spelling of the source and the function's name do not change it.
+    Entries are files named after a hash of the key, and each holds the
+    full key, so a hash collision is a miss and never a wrong result.
+
+    Several ion processes may share a directory. An entry is written to
+    a temporary file and renamed into place, so readers see either a
+    whole entry or none; a hit refreshes the entry's modification time,
+    and trim() deletes the least recently used entries until the
+    directory fits its size limit. store() trims on its own once enough
+    has been written since the last trim, so a long-running server
+    stays within the limit too.
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "Target.h"
+#include "Writer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+inline constexpr uint64_t kDefaultCacheSize = uint64_t{256} << 20;
+
+class ResultCache {
+public:
+    // Creates the directory if needed; throws std::runtime_error if it cannot
+    explicit ResultCache(std::string directory, uint64_t maxBytes = kDefaultCacheSize);
+
+    /* Key of fn as read, i.e. before any pass rewrites it */
+    static std::string key(const Function& fn, const TargetDesc& target, Writer::Format format, bool cleanup,
+                           bool speculativeSpills = false);
+
+    // Both are safe to call from several threads and processes at once
+    /* On a hit, replaces output with the cached result */
+    bool lookup(std::string_view key, std::string& output);
+    /* Failures to write are ignored: the cache is only an accelerator */
+    void store(std::string_view key, std::string_view output);
+
+    /* Evicts least recently used entries down to the size limit; returns the bytes removed */
+    uint64_t trim();
+
+    const std::string& path() const { return directory; }
+    uint64_t sizeLimit() const { return maxBytes; }
+
+private:
+    std::string entryPath(uint64_t hash) const;
+
+    std::string directory;
+    uint64_t maxBytes;
+    std::atomic<uint64_t> writtenSinceTrim{0};
+    std::atomic<bool> trimming{false};
+};
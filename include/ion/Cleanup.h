@@ -0,0 +1,37 @@
+/**
+    Optional clean-up of the input IR before allocation. Every dead def
+    and every copy costs the allocator a node, a bitset column and a
+    set of interference edges, so removing them up front shrinks every
+    later stage.
+
+    Copy propagation is the classic global form: a forward dataflow
+    over the set of available copies (MOV %a, %b with neither %a nor %b
+    redefined since) tells each use of %a whether it can read %b
+    instead. The dataflow covers only the copies that reach the end of
+    a block and whose %a is read in another block; the rest are found by
+    the scan of the block that makes them. Dead code elimination then walks each block bottom-up from
+    the LiveOut sets of LivenessAnalysis and deletes any instruction
+    whose def is not live. The two alternate until neither changes the
+    function.
+*/
+
+#pragma once
+
+#include "CFG.h"
+
+#include <cstddef>
+
+struct CleanupStats {
+    unsigned iterations = 0;
+    unsigned propagatedUses = 0;    // uses rewritten to read a copy's source
+    unsigned deadInstructions = 0;  // instructions removed
+    size_t instructionsBefore = 0, instructionsAfter = 0;
+    size_t vregsBefore = 0, vregsAfter = 0;     // distinct VRs referenced
+};
+
+/* Returns the number of uses rewritten */
+unsigned propagateCopies(Function& fn);
+/* Returns the number of instructions removed */
+unsigned eliminateDeadCode(Function& fn);
+
+CleanupStats cleanupFunction(Function& fn);
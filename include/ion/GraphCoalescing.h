@@ -0,0 +1,20 @@
+#pragma once
+
+#include "CFG.h"
+#include "InterferenceGraph.h"
+
+#include <vector>
+
+/* Representative of v after coalescing, with path halving */
+int findAlias(std::vector<int>& alias, int v);
+
+/**
+    Conservative copy coalescing (Briggs). For every MOV %a, %b whose
+    operands are both nodes of the graph and do not interfere, the two
+    live ranges are merged if the combined node would have fewer than k
+    neighbours of significant degree, so coalescing can never turn a
+    colourable graph into one that spills. Merged VRs are recorded in
+    alias, which must start as the identity. Returns the number of
+    copies coalesced.
+*/
+unsigned coalesceCopies(const Function& fn, InterferenceGraph& graph, unsigned k, std::vector<int>& alias);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "InterferenceGraph.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool;
+
+// Below this many nodes a graph is coloured on the calling thread even when a pool is given
+inline constexpr size_t kParallelColoringThreshold = 2048;
+
+// What simplify divides a node's spill cost by to rank it as a spill candidate
+enum class SpillDivisor : uint8_t { Degree, DegreeSquared };
+
+struct ColoringResult {
+    std::vector<int> color;     // VR -> physical register, -1 if not a node or spilled
+    std::vector<int> spilled;   // nodes select could not colour
+};
+
+/**
+    Chaitin-Briggs colouring. Simplify repeatedly removes a node of
+    degree < k and pushes it on a stack; when none is left it picks the
+    node with the lowest spillCost/degree (or spillCost/degree^2, as
+    divisor says) and pushes it optimistically.
+    Select then pops the stack and gives each node a register not used
+    by its coloured neighbours, preferring the registers in `preferred`
+    (the caller-saved set, free in a leaf function). A node with no free
+    register is spilled.
+
+    allocatable is the set of registers that may be handed out; k is
+    its population count. Select is dispatched on the width of the
+    register file to one of the fixed-width kernels below.
+
+    Each connected component is simplified and selected on its own.
+    Given a pool, a graph of at least kParallelColoringThreshold nodes
+    colours its components concurrently; the result is the same with or
+    without one, and spilled lists components in order of their lowest
+    node.
+*/
+ColoringResult colorGraph(const InterferenceGraph& graph, uint64_t allocatable, uint64_t preferred,
+                          const std::vector<float>& spillCost, ThreadPool* pool = nullptr,
+                          SpillDivisor divisor = SpillDivisor::Degree);
+
+/* Smallest unsigned word holding one bit per register of a K-register file */
+template <unsigned K>
+using ColorWord = std::conditional_t<(K <= 16), uint16_t,
+                  std::conditional_t<(K <= 32), uint32_t, uint64_t>>;
+
+/**
+    Select phase for a register file of at most K registers. The colours
+    taken by a node's neighbours are gathered into a single ColorWord and
+    the free register is found with countr_zero, so picking a colour is
+    a handful of ALU ops with no allocation. Nodes are coloured in the
+    reverse of their order on stack.
+*/
+template <unsigned K>
+void selectColors(const InterferenceGraph& graph, const std::vector<int>& stack,
+                  uint64_t allocatable, uint64_t preferred, ColoringResult& result);
+
+extern template void selectColors<16>(const InterferenceGraph&, const std::vector<int>&,
+                                      uint64_t, uint64_t, ColoringResult&);
+extern template void selectColors<32>(const InterferenceGraph&, const std::vector<int>&,
+                                      uint64_t, uint64_t, ColoringResult&);
+extern template void selectColors<64>(const InterferenceGraph&, const std::vector<int>&,
+                                      uint64_t, uint64_t, ColoringResult&);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <optional>
 #include <variant>
 #include <array>
@@ -64,29 +65,40 @@ struct Instruction {
     // may need to use std::monostate
     std::array<Operands, 2> operands;
 
+    /*
+        Set on the LOAD/STORE instructions the allocator inserts. The
+        constant operand of a spill instruction is a spill slot index,
+        not a memory address.
+    **/
+    bool spill = false;
+
     // The container represents the operands
     // OpContainer container;
 };
 
+constexpr std::string_view mnemonic(OpCode op) {
+    switch (op) {
+        case OpCode::ADD:   return "ADD";
+        case OpCode::SUB:   return "SUB";
+        case OpCode::MUL:   return "MUL";
+        case OpCode::LOAD:  return "LOAD";
+        case OpCode::STORE: return "STORE";
+        case OpCode::MOV:   return "MOV";
+        case OpCode::RET:   return "RET";
+        case OpCode::JMP:   return "JMP";
+        case OpCode::BEQ:   return "BEQ";
+        case OpCode::BZ:    return "BZ";
+        case OpCode::BNZ:   return "BNZ";
+    }
+    return "";
+}
+
 inline std::ostream& operator<<(std::ostream& os, const VReg& v) {
     return os << "%" << v.id;
 }
 
 inline std::ostream& operator<<(std::ostream& os, OpCode op) {
-    switch (op) {
-        case OpCode::ADD:   return os << "ADD";
-        case OpCode::SUB:   return os << "SUB";
-        case OpCode::MUL:   return os << "MUL";
-        case OpCode::LOAD:  return os << "LOAD";
-        case OpCode::STORE: return os << "STORE";
-        case OpCode::MOV:   return os << "MOV";
-        case OpCode::RET:   return os << "RET";
-        case OpCode::JMP:   return os << "JMP";
-        case OpCode::BEQ:   return os << "BEQ";
-        case OpCode::BZ:    return os << "BZ";
-        case OpCode::BNZ:   return os << "BNZ";
-    }
-    return os;
+    return os << mnemonic(op);
 }
 
 inline std::ostream& operator<<(std::ostream& os, const Operands& op) {
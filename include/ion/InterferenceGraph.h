@@ -1,2 +1,58 @@
 #pragma once
 
+#include "IR.h"
+#include "CFG.h"
+#include "Liveness.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+/**
+    Interference graph over the VRs of one register bank. Nodes are
+    indexed directly by VR id; ids that do not occur in the function,
+    or that belong to another bank, are simply absent. Each node keeps a
+    sorted adjacency list, which is what simplify/select walk, and
+    interferes() answers the coalescer's pairwise queries by binary
+    search on the shorter list.
+*/
+class InterferenceGraph {
+public:
+    InterferenceGraph() = default;
+    explicit InterferenceGraph(int numNodes, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    void addNode(int n);
+    // Adjacency lists are unsorted until finalise() is called
+    void addEdge(int a, int b);
+    void finalise();
+
+    /* Merge b into a: a inherits b's edges and b leaves the graph */
+    void merge(int a, int b);
+
+    bool interferes(int a, int b) const;
+    bool isNode(int n) const { return n >= 0 && n < numNodes() && present[n]; }
+    const std::pmr::vector<int>& neighbours(int n) const { return adj[n]; }
+    size_t degree(int n) const { return adj[n].size(); }
+    int numNodes() const { return static_cast<int>(adj.size()); }
+    size_t numEdges() const;
+    std::vector<int> nodes() const;
+
+private:
+    std::pmr::vector<std::pmr::vector<int>> adj;
+    std::pmr::vector<uint8_t> present;
+};
+
+/**
+    EaC's construction: walk each block bottom-up from LiveOut, adding an
+    edge between every def and everything live across it. A copy's
+    source does not interfere with its destination, so coalescing can
+    later merge them. regClass maps each VR to its class and classBank
+    maps a class to its bank; only VRs whose bank is `bank` become nodes.
+    The graph and the construction's scratch state come from resource.
+*/
+InterferenceGraph buildInterferenceGraph(const Function& fn, const LivenessResult& lr,
+                                         const std::vector<uint8_t>& regClass,
+                                         const std::vector<unsigned>& classBank,
+                                         unsigned bank,
+                                         std::pmr::memory_resource* resource = std::pmr::get_default_resource());
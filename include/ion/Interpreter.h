@@ -0,0 +1,65 @@
+/**
+    A reference interpreter for iON IR. It measures what an allocation
+    costs when the code runs, and checks that allocation did not change
+    what the program computes. A Function runs either as written, with a
+    value per VR, or through an Allocation, with a value per physical
+    register and spill slot. The allocator's input and output are thus
+    run on equal terms.
+
+    Programs take no inputs and RET returns nothing, so a program's
+    behaviour is what it computes. That is every value an ADD, SUB, MUL,
+    constant MOV or memory LOAD produces, named by the origin of the VR
+    it defines, together with every branch taken and every store to
+    memory. These are folded into a hash in execution order. Copies and
+    spill code are left out, since allocation adds and removes them.
+
+    The blocks are first decoded into one flat array of compact
+    instructions. Every operand, immediates included, is an index into
+    a single array of values, so the main loop touches no variants,
+    labels or allocation tables. VRs, registers, spill slots and memory
+    all start out as zero. A program that reads a VR before defining it
+    may therefore behave differently once allocated.
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "RegisterAllocator.h"
+#include "Target.h"
+
+#include <cstdint>
+
+struct ExecutionStats {
+    uint64_t instructions = 0;  // every instruction run, terminators included
+    uint64_t memoryOps = 0;     // the program's own LOADs and STOREs
+    uint64_t spillLoads = 0;
+    uint64_t spillStores = 0;
+    uint64_t copies = 0;        // MOVs from a register, including reloads the peephole turned into copies
+
+    uint64_t spillOps() const { return spillLoads + spillStores; }
+};
+
+struct Execution {
+    bool completed = false;     // reached a RET within the instruction limit
+    ExecutionStats stats;
+    uint64_t behaviour = 0;     // hash of the values computed, branches taken and stores made, in order
+};
+
+// Generated programs run a few million instructions; this only stops a program that never returns
+inline constexpr uint64_t kDefaultMaxInstructions = uint64_t{1} << 30;
+
+/**
+    Runs fn from its first block until a RET, or until more than
+    maxInstructions have run, which is checked at each branch. Throws
+    std::runtime_error if control falls off the end of a block.
+*/
+Execution interpret(const Function& fn, uint64_t maxInstructions = kDefaultMaxInstructions);
+
+/* As above, with each VR read from and written to its register in alloc */
+Execution interpret(const Function& fn, const Allocation& alloc, const TargetDesc& target,
+                    uint64_t maxInstructions = kDefaultMaxInstructions);
+
+/* Both runs returned and did the same things; runs cut short by the limit are never the same */
+inline bool sameBehaviour(const Execution& a, const Execution& b) {
+    return a.completed && b.completed && a.behaviour == b.behaviour;
+}
@@ -0,0 +1,124 @@
+/**
+    A set of names drawn from [0, universe), for the liveness and
+    available-copies solvers.
+    Which of three forms it takes depends on what it holds, and it
+    switches form as that changes:
+
+        - Sparse: the members, sorted. For a handful of names out of
+          thousands.
+        - Chunked: only the 64-bit words that have a member in them,
+          with their word numbers, in the manner of a roaring bitmap.
+          For names clustered in a few ranges.
+        - Dense: every word. For sets that are full, or universes a few
+          words wide.
+
+    Each operation leaves the set in whichever form is smallest for its
+    new contents, so equal sets always have the same form and compare
+    member for member. The kernels take any mix of forms.
+
+    Copies keep their own memory resource. Sets that are swapped must
+    share one.
+*/
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+class LiveSet {
+public:
+    enum class Kind : uint8_t { Sparse, Chunked, Dense };
+
+    // Universes of at most this many words are always dense
+    static constexpr size_t kDenseWords = 4;
+
+    explicit LiveSet(size_t universe, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    LiveSet(LiveSet&&) = default;
+    LiveSet& operator=(LiveSet&&) = default;
+    // A copy would take the default resource; assign into a set made with the one wanted
+    LiveSet(const LiveSet&) = delete;
+    LiveSet& operator=(const LiveSet& other);
+
+    size_t universe() const { return size; }
+    Kind kind() const { return form; }
+    size_t count() const;
+    bool empty() const { return form == Kind::Dense ? count() == 0 : index.empty(); }
+    bool test(uint32_t name) const;
+
+    void clear();
+    // Replaces the contents with members, which must be ascending and distinct
+    void assignSorted(std::span<const uint32_t> members);
+
+    LiveSet& operator|=(const LiveSet& other);
+    LiveSet& operator-=(const LiveSet& other);
+    LiveSet& operator&=(const LiveSet& other);
+    bool operator==(const LiveSet& other) const {
+        return form == other.form && index == other.index && words == other.words;
+    }
+
+    void swap(LiveSet& other) noexcept;
+
+    // Calls f(name) for every member in ascending order
+    template <typename F>
+    void forEach(F&& f) const;
+
+    // Bytes the contents take, the capacity held in reserve aside
+    size_t bytes() const { return index.size() * sizeof(uint32_t) + words.size() * sizeof(uint64_t); }
+
+private:
+    // Calls f(wordNumber, word) for every non-zero word in ascending order
+    template <typename F>
+    void forEachWord(F&& f) const;
+    uint64_t wordAt(uint32_t k) const;
+
+    Kind choose(size_t members, size_t nonZeroWords) const;
+    // Re-forms the set from its non-zero words, given in ascending order
+    void assignWords(std::span<const uint32_t> keys, std::span<const uint64_t> values);
+    // Puts a dense set into the form its contents call for
+    void refitDense();
+
+    size_t size;
+    size_t numWords;
+    Kind form;
+    std::pmr::vector<uint32_t> index;       // Sparse: the members; Chunked: the word numbers
+    std::pmr::vector<uint64_t> words;       // Chunked: the words; Dense: all of them
+};
+
+template <typename F>
+void LiveSet::forEach(F&& f) const {
+    if (form == Kind::Sparse) {
+        for (uint32_t name : index) f(name);
+        return;
+    }
+    forEachWord([&](uint32_t k, uint64_t w) {
+        for (; w != 0; w &= w - 1)
+            f(k * 64 + static_cast<uint32_t>(std::countr_zero(w)));
+    });
+}
+
+template <typename F>
+void LiveSet::forEachWord(F&& f) const {
+    switch (form) {
+    case Kind::Sparse:
+        for (size_t i = 0; i < index.size();) {
+            uint32_t k = index[i] / 64;
+            uint64_t w = 0;
+            for (; i < index.size() && index[i] / 64 == k; ++i) w |= uint64_t{1} << (index[i] % 64);
+            f(k, w);
+        }
+        break;
+    case Kind::Chunked:
+        for (size_t i = 0; i < index.size(); ++i) f(index[i], words[i]);
+        break;
+    case Kind::Dense:
+        for (size_t k = 0; k < words.size(); ++k) {
+            if (words[k] != 0) f(static_cast<uint32_t>(k), words[k]);
+        }
+        break;
+    }
+}
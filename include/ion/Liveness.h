@@ -3,14 +3,23 @@
 #include "IR.h"
 #include "CFG.h"
 
+#include <cstddef>
+#include <cstdint>
 #include <map>
+#include <memory_resource>
 #include <set>
 #include <boost/dynamic_bitset.hpp>
 
+// A bit per VR, allocated from the function's memory resource
+using LiveBits = boost::dynamic_bitset<uint64_t, std::pmr::polymorphic_allocator<uint64_t>>;
+
 struct LivenessInfo {
     // Block ID -> bitset indexed by register/variable ID
-    std::map<int, boost::dynamic_bitset<>> UEVar;
-    std::map<int, boost::dynamic_bitset<>> VarKill;
+    std::pmr::map<int, LiveBits> UEVar;
+    std::pmr::map<int, LiveBits> VarKill;
+
+    explicit LivenessInfo(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : UEVar(resource), VarKill(resource) {}
 };
 
 // Hold the results of the equations solved
@@ -22,15 +31,39 @@ struct LivenessResult {
         it may be a better idea to convert the sets to use
         label rather than using block ID
     **/
-    std::map<int, std::set<int>> liveoutSet;
-    std::map<int, std::set<int>> liveinSet;     
+    std::pmr::map<int, std::pmr::set<int>> liveoutSet;
+    std::pmr::map<int, std::pmr::set<int>> liveinSet;
+
+    explicit LivenessResult(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : liveoutSet(resource), liveinSet(resource) {}
 };
 
 // TODO: Fix design; not great for usability
 LivenessInfo computeUseDef(Function& fn);
 
+class ThreadPool;
+
+// Below this many global names liveness is solved on the calling thread even when a pool is given
+inline constexpr size_t kParallelLivenessThreshold = 4096;
+
 class LivenessAnalysis {
 public:
-    // Gathers the initial information and stores in the internal bitsets
+    /**
+        A function with at least minNames global names has them cut
+        into word-aligned slices, one per worker of pool, and each slice
+        is solved to its fixed point concurrently with the others. The
+        sets are those of a sequential solve.
+    */
+    void parallelSolve(ThreadPool* pool, size_t minNames = kParallelLivenessThreshold) {
+        this->pool = pool;
+        parallelMinNames = minNames;
+    }
+
+    // Gathers the initial information and stores in the internal bitsets;
+    // the result and all scratch state come from fn.resource()
     LivenessResult analyse(Function& fn);
+
+private:
+    ThreadPool* pool = nullptr;
+    size_t parallelMinNames = kParallelLivenessThreshold;
 };
\ No newline at end of file
@@ -0,0 +1,37 @@
+/**
+    EaC's bottom-up local allocator, for functions whose control flow
+    never merges: a single block, a chain of blocks, or any tree of
+    blocks hanging off the entry (such as a branch to two returns).
+    Along every path from the entry such a function is straight-line
+    code, so no dataflow or interference graph is needed.
+
+    Each path is walked top-down once. An operand not in a register is
+    loaded into one, a register is freed as soon as its value has no
+    next use, and when none is free the value whose next use is farthest
+    away is spilled, stored first only if its slot is stale. Next-use
+    distances come from one bottom-up pass over the tree beforehand.
+    At a branch each successor starts from the registers as they were at
+    the end of the branch's block.
+
+    A value may sit in different registers over its life, so each stay
+    in a register other than the VR's own is renamed to a fresh VR, as
+    spill temporaries are, and Allocation keeps one register per VR.
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "RegisterAllocator.h"
+#include "Target.h"
+
+/* Whether every block other than the entry has exactly one predecessor and is reachable from it */
+bool hasNoMerges(const Function& fn);
+
+/**
+    Allocates fn, which must satisfy hasNoMerges, in one pass. alloc
+    comes in with every VR of fn in reg, regClass and origin, as
+    RegisterAllocator sets it up; spill code and renamed VRs are added
+    to fn and alloc. Throws std::runtime_error if an instruction needs
+    more registers at once than its bank has.
+*/
+void allocateLocal(Function& fn, const TargetDesc& target, Allocation& alloc);
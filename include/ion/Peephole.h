@@ -0,0 +1,35 @@
+/**
+    Peephole clean-up of allocated code. Coalescing is conservative, so
+    some copies still end up as MOV r3, r3 once coloured, and spill
+    everywhere stores a value and reloads it a few instructions later.
+    runPeephole makes one pass over each block:
+
+        - counts copies whose source and destination share a register,
+          leaving them for the Writer to drop: the verifier learns from
+          such a copy which value the register holds
+        - forwards a spilled value to a later reload of the same slot
+          while the register that held it is untouched, turning the
+          LOAD into a copy, or deleting it when the registers match
+        - deletes spill stores that no reload can observe, either because
+          the slot is overwritten later in the block before any reload or
+          because the slot is never reloaded anywhere in the function
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "RegisterAllocator.h"
+#include "Target.h"
+
+struct PeepholeStats {
+    unsigned selfMoves = 0;         // MOV r, r left for the Writer to drop
+    unsigned reloadsRemoved = 0;    // LOADs deleted outright
+    unsigned reloadsToCopies = 0;   // LOADs turned into register copies
+    unsigned deadStores = 0;        // spill STOREs deleted
+
+    // Instructions missing from the written code
+    unsigned instructionsRemoved() const { return selfMoves + reloadsRemoved + deadStores; }
+    unsigned memoryOpsRemoved() const { return reloadsRemoved + reloadsToCopies + deadStores; }
+};
+
+PeepholeStats runPeephole(Function& fn, const Allocation& alloc, const TargetDesc& target);
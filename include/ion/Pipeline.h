@@ -0,0 +1,57 @@
+/**
+    The allocation pipeline as one call, shared by the single-file CLI,
+    batch mode and anything else that drives iON: optional clean-up,
+    register allocation, the peephole pass and output of the allocated
+    IR. The result is returned as a string rather than written to a
+    stream, so concurrent callers can decide the order in which results
+    are emitted.
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "Cache.h"
+#include "RegisterAllocator.h"
+#include "Target.h"
+#include "ThreadPool.h"
+#include "Writer.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct PipelineOptions {
+    const TargetDesc* target = nullptr;
+    Writer::Format format = Writer::Format::Text;
+    bool cleanup = false;
+    // Tries every spill metric and keeps the cheapest spills (RegisterAllocator::speculativeSpills)
+    bool speculativeSpills = false;
+    // Checks the code written with verifyAllocation, after the peephole pass, and fails the function if it is wrong
+    bool verify = true;
+    // Interprets the function before allocation and after the peephole pass, logs what each run executed and
+    // fails the function if the two behave differently (Interpreter.h). Bypasses the cache
+    bool execute = false;
+    // Optional; shared by every function of a run. Ignored when a hook is set
+    ResultCache* cache = nullptr;
+    // Optional; lets runPipeline parse a very large input in parallel chunks and
+    // solve the liveness of a very large function in slices
+    ThreadPool* pool = nullptr;
+
+    // Optional hooks for debug dumps; they see the function between stages
+    std::function<void(Function&)> beforeAllocation;
+    std::function<void(Function&, const Allocation&)> afterAllocation;
+};
+
+struct PipelineResult {
+    std::string output;     // allocated IR in the requested format
+    std::string log;        // [INFO] lines describing what the passes did
+    bool cached = false;    // output came from the cache; the passes did not run
+};
+
+/* Runs the pipeline on fn, rewriting it; throws std::runtime_error on failure */
+PipelineResult runPipeline(Function& fn, const PipelineOptions& opts);
+/* As above, reusing the capacity of result's strings, e.g. a per-thread scratch result */
+void runPipeline(Function& fn, const PipelineOptions& opts, PipelineResult& result);
+
+/* Reads filename and runs the pipeline on its function */
+PipelineResult runPipeline(const std::string& filename, const PipelineOptions& opts);
@@ -10,19 +10,47 @@
 #include "IR.h"
 #include "CFG.h"
 
+#include <cstddef>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <vector>
 #include <memory>
 
+class ThreadPool;
+
+// Below this a text input is parsed on the calling thread even when a pool is given
+inline constexpr size_t kParallelParseThreshold = size_t{4} << 20;
+
 class Reader {
 public:
+    // The functions built take their memory from resource
+    explicit Reader(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : func(resource) {}
+
+    /**
+        Text inputs of at least minBytes are split at label lines into
+        chunks that are parsed concurrently on pool. The function built
+        is identical to that of a sequential parse: blocks are numbered
+        in file order, and a malformed input reports the error nearest
+        its start.
+    */
+    void parallelParse(ThreadPool* pool, size_t minBytes = kParallelParseThreshold) {
+        parsePool = pool;
+        parallelMinBytes = minBytes;
+    }
+
     Function BuildCFG(const std::string& filename);
+    /* Text IR already in memory, e.g. received over a socket */
+    Function BuildCFGFromSource(std::string_view source, const std::string& name);
+    /* Virtual-register IR in the binary format of Writer.h; throws std::runtime_error if malformed */
+    Function BuildCFGFromBinary(std::string_view data, const std::string& name);
 private:
-    void FindLeaders(const std::string& filename);
+    Function finish();
+    void FindLeaders(std::string_view source);
+    void FindLeadersParallel(std::string_view source);
+    void ReadBinary(std::string_view data);
     void BuildGraph();
-    // TODO: Make func name the filename
-    Function func{
-        .name = "default_func"
-    };
+    Function func;
+    ThreadPool* parsePool = nullptr;
+    size_t parallelMinBytes = kParallelParseThreshold;
 };
@@ -0,0 +1,63 @@
+/**
+    The driver for the global allocator. Each round runs liveness once,
+    then builds, coalesces and colours the interference graph of every
+    register bank. Banks never share registers, so when a target has
+    more than one they are coloured concurrently. If any VR spilled,
+    spill code is inserted into the function and the round repeats.
+    A function whose control flow never merges goes to the local
+    allocator instead (LocalAllocator.h).
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "SpillHeuristic.h"
+#include "Target.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+struct Allocation {
+    std::vector<int> reg;           // VR -> physical register in its bank, -1 if the VR does not occur
+    std::vector<uint8_t> regClass;  // VR -> register class
+    /*
+        VR of the input program whose value a VR carries. Identity for
+        input VRs; spill temporaries map to the VR they reload or store.
+    **/
+    std::vector<int> origin;
+    int numSpillSlots = 0;
+    unsigned spilledVRegs = 0;
+    unsigned coalescedCopies = 0;
+    unsigned rounds = 0;
+    // With speculative spilling: bank colourings in which some metric spilled, by the metric kept
+    std::array<unsigned, kNumSpillHeuristics> spillWins{};
+};
+
+class ThreadPool;
+
+class RegisterAllocator {
+public:
+    explicit RegisterAllocator(const TargetDesc& target) : target(target) {}
+
+    // Solves the liveness of a very large function in slices on pool (see LivenessAnalysis)
+    void parallelLiveness(ThreadPool* pool) { livenessPool = pool; }
+    // Colours the components of a large interference graph as tasks on pool (see colorGraph)
+    void parallelColoring(ThreadPool* pool) { coloringPool = pool; }
+    /**
+        Colours every graph once per SpillHeuristic, concurrently on the
+        coloring pool if there is one, and keeps the colouring whose
+        spills have the lowest loop-weighted cost, the earliest metric
+        on a tie. Without it only CostOverDegree is tried.
+    */
+    void speculativeSpills(bool enable) { speculative = enable; }
+
+    // Rewrites fn with spill code; throws std::runtime_error if fn already has some or allocation cannot converge
+    Allocation allocate(Function& fn);
+
+private:
+    const TargetDesc& target;
+    ThreadPool* livenessPool = nullptr;
+    ThreadPool* coloringPool = nullptr;
+    bool speculative = false;
+};
@@ -0,0 +1,67 @@
+/**
+    Register pressure: the number of VRs of a bank live at once. Where
+    it never exceeds the bank's k registers a function usually needs no
+    interference graph at all, and where it does, the blocks over k are
+    the only places a spill can help.
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "GraphColoring.h"
+#include "Liveness.h"
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+struct RegisterPressure {
+    std::pmr::vector<unsigned> block;   // block position -> most VRs of the bank live at one point in it
+    unsigned max = 0;                   // over the whole function
+
+    explicit RegisterPressure(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : block(resource) {}
+};
+
+/* Block positions in reverse postorder from the entry, then any unreachable blocks */
+std::pmr::vector<int> reversePostorder(const Function& fn,
+                                       std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/**
+    MaxLive of every block, found with the same bottom-up walk from
+    LiveOut as buildInterferenceGraph. A def counts as live at its own
+    instruction even if nothing reads it, since it still needs a register
+    there. Only VRs whose bank is `bank` are counted.
+*/
+RegisterPressure computePressure(const Function& fn, const LivenessResult& lr,
+                                 const std::vector<uint8_t>& regClass,
+                                 const std::vector<unsigned>& classBank, unsigned bank,
+                                 std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/**
+    Colours the bank without an interference graph, for a function whose
+    pressure never exceeds k. Blocks are walked in reverse postorder,
+    which reaches every block after its dominators, and each block
+    bottom-up from LiveOut. A VR takes a register when it is first seen
+    live: a copy's register if that is free, as coalescing would have
+    given it, otherwise the first free preferred register. Every def is
+    checked against what is live across it, exactly the edges the graph
+    would have had. Without SSA, pressure within k does not guarantee a
+    colouring, so on a conflict this returns false and the caller falls
+    back to the graph. result.color is indexed by VR like colorGraph's.
+*/
+bool assignWithoutGraph(const Function& fn, const LivenessResult& lr,
+                        const std::vector<uint8_t>& regClass,
+                        const std::vector<unsigned>& classBank, unsigned bank,
+                        uint64_t allocatable, uint64_t preferred, ColoringResult& result,
+                        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+/**
+    VR -> number of blocks whose pressure exceeds k in which the VR is
+    live at some point. Spilling a VR lowers the pressure of exactly
+    those blocks, so the spill heuristic weighs its cost against them.
+*/
+std::vector<unsigned> excessBlocks(const Function& fn, const LivenessResult& lr,
+                                   const RegisterPressure& pressure, unsigned k,
+                                   const std::vector<uint8_t>& regClass,
+                                   const std::vector<unsigned>& classBank, unsigned bank);
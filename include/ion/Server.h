@@ -0,0 +1,75 @@
+/**
+    `ion --serve`: a long-running allocator behind a Unix domain socket,
+    so callers that allocate one small function at a time do not pay
+    for process start-up and cold caches on every request.
+
+    Each request and response is a frame:
+
+        request  := u32:length payload
+        response := u32:length u8:status payload
+
+    with length little-endian and counting the bytes after it. A request
+    payload is one function as .ion text or in the binary format of
+    Writer.h (recognised by its magic), and a successful response
+    (status 0) carries the allocated IR in the same format. On failure
+    status is 1 and the payload is the error message.
+
+    A client may pipeline any number of requests on a connection
+    without waiting for replies. Requests run concurrently on the
+    server's ThreadPool, and responses go back on each connection in
+    request order. Request buffers are recycled through a pool and every
+    worker keeps a thread-local scratch result, so a warm server makes
+    few allocations beyond those of the pipeline itself.
+*/
+
+#pragma once
+
+#include "Pipeline.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+inline constexpr uint32_t kMaxFrameSize = 256u << 20;
+
+class Server {
+public:
+    // Throws std::runtime_error if the socket cannot be created
+    Server(std::string socketPath, PipelineOptions opts, unsigned workers = 0);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /* Accepts connections until stop() is called */
+    void run();
+    // Safe to call from any thread or from a signal handler
+    void stop();
+
+    const std::string& path() const { return socketPath; }
+
+private:
+    struct Connection;
+
+    void serve(Connection& conn);
+    void handle(Connection& conn, uint64_t seq, std::string request);
+    std::string acquireBuffer();
+    void releaseBuffer(std::string buffer);
+
+    std::string socketPath;
+    PipelineOptions opts;
+    ThreadPool pool;
+    int listenFd = -1;
+    int wakeFds[2] = {-1, -1};
+
+    std::mutex connectionsMutex;
+    std::list<Connection> connections;
+
+    std::mutex buffersMutex;
+    std::vector<std::string> buffers;
+};
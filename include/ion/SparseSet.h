@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+/* Set of small integers with O(1) insert/erase and O(|set|) iteration */
+class SparseSet {
+public:
+    SparseSet(size_t universe, std::pmr::memory_resource* resource)
+        : members(resource), pos(universe, -1, resource) {}
+
+    void insert(int v) {
+        if (pos[v] >= 0) return;
+        pos[v] = static_cast<int>(members.size());
+        members.push_back(v);
+    }
+
+    void erase(int v) {
+        int p = pos[v];
+        if (p < 0) return;
+        int last = members.back();
+        members[p] = last;
+        pos[last] = p;
+        members.pop_back();
+        pos[v] = -1;
+    }
+
+    void clear() {
+        for (int v : members) pos[v] = -1;
+        members.clear();
+    }
+
+    bool contains(int v) const { return pos[v] >= 0; }
+    size_t size() const { return members.size(); }
+    auto begin() const { return members.begin(); }
+    auto end() const { return members.end(); }
+
+private:
+    std::pmr::vector<int> members;
+    std::pmr::vector<int> pos;
+};
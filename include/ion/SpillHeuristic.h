@@ -0,0 +1,77 @@
+/**
+    The spill metrics Chaitin-Briggs simplify can rank candidates by.
+    None of them is best for every function, so the allocator can try
+    them all on the same interference graph and keep the colouring whose
+    spills cost least (RegisterAllocator::speculativeSpills).
+
+    Every metric divides a VR's cost by its degree, or its square, in
+    colorGraph; they differ in the cost:
+
+        - CostOverDegree: its defs and uses.
+        - CostOverDegreeSquared: the same, over degree squared, which
+          favours spilling the VRs that free up the most neighbours.
+        - Area: its defs and uses over the number of instructions it is
+          live across, as in Bernstein et al., so a long, thinly used
+          live range goes first.
+        - LoopDepth: its defs and uses weighted by 10^depth of their
+          loop nest, the usual estimate of how often each one runs.
+
+    The spills of each are judged by the LoopDepth weight of what they
+    spill: the memory operations the spill code is expected to execute.
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "Liveness.h"
+
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+enum class SpillHeuristic : uint8_t {
+    CostOverDegree,
+    CostOverDegreeSquared,
+    Area,
+    LoopDepth,
+    Count
+};
+
+inline constexpr size_t kNumSpillHeuristics = static_cast<size_t>(SpillHeuristic::Count);
+
+inline constexpr std::string_view kSpillHeuristicNames[] = {
+    "cost/degree", "cost/degree^2", "area", "loop-depth",
+};
+static_assert(std::size(kSpillHeuristicNames) == kNumSpillHeuristics);
+
+constexpr std::string_view spillHeuristicName(SpillHeuristic h) {
+    return kSpillHeuristicNames[static_cast<size_t>(h)];
+}
+
+// Loop nests deeper than this weigh the same; 10^8 keeps sums of weights well within a float
+inline constexpr unsigned kMaxWeightedLoopDepth = 8;
+
+/**
+    Block position -> number of loops the block is in. A loop is a
+    strongly connected component of the CFG with a cycle; its inner
+    loops are the components that remain once its header, the block
+    entered from outside it, is taken out. For a reducible CFG these
+    are exactly the natural loops.
+*/
+std::vector<unsigned> loopDepths(const Function& fn);
+
+/* Block position -> 10^depth, the expected number of times the block runs per entry to the function */
+std::vector<float> blockWeights(const std::vector<unsigned>& depths);
+
+/* VR -> its defs and uses, each weighted by its block's weight */
+std::vector<float> weightedOccurrences(const Function& fn, const std::vector<float>& weight, size_t numVRegs);
+
+/**
+    VR -> weighted number of instructions the VR is live at, found with
+    the bottom-up walk from LiveOut of computePressure. Only the ends of
+    each stretch of liveness are visited, so this costs a pass over the
+    instructions plus the live sets at block boundaries.
+*/
+std::vector<float> liveArea(const Function& fn, const LivenessResult& lr, const std::vector<float>& weight,
+                            size_t numVRegs);
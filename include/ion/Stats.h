@@ -0,0 +1,173 @@
+/**
+    Pipeline statistics for `ion --stats`. Every stage opens a
+    stats::Timer for its phase and reports its key counters through
+    stats::count. Both go to the Stats object installed with
+    stats::enable; while none is installed they cost one relaxed atomic
+    load and a branch, so the instrumentation stays compiled in.
+
+    A phase accumulates wall time, the number of times it ran and the
+    heap allocations made on its thread while it ran. Phases of
+    different banks run concurrently, so their totals can add up to more
+    than the elapsed time. Peak memory is the process' maximum resident
+    set size, sampled when each phase ends. While a TraceRecorder is
+    installed, every Timer also records its phase as a trace span.
+*/
+
+#pragma once
+
+#include "Trace.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+enum class Phase : uint8_t {
+    FindLeaders,
+    BuildGraph,
+    Cleanup,
+    UseDef,
+    Liveness,
+    LocalAllocation,
+    Pressure,
+    InterferenceGraph,
+    Coalescing,
+    Coloring,
+    SpillCode,
+    Verify,
+    Peephole,
+    Execute,
+    Write,
+    Count
+};
+
+enum class Counter : uint8_t {
+    Blocks,
+    Instructions,
+    LivenessIterations,
+    LivenessVisits,
+    GlobalNames,
+    InterferenceNodes,
+    InterferenceEdges,
+    CoalescedCopies,
+    SpilledVRegs,
+    SpillInstructions,
+    AllocationRounds,
+    FastPathBanks,
+    SpillWinsCostDegree,    // one per SpillHeuristic, in its order
+    SpillWinsCostDegree2,
+    SpillWinsArea,
+    SpillWinsLoopDepth,
+    PeepholeRemoved,
+    ExecutedInput,          // instructions interpreted, before and after allocation
+    ExecutedAllocated,
+    ExecutedSpillOps,
+    CacheHits,
+    CacheMisses,
+    Count
+};
+
+inline constexpr std::string_view kPhaseNames[] = {
+    "FindLeaders", "BuildGraph", "Cleanup", "computeUseDef", "Liveness", "LocalAllocation", "Pressure",
+    "InterferenceGraph", "Coalescing", "Coloring", "SpillCode", "Verify", "Peephole", "Execute", "Write",
+};
+static_assert(std::size(kPhaseNames) == static_cast<size_t>(Phase::Count));
+
+inline constexpr std::string_view kCounterNames[] = {
+    "blocks", "instructions", "liveness_iterations", "liveness_visits", "global_names", "interference_nodes",
+    "interference_edges", "coalesced_copies", "spilled_vregs", "spill_instructions", "allocation_rounds",
+    "fast_path_banks", "spill_wins_cost_degree", "spill_wins_cost_degree2", "spill_wins_area",
+    "spill_wins_loop_depth", "peephole_removed", "executed_input", "executed_allocated", "executed_spill_ops",
+    "cache_hits", "cache_misses",
+};
+static_assert(std::size(kCounterNames) == static_cast<size_t>(Counter::Count));
+
+// Both are string literals, so data() is null-terminated
+constexpr std::string_view phaseName(Phase p) { return kPhaseNames[static_cast<size_t>(p)]; }
+constexpr std::string_view counterName(Counter c) { return kCounterNames[static_cast<size_t>(c)]; }
+
+class Stats {
+public:
+    Stats();
+
+    void record(Phase p, uint64_t nanos, uint64_t allocations);
+    void add(Counter c, uint64_t n) { counters[index(c)].fetch_add(n, std::memory_order_relaxed); }
+    void samplePeakMemory();
+
+    uint64_t count(Counter c) const { return counters[index(c)].load(std::memory_order_relaxed); }
+    uint64_t calls(Phase p) const { return phases[index(p)].calls.load(std::memory_order_relaxed); }
+    uint64_t nanos(Phase p) const { return phases[index(p)].nanos.load(std::memory_order_relaxed); }
+    uint64_t allocations(Phase p) const { return phases[index(p)].allocations.load(std::memory_order_relaxed); }
+    uint64_t peakMemory() const { return peakBytes.load(std::memory_order_relaxed); }
+
+    void writeText(std::ostream& os) const;
+    void writeJSON(std::ostream& os) const;
+
+private:
+    template <typename E>
+    static constexpr size_t index(E e) { return static_cast<size_t>(e); }
+
+    struct PhaseTotals {
+        std::atomic<uint64_t> nanos{0};
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> allocations{0};
+    };
+    std::array<PhaseTotals, static_cast<size_t>(Phase::Count)> phases;
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> counters{};
+    std::atomic<uint64_t> peakBytes{0};
+    std::chrono::steady_clock::time_point start;
+};
+
+namespace stats {
+
+inline std::atomic<Stats*> active{nullptr};
+
+/*
+    Heap allocations made so far by the calling thread. The library
+    does not replace operator new itself; an executable that does (see
+    src/AllocationCounter.cpp) installs its counter here.
+**/
+using AllocationCounter = uint64_t (*)();
+inline std::atomic<AllocationCounter> allocationCounter{nullptr};
+
+// Installs s as the destination of every timer and counter; nullptr disables collection
+inline void enable(Stats* s) { active.store(s, std::memory_order_release); }
+
+inline Stats* current() { return active.load(std::memory_order_relaxed); }
+
+inline void count(Counter c, uint64_t n = 1) {
+    if (Stats* s = current()) s->add(c, n);
+}
+
+inline uint64_t allocationsSoFar() {
+    AllocationCounter counter = allocationCounter.load(std::memory_order_relaxed);
+    return counter ? counter() : 0;
+}
+
+class Timer {
+public:
+    explicit Timer(Phase phase) : stats(current()), phase(phase), span(phaseName(phase).data()) {
+        if (!stats) return;
+        allocations = allocationsSoFar();
+        startTime = std::chrono::steady_clock::now();
+    }
+    ~Timer() {
+        if (!stats) return;
+        auto elapsed = std::chrono::steady_clock::now() - startTime;
+        stats->record(phase, static_cast<uint64_t>(std::chrono::nanoseconds(elapsed).count()),
+                      allocationsSoFar() - allocations);
+    }
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+private:
+    Stats* stats;
+    Phase phase;
+    trace::Span span;
+    uint64_t allocations = 0;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+}   // namespace stats
@@ -0,0 +1,205 @@
+/**
+    Target.h describes the register file of the machine iON allocates
+    for. A target is a small table of register classes, each with a
+    register count, a caller-saved set and the bank of physical
+    registers it lives in. Classes that share a bank are different
+    views of the same registers, so they are coloured together; classes
+    in different banks never interact and are allocated independently.
+
+    The presets are constexpr so code that knows its target at compile
+    time can size its colour sets from it, e.g. RegMask<targets::RISC32>.
+    Other targets are read from a small config file with loadTarget.
+*/
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+inline constexpr unsigned kMaxRegClasses = 4;
+inline constexpr unsigned kMaxRegAliases = 16;
+inline constexpr unsigned kMaxVRegRanges = 8;
+// The caller-saved set of a class is a uint64_t, so no class can be wider
+inline constexpr unsigned kMaxRegsPerClass = 64;
+
+struct RegClass {
+    std::string_view name;          // "gpr"
+    std::string_view prefix;        // physical registers print as <prefix><index>
+    unsigned numRegs = 0;
+    uint64_t callerSaved = 0;       // bit i set => register i is caller-saved
+    uint64_t reserved = 0;          // bit i set => register i is never allocated
+    unsigned bank = 0;              // classes in the same bank share registers
+};
+
+/* Alternative name for a physical register, e.g. sp = gpr 15 */
+struct RegAlias {
+    std::string_view name;
+    uint8_t regClass = 0;
+    uint8_t reg = 0;
+};
+
+/*
+    The IR has no syntax for register classes, so the target states
+    which virtual registers belong to which class. Any VR not covered
+    by a range belongs to class 0.
+**/
+struct VRegRange {
+    int first = 0;
+    int last = -1;
+    uint8_t regClass = 0;
+};
+
+struct TargetDesc {
+    std::string_view name;
+    std::array<RegClass, kMaxRegClasses> classes{};
+    unsigned numClasses = 0;
+    std::array<RegAlias, kMaxRegAliases> aliases{};
+    unsigned numAliases = 0;
+    std::array<VRegRange, kMaxVRegRanges> vregRanges{};
+    unsigned numVRegRanges = 0;
+
+    /* Widest class; the fixed width of a colour set for this target */
+    constexpr unsigned maxRegs() const {
+        unsigned m = 0;
+        for (unsigned i = 0; i < numClasses; ++i)
+            m = classes[i].numRegs > m ? classes[i].numRegs : m;
+        return m;
+    }
+
+    constexpr uint8_t classOf(int vreg) const {
+        for (unsigned i = 0; i < numVRegRanges; ++i)
+            if (vreg >= vregRanges[i].first && vreg <= vregRanges[i].last)
+                return vregRanges[i].regClass;
+        return 0;
+    }
+
+    constexpr unsigned numBanks() const {
+        unsigned n = 0;
+        for (unsigned i = 0; i < numClasses; ++i)
+            n = classes[i].bank + 1 > n ? classes[i].bank + 1 : n;
+        return n;
+    }
+
+    /* Registers in a bank; every class of a bank has the same count */
+    constexpr unsigned bankRegs(unsigned bank) const {
+        for (unsigned i = 0; i < numClasses; ++i)
+            if (classes[i].bank == bank) return classes[i].numRegs;
+        return 0;
+    }
+
+    /* Registers of a bank the allocator may hand out */
+    constexpr uint64_t allocatable(unsigned bank) const {
+        uint64_t reserved = 0;
+        for (unsigned i = 0; i < numClasses; ++i)
+            if (classes[i].bank == bank) reserved |= classes[i].reserved;
+        unsigned n = bankRegs(bank);
+        uint64_t all = n >= 64 ? ~uint64_t{0} : (uint64_t{1} << n) - 1;
+        return all & ~reserved;
+    }
+
+    /* Returns -1 if the class does not exist */
+    constexpr int findClass(std::string_view className) const {
+        for (unsigned i = 0; i < numClasses; ++i)
+            if (classes[i].name == className) return static_cast<int>(i);
+        return -1;
+    }
+
+    /* Alias of a physical register, or an empty view if it has none */
+    constexpr std::string_view aliasOf(unsigned regClass, unsigned reg) const {
+        for (unsigned i = 0; i < numAliases; ++i)
+            if (aliases[i].regClass == regClass && aliases[i].reg == reg)
+                return aliases[i].name;
+        return {};
+    }
+};
+
+/* Fixed-width colour set for a compile-time target */
+template <const TargetDesc& T>
+using RegMask = std::bitset<T.maxRegs()>;
+
+namespace targets {
+
+/* Deliberately small register file, useful for forcing spills */
+inline constexpr TargetDesc Tiny{
+    .name = "tiny",
+    .classes = {{ {.name = "gpr", .prefix = "r", .numRegs = 4, .callerSaved = 0x3} }},
+    .numClasses = 1,
+};
+
+inline constexpr TargetDesc RISC16{
+    .name = "risc16",
+    .classes = {{ {.name = "gpr", .prefix = "r", .numRegs = 16, .callerSaved = 0x00ff, .reserved = 0x8000} }},
+    .numClasses = 1,
+    .aliases = {{ {.name = "sp", .regClass = 0, .reg = 15} }},
+    .numAliases = 1,
+};
+
+inline constexpr TargetDesc RISC32{
+    .name = "risc32",
+    .classes = {{ {.name = "gpr", .prefix = "x", .numRegs = 32, .callerSaved = 0xf00000ff, .reserved = 0x5} }},
+    .numClasses = 1,
+    .aliases = {{
+        {.name = "zero", .regClass = 0, .reg = 0},
+        {.name = "sp", .regClass = 0, .reg = 2},
+    }},
+    .numAliases = 2,
+};
+
+/* Integer and floating point files; VRs from 10000 up are floating point */
+inline constexpr TargetDesc X86_64{
+    .name = "x86-64",
+    .classes = {{
+        {.name = "gpr", .prefix = "r", .numRegs = 16, .callerSaved = 0x0fc7, .reserved = 0x30, .bank = 0},
+        {.name = "xmm", .prefix = "xmm", .numRegs = 16, .callerSaved = 0xffff, .bank = 1},
+    }},
+    .numClasses = 2,
+    .aliases = {{
+        {.name = "rax", .regClass = 0, .reg = 0},
+        {.name = "rcx", .regClass = 0, .reg = 1},
+        {.name = "rdx", .regClass = 0, .reg = 2},
+        {.name = "rbx", .regClass = 0, .reg = 3},
+        {.name = "rsp", .regClass = 0, .reg = 4},
+        {.name = "rbp", .regClass = 0, .reg = 5},
+        {.name = "rsi", .regClass = 0, .reg = 6},
+        {.name = "rdi", .regClass = 0, .reg = 7},
+    }},
+    .numAliases = 8,
+    .vregRanges = {{ {.first = 10000, .last = 0x7fffffff, .regClass = 1} }},
+    .numVRegRanges = 1,
+};
+
+inline constexpr std::array<const TargetDesc*, 4> presets{&Tiny, &RISC16, &RISC32, &X86_64};
+
+}   // namespace targets
+
+/* Returns nullptr if no preset has that name */
+const TargetDesc* findTarget(std::string_view name);
+
+/**
+    A target read from a config file. The descriptor's names are views
+    into source, so a TargetConfig is neither copied nor moved.
+
+        # comment
+        target <name>
+        class <name> <prefix> <numRegs> [bank <n>] [caller <set>] [reserved <set>]
+        alias <name> <class> <index>
+        vregs <class> <first>-<last>
+
+    where <set> is a comma separated list of indices and ranges, e.g. 0-7,12.
+*/
+struct TargetConfig {
+    std::string source;
+    TargetDesc desc;
+
+    TargetConfig() = default;
+    TargetConfig(const TargetConfig&) = delete;
+    TargetConfig& operator=(const TargetConfig&) = delete;
+};
+
+// Throws std::runtime_error on a malformed or inconsistent config
+std::unique_ptr<TargetConfig> loadTarget(const std::string& filename);
+std::unique_ptr<TargetConfig> parseTarget(std::string source);
@@ -0,0 +1,87 @@
+/**
+    A work-stealing thread pool. Every worker owns a deque of tasks: it
+    pushes and pops its own work at the back, so a task that spawns
+    subtasks keeps running them hot in its cache, while idle workers
+    steal from the front of the other deques, taking the oldest and
+    typically largest pieces of work.
+
+    Tasks belong to a TaskGroup. wait() on a group returns once all of
+    its tasks have finished, and the waiting thread runs queued tasks
+    in the meantime, so a task may itself submit a group and wait for
+    it without tying up a worker. The first exception thrown by a task
+    of a group is rethrown by wait().
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    class TaskGroup {
+    public:
+        TaskGroup() = default;
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+    private:
+        friend class ThreadPool;
+        std::atomic<size_t> pending{0};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    // 0 workers picks std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned workers = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(threads.size()); }
+
+    void submit(TaskGroup& group, std::function<void()> task);
+    // Runs queued tasks until every task of group has finished
+    void wait(TaskGroup& group);
+
+    /* Runs body(i) for every i in [0, n) and waits for all of them */
+    template <typename Body>
+    void parallelFor(size_t n, Body&& body) {
+        TaskGroup group;
+        for (size_t i = 0; i < n; ++i)
+            submit(group, [&body, i] { body(i); });
+        wait(group);
+    }
+
+private:
+    struct Task {
+        TaskGroup* group;
+        std::function<void()> fn;
+    };
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(unsigned index);
+    bool tryRunOne(unsigned self);
+    void execute(Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> nextQueue{0};
+    std::atomic<size_t> queued{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
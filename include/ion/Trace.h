@@ -0,0 +1,112 @@
+/**
+    Chrome trace-event recording for `ion --trace`. The output is the
+    JSON object format that chrome://tracing and Perfetto load directly,
+    with one complete ("X") event per span and one track per thread.
+
+    Every thread appends to its own buffer, so recording a span takes
+    no lock: a thread links its buffer into the recorder once, with a
+    compare-and-swap on the head of a list, and afterwards only touches
+    memory it owns. writeJSON reads all buffers and must therefore run
+    after the traced work has finished.
+
+    Spans carry the name of the function they belong to, taken from the
+    innermost trace::FunctionScope of the thread. stats::Timer records a
+    span for every phase while a recorder is installed, so the pipeline
+    stages need no tracing code of their own.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class TraceRecorder {
+public:
+    TraceRecorder();
+    ~TraceRecorder();
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    /* Nanoseconds since the recorder was created */
+    uint64_t now() const;
+
+    // name must outlive the recorder; round < 0 marks a span outside the allocation rounds
+    void complete(const char* name, std::string_view function, uint64_t start, uint64_t end, int64_t round = -1);
+
+    void writeJSON(std::ostream& os) const;
+    size_t numEvents() const;
+
+private:
+    struct Event {
+        const char* name;
+        std::string function;
+        uint64_t start;
+        uint64_t duration;
+        int64_t round;
+    };
+    struct ThreadBuffer {
+        uint32_t tid;
+        std::vector<Event> events;
+        ThreadBuffer* next = nullptr;
+    };
+
+    ThreadBuffer& local();
+
+    uint64_t generation;
+    std::chrono::steady_clock::time_point origin;
+    std::atomic<ThreadBuffer*> head{nullptr};
+    std::atomic<uint32_t> nextTid{1};
+};
+
+namespace trace {
+
+inline std::atomic<TraceRecorder*> active{nullptr};
+
+// Installs r as the destination of every span; nullptr stops recording
+inline void enable(TraceRecorder* r) { active.store(r, std::memory_order_release); }
+
+inline TraceRecorder* current() { return active.load(std::memory_order_relaxed); }
+
+/* Name of the function the calling thread is working on, empty outside any FunctionScope */
+std::string_view currentFunction();
+
+/*
+    Labels the spans of the calling thread with a function name until
+    the scope ends. Worker threads open their own scope, since the label
+    is thread-local.
+**/
+class FunctionScope {
+public:
+    explicit FunctionScope(std::string_view function);
+    ~FunctionScope();
+    FunctionScope(const FunctionScope&) = delete;
+    FunctionScope& operator=(const FunctionScope&) = delete;
+
+private:
+    std::string_view previous;
+};
+
+class Span {
+public:
+    explicit Span(const char* name, int64_t round = -1) : recorder(current()), name(name), round(round) {
+        if (recorder) start = recorder->now();
+    }
+    ~Span() {
+        if (recorder) recorder->complete(name, currentFunction(), start, recorder->now(), round);
+    }
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    TraceRecorder* recorder;
+    const char* name;
+    int64_t round;
+    uint64_t start = 0;
+};
+
+}   // namespace trace
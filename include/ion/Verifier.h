@@ -0,0 +1,45 @@
+/**
+    Checks an allocated function without re-running liveness or
+    building an interference graph, so it is cheap enough to leave on
+    for every compile. One forward dataflow pass over the CFG tracks,
+    for each physical register and spill slot, which input VRs' current
+    values it holds, and every use is checked against the location its
+    VR was given.
+
+    Values are named by origin (Allocation::origin), so a spill
+    temporary carries the VR it reloads or stores. A def of a VR's
+    origin makes every other copy of the old value stale; a copy, a
+    spill store or a reload hands on the whole set its source holds. At
+    a merge a location keeps the values every predecessor agrees on.
+
+    A location holds nothing until something writes it. A read of a
+    value the location does not hold is forgiven only when some path
+    from the entry reaches it without defining the VR: reading it there
+    is undefined in the input program, not an allocation error. Only
+    failing reads pay for that search.
+
+    Each block's state holds one entry per value sitting in a location,
+    so a pass costs the instructions plus the states at block
+    boundaries, and RPO order makes the number of passes the loop
+    nesting depth plus two for a reducible CFG.
+
+    The pipeline runs it after the peephole pass, on the code it
+    writes. A reload turned into a copy moves values between locations
+    like any other copy. Self-moves stay in the IR until the Writer
+    drops them, since a MOV that changes no register still tells the
+    verifier which value the register now holds.
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "RegisterAllocator.h"
+#include "Target.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* Describes up to maxErrors uses that read the wrong value, in block order; empty if the allocation is sound */
+std::vector<std::string> verifyAllocation(const Function& fn, const Allocation& alloc, const TargetDesc& target,
+                                          size_t maxErrors = 16);
@@ -0,0 +1,44 @@
+/**
+    Graphviz dumps of the allocator's data structures, for debugging.
+    Nothing in the pipeline writes them; the CLI does on request
+    (--dot-cfg, --dot-interference). Each writer streams nodes and
+    edges straight to the output as it walks the structure, so dumping
+    a large function never builds the whole graph text in memory.
+
+    Node names are derived from block and VR ids rather than addresses,
+    so the same input always produces the same file.
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "InterferenceGraph.h"
+#include "Liveness.h"
+#include "RegisterAllocator.h"
+#include "Target.h"
+
+#include <ostream>
+
+struct DotOptions {
+    bool instructions = false;                  // list each block's instructions in its node
+    const LivenessResult* liveness = nullptr;   // annotate blocks with their LiveIn / LiveOut sets
+    /*
+        Print physical registers in place of VRs and, in interference
+        graphs, fill each node with a colour per register. Both must be
+        set together.
+    **/
+    const Allocation* allocation = nullptr;
+    const TargetDesc* target = nullptr;
+};
+
+void writeCFGDot(std::ostream& os, const Function& fn, const DotOptions& opts = {});
+
+/* One graph of the VRs in graph, an edge per interfering pair */
+void writeInterferenceDot(std::ostream& os, const InterferenceGraph& graph, const DotOptions& opts = {});
+
+/*
+    The colouring of an allocated function: recomputes liveness and
+    writes the interference graph of every register bank, one DOT graph
+    per bank, with nodes filled by their register.
+**/
+void writeColoringDot(std::ostream& os, Function& fn, const Allocation& alloc, const TargetDesc& target);
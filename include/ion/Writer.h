@@ -0,0 +1,89 @@
+/**
+    The output stage of iON. Writer emits a function either as .ion
+    text or in iON's binary format, with VRs replaced by physical
+    registers when given an Allocation. Copies whose source and
+    destination were given the same register are dropped, and spill
+    LOAD/STOREs address their slot as [slotN], which the Reader parses
+    back into spill code.
+
+    All output goes through one large buffer that is reused across
+    functions and filled with std::to_chars, so emitting an instruction
+    never allocates and the sink only sees a handful of large writes.
+*/
+
+#pragma once
+
+#include "CFG.h"
+#include "RegisterAllocator.h"
+#include "Target.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+    Binary format, all integers little-endian:
+
+        file     := "IONB" u8:version u32:numBlocks block*
+        block    := str:label u32:numInstrs instr*
+        instr    := u8:opcode u8:flags [operand:def] u8:numUses operand*
+                    u8:numTargets u32:blockIndex*
+        operand  := u8:kind i32:value
+        str      := u32:length bytes
+
+    flags bit 0 is set when the instruction has a def and bit 1 when it
+    is spill code. Operand kinds are the values of BinaryOperand.
+*/
+inline constexpr char kBinaryMagic[4] = {'I', 'O', 'N', 'B'};
+inline constexpr uint8_t kBinaryVersion = 1;
+
+enum class BinaryOperand : uint8_t {
+    VReg = 1,           // value = VR id
+    Immediate = 2,      // value = constant
+    PhysReg = 3,        // value = class << 8 | register
+    SpillSlot = 4       // value = slot index
+};
+
+class Writer {
+public:
+    enum class Format { Text, Binary };
+
+    static constexpr size_t kDefaultBufferSize = size_t{1} << 20;
+
+    // Flushes to a C stream, e.g. stdout or a file opened by the caller
+    explicit Writer(std::FILE* out, Format format = Format::Text, size_t bufferSize = kDefaultBufferSize);
+    // Appends to a string, e.g. for a reply or a cache entry
+    explicit Writer(std::string& out, Format format = Format::Text, size_t bufferSize = kDefaultBufferSize);
+    ~Writer();
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    /* Virtual-register IR, as read by Reader */
+    void write(const Function& fn);
+    /* Allocated IR */
+    void write(const Function& fn, const Allocation& alloc, const TargetDesc& target);
+
+    // Writing throws std::runtime_error when the C stream reports an error
+    void flush();
+
+private:
+    void writeText(const Function& fn, const Allocation* alloc, const TargetDesc* target);
+    void writeBinary(const Function& fn, const Allocation* alloc, const TargetDesc* target);
+
+    void ensure(size_t n);
+    void put(char c) { ensure(1); *cur++ = c; }
+    void put(std::string_view s);
+    void putInt(int64_t v);
+    void putU8(uint8_t v) { ensure(1); *cur++ = static_cast<char>(v); }
+    void putU32(uint32_t v);
+
+    std::FILE* file = nullptr;
+    std::string* str = nullptr;
+    Format format;
+    std::vector<char> buffer;
+    char* cur;
+    char* end;
+};
@@ -0,0 +1,36 @@
+/**
+    IRGenerator.h produces synthetic iON IR programs for benchmarks and
+    stress tests. The output is fully determined by the options: the
+    generator uses its own splitmix64 stream rather than <random>
+    distributions, whose results differ between standard libraries.
+
+    Programs are structured. The entry block defines `pressure` values
+    that stay live until the final block, which sums them up and
+    returns. In between, regions of blocks are either straight-line
+    (ending in JMP or a forward BEQ diamond) or loops, nested up to
+    loopDepth, of the form preheader / header / body / latch with a
+    small constant trip count, so every generated program terminates.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct GeneratorOptions {
+    uint64_t seed = 1;
+    size_t instructions = 1000;     // approximate size of the program
+    size_t blocks = 0;              // 0 picks one block per 16 instructions
+    unsigned loopDepth = 2;         // deepest loop nest
+    unsigned tripCount = 3;         // iterations of every generated loop
+    int vregs = 256;                // block-local VRs are drawn from a pool of this size
+    unsigned pressure = 8;          // values live across the whole function
+    double copyDensity = 0.1;       // fraction of instructions that are MOV %a, %b
+    bool diamonds = true;           // false: straight blocks always JMP on, so without loops the CFG is a chain
+};
+
+std::string generateIR(const GeneratorOptions& opts);
+
+// Throws std::runtime_error if the file cannot be written
+void generateIRFile(const GeneratorOptions& opts, const std::string& filename);
@@ -5,9 +5,12 @@
     frontend of iON. 
 */
 
+#pragma once
+
 #include "ion/IR.h"
 
 #include <array>
+#include <bit>
 #include <string_view>
 #include <charconv>
 #include <cstdint>
@@ -15,12 +18,13 @@
 
 /* Only used internally */
 struct Operand {
-    enum Kind : uint8_t { None, VR, Constant };
+    enum Kind : uint8_t { None, VR, Constant, Slot };
     Kind kind = None;
-    int32_t value = 0;      // reg number or constant
+    int32_t value = 0;      // reg number, constant or spill slot
 
     static Operand vr(int32_t r) { return {VR, r}; }
     static Operand imm(int32_t c) { return {Constant, c}; }
+    static Operand slot(int32_t s) { return {Slot, s}; }
 };
 
 /* 
@@ -30,32 +34,220 @@ struct Operand {
 struct ParsedInstr {
     enum Form : uint8_t {
         LabelDef,               // LABEL:
-        LoadImm,                // LOADI %1, 42
+        Load,                   // LOAD %1, 42
+        Store,                  // STORE %1, 42
         Copy,                   // MOV %1, %2
         BinaryOp,               // ADD %1, %2, %3
-        CondBranch1,            // NZ %1, T1, T2
+        CondBranch1,            // BZ %1, T1, T2
         CondBranch2,            // BEQ %1, %2, T1, T2
         Jump,                   // JMP T1
-        Ret                     // RET
+        Ret,                    // RET
+        Unknown,                // not an iON mnemonic
+        Malformed               // a known mnemonic missing some of its operands, or with a misplaced slot
     };
 
-    Form form;
-    std::string_view opcode;               // "ADD", "BEQ", etc.
-    std::optional<VReg> def;                           // single definition
+    Form form = Malformed;
+    std::string_view opcode = {};          // "ADD", "BEQ", etc.
+    OpCode op = OpCode::RET;               // valid unless form is Unknown or LabelDef
+    std::optional<VReg> def = {};                      // single definition
     std::array<Operands, 2> uses = {};
     uint8_t use_count = 0;
     std::array<std::optional<std::string_view>, 2> targets = {};
     uint8_t target_count = 0;
-    std::string_view label;                // only for LabelDef
+    bool spill = false;                    // LOAD %1, [slot2] or STORE %1, [slot2]: the address is a spill slot
+    std::string_view label = {};           // only for LabelDef
+};
+
+/**
+    The mnemonic table. Each OpCode's spelling comes from mnemonic() in
+    IR.h, the one the Writer prints, so the text the Writer emits is the
+    text the parser accepts. Lookup is a perfect hash on the first and
+    last characters and the length, its multiplier found at compile time.
+*/
+namespace mnemonics {
+
+struct Entry {
+    std::string_view name;
+    ParsedInstr::Form form;
+    OpCode op;
+    uint8_t tokens;         // the mnemonic and its operands
+};
+
+constexpr ParsedInstr::Form formOf(OpCode op) {
+    switch (op) {
+        case OpCode::ADD: case OpCode::SUB: case OpCode::MUL: return ParsedInstr::BinaryOp;
+        case OpCode::LOAD:  return ParsedInstr::Load;
+        case OpCode::STORE: return ParsedInstr::Store;
+        case OpCode::MOV:   return ParsedInstr::Copy;
+        case OpCode::RET:   return ParsedInstr::Ret;
+        case OpCode::JMP:   return ParsedInstr::Jump;
+        case OpCode::BEQ:   return ParsedInstr::CondBranch2;
+        case OpCode::BZ: case OpCode::BNZ: return ParsedInstr::CondBranch1;
+    }
+    return ParsedInstr::Unknown;
+}
+
+constexpr uint8_t tokensOf(ParsedInstr::Form form) {
+    switch (form) {
+        case ParsedInstr::Ret:         return 1;
+        case ParsedInstr::Jump:        return 2;
+        case ParsedInstr::BinaryOp:
+        case ParsedInstr::CondBranch1: return 4;
+        case ParsedInstr::CondBranch2: return 5;
+        default:                       return 3;
+    }
+}
+
+inline constexpr size_t kOpCodes = static_cast<size_t>(OpCode::BNZ) + 1;
+inline constexpr unsigned kTableBits = 5;
+static_assert(kOpCodes <= (1u << kTableBits));
+
+constexpr uint32_t key(std::string_view s) {
+    return static_cast<uint8_t>(s.front()) | static_cast<uint32_t>(static_cast<uint8_t>(s.back())) << 8 |
+           static_cast<uint32_t>(s.size()) << 16;
+}
+
+constexpr uint32_t slot(uint32_t k, uint32_t multiplier) {
+    return (k * multiplier) >> (32 - kTableBits);
+}
+
+/* The first odd multiplier under which no two mnemonics share a slot, 0 if none */
+constexpr uint32_t findMultiplier() {
+    for (uint32_t m = 0x9E3779B1u; m != 0x9E3779B1u + 2 * 100000; m += 2) {
+        uint32_t used = 0;
+        bool collides = false;
+        for (size_t i = 0; i < kOpCodes && !collides; ++i) {
+            uint32_t bit = 1u << slot(key(mnemonic(static_cast<OpCode>(i))), m);
+            collides = (used & bit) != 0;
+            used |= bit;
+        }
+        if (!collides) return m;
+    }
+    return 0;
+}
+
+inline constexpr uint32_t kMultiplier = findMultiplier();
+static_assert(kMultiplier != 0, "no collision-free multiplier for the mnemonic table");
+
+constexpr std::array<Entry, (1u << kTableBits)> buildTable() {
+    std::array<Entry, (1u << kTableBits)> table{};
+    for (auto& entry : table) entry.form = ParsedInstr::Unknown;
+    for (size_t i = 0; i < kOpCodes; ++i) {
+        auto op = static_cast<OpCode>(i);
+        Entry& entry = table[slot(key(mnemonic(op)), kMultiplier)];
+        entry = {mnemonic(op), formOf(op), op, tokensOf(formOf(op))};
+    }
+    return table;
+}
+
+inline constexpr std::array<Entry, (1u << kTableBits)> kTable = buildTable();
+
+/* The entry for a non-empty mnemonic, nullptr when it is not one */
+constexpr const Entry* lookup(std::string_view op) {
+    const Entry& entry = kTable[slot(key(op), kMultiplier)];
+    return entry.name == op ? &entry : nullptr;
+}
+
+constexpr bool everyMnemonicFound() {
+    for (size_t i = 0; i < kOpCodes; ++i) {
+        auto op = static_cast<OpCode>(i);
+        const Entry& entry = kTable[slot(key(mnemonic(op)), kMultiplier)];
+        if (entry.name != mnemonic(op) || entry.op != op) return false;
+    }
+    return true;
+}
+static_assert(everyMnemonicFound());
+
+}   // namespace mnemonics
+
+/* Character classes of a 64-byte block of text, one bit per byte */
+namespace scan {
+
+struct Masks {
+    uint64_t delimiters;    // space, comma or tab
+    uint64_t newlines;
 };
 
+/* The block of text at base; bytes past the end of text count as spaces */
+Masks classify(std::string_view text, size_t base);
+
+}   // namespace scan
+
 class InstrParser {
 public:
     std::optional<ParsedInstr> parse(std::string_view line);
+
+    /**
+        Parses a whole text, calling onInstr(parsed) for each line that
+        is not blank, in order: what parse() gives line by line. The
+        text is classified 64 bytes at a time across line boundaries,
+        and tokens are read off the bitmasks.
+    */
+    template <typename F>
+    void parseText(std::string_view text, F&& onInstr);
+
+    /* True when line is a label definition, without parsing it any further */
+    static bool isLabel(std::string_view line);
+
+    // The most tokens a line can hold: BEQ and its four operands, plus one to catch extras
+    static constexpr size_t kMaxTokens = 6;
+    using Tokens = std::array<std::string_view, kMaxTokens>;
+
+    /* Splits a line on spaces, commas and tabs; the vectorised and the plain version agree */
+    static int tokenize(std::string_view line, Tokens& out);
+    static int tokenizeScalar(std::string_view line, Tokens& out);
+
 private:
     using Form = ParsedInstr::Form;
-    static Form classify(std::string_view op);
-    static int tokenize(std::string_view line, std::array<std::string_view, 6>& out);
+    static ParsedInstr fromTokens(const Tokens& toks, int n);
     static Operand parse_operand(std::string_view tok);
     static std::string_view trim(std::string_view s);
-};
\ No newline at end of file
+};
+
+template <typename F>
+void InstrParser::parseText(std::string_view text, F&& onInstr) {
+    Tokens toks;
+    int n = 0;
+    size_t lineStart = 0, tokenStart = 0;
+    bool inToken = false, endsWithColon = false;
+
+    auto endToken = [&](size_t end) {
+        if (n < static_cast<int>(kMaxTokens)) toks[n++] = text.substr(tokenStart, end - tokenStart);
+        endsWithColon = text[end - 1] == ':';
+    };
+    auto endLine = [&](size_t end) {
+        if (n > 0) {
+            // Labels are rare and trimmed differently from instructions: parse() sorts them out
+            if (endsWithColon) {
+                if (auto label = parse(text.substr(lineStart, end - lineStart))) onInstr(*label);
+            } else {
+                onInstr(fromTokens(toks, n));
+            }
+        }
+        n = 0;
+        endsWithColon = false;
+        lineStart = end + 1;
+    };
+
+    for (size_t base = 0; base < text.size(); base += 64) {
+        scan::Masks m = scan::classify(text, base);
+        uint64_t separators = m.delimiters | m.newlines;
+        // Bit i set when byte i - 1 is a separator
+        uint64_t after = separators << 1 | (inToken ? 0 : 1);
+        uint64_t starts = ~separators & after;
+        uint64_t ends = separators & ~after;
+        for (uint64_t events = starts | ends | m.newlines; events != 0; events &= events - 1) {
+            unsigned i = std::countr_zero(events);
+            uint64_t bit = uint64_t{1} << i;
+            if (starts & bit) {
+                tokenStart = base + i;
+                continue;
+            }
+            if (ends & bit) endToken(base + i);
+            if (m.newlines & bit) endLine(base + i);
+        }
+        inToken = (separators >> 63) == 0;
+    }
+    if (inToken) endToken(text.size());
+    if (lineStart < text.size()) endLine(text.size());
+}
@@ -0,0 +1,262 @@
+/**
+    IRGenerator.cpp writes the program text directly into one string.
+    VR numbering is fixed by the options: %1..%loopDepth are the loop
+    counters (one per nesting level), the next `pressure` VRs are the
+    long-lived values, and the block-local temporaries cycle through a
+    pool of `vregs` VRs after those.
+*/
+
+#include "utils/h/IRGenerator.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+class SplitMix64 {
+public:
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t below(uint64_t n) { return n == 0 ? 0 : next() % n; }
+    bool chance(double p) { return static_cast<double>(next() >> 11) * 0x1.0p-53 < p; }
+
+private:
+    uint64_t state;
+};
+
+class Generator {
+public:
+    explicit Generator(const GeneratorOptions& opts)
+        : o(opts), rng(opts.seed),
+          numBlocks(std::max<size_t>(2, opts.blocks ? opts.blocks : opts.instructions / 16)),
+          perBlock(std::max<size_t>(1, opts.instructions / numBlocks)),
+          globalBase(static_cast<int>(opts.loopDepth) + 1),
+          localBase(globalBase + static_cast<int>(opts.pressure)) {}
+
+    std::string run() {
+        out.reserve(o.instructions * 20 + numBlocks * 8);
+        emitEntry();
+        emitRegion(1, numBlocks - 2, 0);
+        emitExit();
+        return std::move(out);
+    }
+
+private:
+    void put(std::string_view s) { out.append(s); }
+    void putInt(long long v) {
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        out.append(buf, res.ptr);
+    }
+    void reg(int v) { out += '%'; putInt(v); }
+    void label(size_t block) { out += 'B'; putInt(static_cast<long long>(block)); }
+
+    void beginBlock(size_t block) {
+        label(block);
+        put(":\n");
+        locals.clear();
+    }
+
+    void jump(size_t target) {
+        put("    JMP ");
+        label(target);
+        out += '\n';
+    }
+
+    /* A global, a local of this block, or an immediate */
+    void operand() {
+        uint64_t roll = rng.below(10);
+        if (roll < 4 && !locals.empty()) reg(locals[rng.below(locals.size())]);
+        else if (roll < 9 && o.pressure > 0) reg(globalBase + static_cast<int>(rng.below(o.pressure)));
+        else putInt(static_cast<long long>(rng.below(100)));
+    }
+
+    int freshLocal() {
+        return localBase + static_cast<int>(nextLocal++ % static_cast<size_t>(std::max(o.vregs, 1)));
+    }
+
+    void emitInstructions(size_t n) {
+        static constexpr std::string_view binops[] = {"ADD", "SUB", "MUL"};
+        for (size_t i = 0; i < n; ++i) {
+            bool haveSource = !locals.empty() || o.pressure > 0;
+            if (haveSource && rng.chance(o.copyDensity)) {
+                int d = freshLocal();
+                put("    MOV ");
+                reg(d);
+                put(", ");
+                if (!locals.empty() && (o.pressure == 0 || rng.chance(0.5)))
+                    reg(locals[rng.below(locals.size())]);
+                else reg(globalBase + static_cast<int>(rng.below(o.pressure)));
+                out += '\n';
+                locals.push_back(d);
+                continue;
+            }
+
+            // Occasionally update a long-lived value so it is redefined in loops
+            int d;
+            bool global = o.pressure > 0 && rng.chance(0.05);
+            if (global) d = globalBase + static_cast<int>(rng.below(o.pressure));
+            else d = freshLocal();
+
+            put("    ");
+            put(binops[rng.below(3)]);
+            out += ' ';
+            reg(d);
+            put(", ");
+            if (global) reg(d);
+            else operand();
+            put(", ");
+            operand();
+            out += '\n';
+            if (!global) locals.push_back(d);
+        }
+    }
+
+    size_t bodySize() {
+        // Jitter of +-50% keeps blocks from being uniform
+        return std::max<size_t>(1, perBlock / 2 + rng.below(perBlock + 1));
+    }
+
+    void emitEntry() {
+        beginBlock(0);
+        for (unsigned g = 0; g < o.pressure; ++g) {
+            put("    MOV ");
+            reg(globalBase + static_cast<int>(g));
+            put(", ");
+            putInt(static_cast<long long>(rng.below(1000)));
+            out += '\n';
+        }
+        jump(1);
+        out += '\n';
+    }
+
+    void emitExit() {
+        beginBlock(numBlocks - 1);
+        int sum = localBase + std::max(o.vregs, 1);
+        if (o.pressure == 1) {
+            put("    MOV ");
+            reg(sum);
+            put(", ");
+            reg(globalBase);
+            out += '\n';
+        }
+        for (unsigned g = 1; g < o.pressure; ++g) {
+            put("    ADD ");
+            reg(sum);
+            put(", ");
+            reg(g == 1 ? globalBase : sum);
+            put(", ");
+            reg(globalBase + static_cast<int>(g));
+            out += '\n';
+        }
+        put("    RET\n");
+    }
+
+    /* Blocks [first, first + count), all of which fall through to first + count */
+    void emitRegion(size_t first, size_t count, unsigned depth) {
+        size_t end = first + count;
+        size_t i = first;
+        while (i < end) {
+            size_t remaining = end - i;
+            if (depth < o.loopDepth && remaining >= 4 && rng.chance(0.35)) {
+                size_t size = 4 + rng.below(remaining - 3);
+                emitLoop(i, size, depth);
+                i += size;
+            } else {
+                emitStraight(i, end);
+                ++i;
+            }
+        }
+    }
+
+    void emitStraight(size_t block, size_t end) {
+        beginBlock(block);
+        emitInstructions(bodySize());
+        if (o.diamonds && block + 2 <= end && rng.chance(0.3)) {
+            put("    BEQ ");
+            operand();
+            put(", ");
+            putInt(static_cast<long long>(rng.below(100)));
+            put(", ");
+            label(block + 1);
+            put(", ");
+            label(block + 2);
+            out += '\n';
+        } else {
+            jump(block + 1);
+        }
+        out += '\n';
+    }
+
+    /* preheader, header, body region, latch; exits to first + size */
+    void emitLoop(size_t first, size_t size, unsigned depth) {
+        int counter = static_cast<int>(depth) + 1;
+        size_t header = first + 1;
+        size_t latch = first + size - 1;
+
+        beginBlock(first);
+        emitInstructions(bodySize());
+        put("    MOV ");
+        reg(counter);
+        put(", 0\n");
+        jump(header);
+        out += '\n';
+
+        beginBlock(header);
+        put("    BEQ ");
+        reg(counter);
+        put(", ");
+        putInt(o.tripCount);
+        put(", ");
+        label(first + size);
+        put(", ");
+        label(header + 1);
+        put("\n\n");
+
+        emitRegion(header + 1, size - 3, depth + 1);
+
+        beginBlock(latch);
+        emitInstructions(bodySize());
+        put("    ADD ");
+        reg(counter);
+        put(", ");
+        reg(counter);
+        put(", 1\n");
+        jump(header);
+        out += '\n';
+    }
+
+    const GeneratorOptions& o;
+    SplitMix64 rng;
+    size_t numBlocks;
+    size_t perBlock;
+    int globalBase;
+    int localBase;
+    size_t nextLocal = 0;
+    std::vector<int> locals;
+    std::string out;
+};
+
+}   // namespace
+
+std::string generateIR(const GeneratorOptions& opts) {
+    return Generator(opts).run();
+}
+
+void generateIRFile(const GeneratorOptions& opts, const std::string& filename) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("could not open " + filename);
+    std::string text = generateIR(opts);
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
@@ -1,5 +1,62 @@
 #include "utils/h/Parser.h"
 
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/* Classifies the 64 bytes at p */
+scan::Masks classifyBlock(const char* p) {
+    scan::Masks m{0, 0};
+
+#if defined(__SSE2__)
+    // 16 bytes at a time: compare against each character, one mask bit per byte
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (unsigned b = 0; b < 4; ++b) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + b * 16));
+        __m128i d = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, comma)),
+                                 _mm_cmpeq_epi8(v, tab));
+        m.delimiters |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(d))} << (b * 16);
+        m.newlines |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)))} << (b * 16);
+    }
+#else
+    // 8 bytes at a time in a word: the high bit of each byte equal to c, gathered into 8 bits
+    constexpr uint64_t kLow7 = 0x7F7F7F7F7F7F7F7Full;
+    auto equal = [](uint64_t w, char c) {
+        uint64_t x = w ^ (0x0101010101010101ull * static_cast<uint8_t>(c));
+        return ~(((x & kLow7) + kLow7) | x | kLow7);
+    };
+    auto gather = [](uint64_t highBits) { return ((highBits >> 7) * 0x0102040810204080ull) >> 56; };
+    for (unsigned b = 0; b < 8; ++b) {
+        uint64_t w;
+        std::memcpy(&w, p + b * 8, 8);
+        if constexpr (std::endian::native == std::endian::big) w = __builtin_bswap64(w);
+        m.delimiters |= gather(equal(w, ' ') | equal(w, ',') | equal(w, '\t')) << (b * 8);
+        m.newlines |= gather(equal(w, '\n')) << (b * 8);
+    }
+#endif
+
+    return m;
+}
+
+}   // namespace
+
+scan::Masks scan::classify(std::string_view text, size_t base) {
+    if (text.size() - base >= 64) return classifyBlock(text.data() + base);
+    // The tail is copied out: reading past the end of text could fault
+    char buf[64];
+    std::memset(buf, ' ', sizeof(buf));
+    std::memcpy(buf, text.data() + base, text.size() - base);
+    return classifyBlock(buf);
+}
+
 std::optional<ParsedInstr> InstrParser::parse(std::string_view line) {
     line = trim(line);
     if (line.empty()) return std::nullopt;
@@ -13,21 +70,37 @@ std::optional<ParsedInstr> InstrParser::parse(std::string_view line) {
     }
 
     // --- Tokenize ---
-    std::array<std::string_view, 6> toks;
+    Tokens toks;
     int n = tokenize(line, toks);
     if (n == 0) return std::nullopt;
+    return fromTokens(toks, n);
+}
 
+ParsedInstr InstrParser::fromTokens(const Tokens& toks, int n) {
     ParsedInstr instr{};
     instr.opcode = toks[0];
-    Form form = classify(toks[0]);
-    instr.form = form;
-
-    // Converts a parsed Operand token into the IR Operands variant
-    auto toOperands = [](Operand op) -> Operands {
+    const mnemonics::Entry* entry = mnemonics::lookup(toks[0]);
+    if (!entry) {
+        instr.form = ParsedInstr::Unknown;
+        return instr;
+    }
+    instr.op = entry->op;
+    instr.form = n < entry->tokens ? ParsedInstr::Malformed : entry->form;
+
+    // Converts a parsed Operand token into the IR Operands variant; a spill slot becomes its index
+    int slots = 0;
+    bool invalid = false;
+    auto toOperands = [&](Operand op) -> Operands {
+        slots += op.kind == Operand::Slot;
+        invalid |= op.kind == Operand::None;
         return (op.kind == Operand::VR) ? Operands{VReg{op.value}} : Operands{op.value};
     };
+    auto toDef = [&](Operand op) {
+        invalid |= op.kind != Operand::VR;
+        return VReg{op.value};
+    };
 
-    switch (form) {
+    switch (instr.form) {
     case ParsedInstr::Ret:
         // RET — nothing to extract
         break;
@@ -38,30 +111,32 @@ std::optional<ParsedInstr> InstrParser::parse(std::string_view line) {
         instr.target_count = 1;
         break;
 
-    case ParsedInstr::LoadImm:
-        // LOADI %1, 42
-        instr.def = VReg{parse_operand(toks[1]).value};
-        instr.uses[0] = toOperands(parse_operand(toks[2]));
-        instr.use_count = 1;
-        break;
-
+    case ParsedInstr::Load:
+        // LOAD %1, 42  (def = %1, use = the address)
     case ParsedInstr::Copy:
         // MOV %1, %2  (def = %1, use = %2)
-        instr.def = VReg{parse_operand(toks[1]).value};
+        instr.def = toDef(parse_operand(toks[1]));
         instr.uses[0] = toOperands(parse_operand(toks[2]));
         instr.use_count = 1;
         break;
 
+    case ParsedInstr::Store:
+        // STORE %1, 42  (uses = the value and the address)
+        instr.uses[0] = toOperands(parse_operand(toks[1]));
+        instr.uses[1] = toOperands(parse_operand(toks[2]));
+        instr.use_count = 2;
+        break;
+
     case ParsedInstr::BinaryOp:
         // ADD %1, %2, %3  (def = %1, uses = %2, %3)
-        instr.def = VReg{parse_operand(toks[1]).value};
+        instr.def = toDef(parse_operand(toks[1]));
         instr.uses[0] = toOperands(parse_operand(toks[2]));
         instr.uses[1] = toOperands(parse_operand(toks[3]));
         instr.use_count = 2;
         break;
 
     case ParsedInstr::CondBranch1:
-        // NZ %1, T1, T2
+        // BZ %1, T1, T2
         instr.uses[0] = toOperands(parse_operand(toks[1]));
         instr.use_count = 1;
         instr.targets[0] = toks[2];
@@ -80,36 +155,49 @@ std::optional<ParsedInstr> InstrParser::parse(std::string_view line) {
         break;
 
     default:
-        return std::nullopt;
+        // Malformed: the caller reports it
+        break;
+    }
+
+    // A bad VR or [slotN], a def that is not a VR, or a spill slot anywhere but the address of a LOAD or
+    // STORE, its last operand
+    if (invalid) {
+        instr.form = ParsedInstr::Malformed;
+    } else if (slots > 0) {
+        bool address = (instr.form == ParsedInstr::Load || instr.form == ParsedInstr::Store) && slots == 1 &&
+                       parse_operand(toks[2]).kind == Operand::Slot;
+        if (address) instr.spill = true;
+        else instr.form = ParsedInstr::Malformed;
     }
 
     return instr;
 }
 
+bool InstrParser::isLabel(std::string_view line) {
+    line = trim(line);
+    return !line.empty() && line.back() == ':';
+}
 
-// Map opcode string -> form.
-InstrParser::Form InstrParser::classify(std::string_view op) {
-    // Binary ops
-    if (op == "ADD" || op == "SUB" || op == "MUL" ||
-        op == "DIV" || op == "AND" || op == "OR")
-        return Form::BinaryOp;
-
-    // Branches
-    if (op == "BEQ" || op == "BNE" || op == "BLT" || op == "BGT")
-        return Form::CondBranch2;
-    if (op == "NZ" || op == "BZ")
-        return Form::CondBranch1;
-
-    if (op == "MOV")    return Form::Copy;
-    if (op == "LOADI")  return Form::LoadImm;
-    if (op == "JMP")    return Form::Jump;
-    if (op == "RET")    return Form::Ret;
+// Split line on commas and whitespace into token buffer. Zero alloc.
+int InstrParser::tokenize(std::string_view line, Tokens& out) {
+    if (line.empty() || line.size() > 64) return tokenizeScalar(line, out);
 
-    return Form::Ret; // fallback — you'd want an error path here
+    // Tokens are the runs of clear bits; each ends at the next set bit, the padding included
+    uint64_t delimiters = scan::classify(line, 0).delimiters;
+    uint64_t chars = ~delimiters;
+    int count = 0;
+    while (chars != 0 && count < static_cast<int>(out.size())) {
+        unsigned start = std::countr_zero(chars);
+        uint64_t rest = delimiters >> start;
+        unsigned length = rest != 0 ? std::countr_zero(rest) : 64 - start;
+        out[count++] = line.substr(start, length);
+        unsigned end = start + length;
+        chars = end >= 64 ? 0 : chars & (~uint64_t{0} << end);
+    }
+    return count;
 }
 
-// Split line on commas and whitespace into token buffer. Zero alloc.
-int InstrParser::tokenize(std::string_view line, std::array<std::string_view, 6>& out) {
+int InstrParser::tokenizeScalar(std::string_view line, Tokens& out) {
     int count = 0;
     size_t i = 0;
 
@@ -130,15 +218,34 @@ int InstrParser::tokenize(std::string_view line, std::array<std::string_view, 6>
 }
 
 Operand InstrParser::parse_operand(std::string_view tok) {
-    if (tok.front() == '%') {
-        int32_t reg = 0;
-        std::from_chars(tok.data() + 1, tok.data() + tok.size(), reg);
-        return Operand::vr(reg);
+    // [slotN], as the Writer prints the address of spill code
+    constexpr std::string_view kSlot = "[slot";
+    if (tok.front() == '[') {
+        if (tok.size() <= kSlot.size() + 1 || tok.substr(0, kSlot.size()) != kSlot || tok.back() != ']')
+            return Operand{};
+        Operand slot = parse_operand(tok.substr(kSlot.size(), tok.size() - kSlot.size() - 1));
+        return slot.kind == Operand::Constant && slot.value >= 0 ? Operand::slot(slot.value) : Operand{};
+    }
+
+    // What std::from_chars reads, without its overhead: an optional minus sign and decimal digits up to
+    // the first other character. A constant is 0 if there are none or they overflow; a VR is then invalid
+    bool reg = tok.front() == '%';
+    const char* p = tok.data() + reg;
+    const char* end = tok.data() + tok.size();
+    bool negative = p != end && *p == '-';
+    p += negative;
+    int64_t magnitude = 0;
+    for (; p != end && static_cast<unsigned>(*p - '0') < 10; ++p) {
+        if (magnitude <= INT32_MAX) magnitude = magnitude * 10 + (*p - '0');
+    }
+    if (reg) {
+        // A VR id indexes the passes' tables: digits only, and all of the token
+        const char* digits = tok.data() + 1;
+        if (negative || p == digits || p != end || magnitude > INT32_MAX) return Operand{};
+        return Operand::vr(static_cast<int32_t>(magnitude));
     }
-    // constant (possibly negative)
-    int32_t val = 0;
-    std::from_chars(tok.data(), tok.data() + tok.size(), val);
-    return Operand::imm(val);
+    if (magnitude > int64_t{INT32_MAX} + negative) magnitude = 0;
+    return Operand::imm(static_cast<int32_t>(negative ? -magnitude : magnitude));
 }
 
 std::string_view InstrParser::trim(std::string_view s) {
@@ -0,0 +1,68 @@
+/**
+    Replaces the global operator new of the ion executable with one that
+    counts allocations per thread, for the allocation column of
+    `ion --stats`. It is linked into the executable only: a program
+    embedding ion_lib keeps its own allocator, and a thread-local count
+    costs an increment with no atomic traffic on every allocation.
+*/
+
+#include "Stats.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local uint64_t tAllocations = 0;
+
+uint64_t threadAllocations() { return tAllocations; }
+
+[[maybe_unused]] const bool kInstalled = [] {
+    stats::allocationCounter.store(&threadAllocations, std::memory_order_relaxed);
+    return true;
+}();
+
+}   // namespace
+
+// Every form of new is replaced, so each block reaches the std::free of a delete that matches it
+
+void* operator new(size_t size) {
+    ++tAllocations;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    ++tAllocations;
+    return std::malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+
+// aligned_alloc wants a size that is a multiple of the alignment
+void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    ++tAllocations;
+    auto align = static_cast<size_t>(al);
+    size_t rounded = size ? (size + align - 1) / align * align : align;
+    return std::aligned_alloc(align, rounded);
+}
+void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t& tag) noexcept {
+    return operator new(size, al, tag);
+}
+void* operator new(size_t size, std::align_val_t al) {
+    if (void* p = operator new(size, al, std::nothrow)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t al) { return operator new(size, al); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
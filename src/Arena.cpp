@@ -0,0 +1,64 @@
+/**
+    Arena.cpp: the arena is a monotonic_buffer_resource over a buffer
+    the arena owns. Overflow goes to the heap through a counting
+    upstream, and the count decides how far the buffer grows on the
+    next release.
+*/
+
+#include "Arena.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+thread_local unsigned scopeDepth = 0;
+
+}   // namespace
+
+void* FunctionArena::Upstream::do_allocate(size_t n, size_t alignment) {
+    bytes += n;
+    return std::pmr::new_delete_resource()->allocate(n, alignment);
+}
+
+void FunctionArena::Upstream::do_deallocate(void* p, size_t n, size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, n, alignment);
+}
+
+FunctionArena::FunctionArena(size_t initialSize)
+    : buffer(std::make_unique_for_overwrite<std::byte[]>(initialSize)), bufferSize(initialSize) {
+    arena.emplace(buffer.get(), bufferSize, &upstream);
+}
+
+void* FunctionArena::do_allocate(size_t bytes, size_t alignment) {
+    return arena->allocate(bytes, alignment);
+}
+
+void FunctionArena::do_deallocate(void*, size_t, size_t) {
+    // Monotonic: memory comes back all at once in release()
+}
+
+void FunctionArena::release() {
+    arena->release();
+    if (upstream.bytes > 0 && bufferSize < kMaxRetained) {
+        // Big enough for the function that just overflowed it
+        size_t wanted = std::min(std::bit_ceil(bufferSize + upstream.bytes), kMaxRetained);
+        arena.reset();
+        buffer = std::make_unique_for_overwrite<std::byte[]>(wanted);
+        bufferSize = wanted;
+        arena.emplace(buffer.get(), bufferSize, &upstream);
+    }
+    upstream.bytes = 0;
+}
+
+FunctionArena& FunctionArena::forThisThread() {
+    thread_local FunctionArena arena;
+    return arena;
+}
+
+ArenaScope::ArenaScope() : arena(&FunctionArena::forThisThread()), outermost(scopeDepth++ == 0) {}
+
+ArenaScope::~ArenaScope() {
+    --scopeDepth;
+    if (outermost) arena->release();
+}
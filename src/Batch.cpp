@@ -0,0 +1,77 @@
+/**
+    Batch.cpp submits one task per file and then walks the results in
+    input order, sleeping on a condition variable until the next one in
+    line is ready. A failure is caught inside its task and recorded with
+    the file, so one bad input never stops the rest of the batch.
+*/
+
+#include "Batch.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+std::vector<std::string> readManifest(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) throw std::runtime_error("could not open manifest " + filename);
+
+    std::vector<std::string> files;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        files.push_back(line.substr(first, last - first + 1));
+    }
+    return files;
+}
+
+BatchSummary runBatch(const std::vector<std::string>& files, const PipelineOptions& opts, ThreadPool& pool,
+                      const std::function<void(BatchItem&)>& emit) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::optional<BatchItem>> results(files.size());
+    std::mutex mutex;
+    std::condition_variable ready;
+
+    ThreadPool::TaskGroup group;
+    for (size_t i = 0; i < files.size(); ++i) {
+        pool.submit(group, [&, i] {
+            BatchItem item{files[i], {}, {}};
+            try {
+                item.result = runPipeline(files[i], opts);
+            } catch (const std::exception& e) {
+                item.error = e.what();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            results[i].emplace(std::move(item));
+            ready.notify_all();
+        });
+    }
+
+    BatchSummary summary;
+    summary.files = files.size();
+    try {
+        for (size_t i = 0; i < files.size(); ++i) {
+            std::optional<BatchItem> item;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return results[i].has_value(); });
+                item.swap(results[i]);
+            }
+            if (!item->error.empty()) ++summary.failed;
+            emit(*item);
+        }
+    } catch (...) {
+        // The tasks still reference this frame
+        pool.wait(group);
+        throw;
+    }
+    pool.wait(group);
+
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return summary;
+}
@@ -0,0 +1,233 @@
+/**
+    Cache.cpp stores one entry per file:
+
+        entry := "IONC" u8:version u32:keyLength u32:outputLength key output
+
+    with integers little-endian. An entry whose size disagrees with its
+    header, or whose key differs from the one looked up, is a miss.
+*/
+
+#include "Cache.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Starts every key. Bump it with any change that can alter the output for the same input and options, in
+// the passes, the Writer or the options the key encodes; old entries then miss. 2: speculative spills
+constexpr uint32_t kAllocatorVersion = 2;
+
+constexpr char kEntryMagic[4] = {'I', 'O', 'N', 'C'};
+constexpr uint8_t kEntryVersion = 1;
+constexpr size_t kHeaderSize = sizeof(kEntryMagic) + 1 + 4 + 4;
+constexpr std::string_view kEntrySuffix = ".entry";
+constexpr std::string_view kTempPrefix = ".tmp-";
+// Temporary files this old belong to a writer that died
+constexpr auto kStaleTemp = std::chrono::hours(1);
+
+uint64_t fnv1a(std::string_view data) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+void putU32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out += static_cast<char>(v >> (8 * i) & 0xff);
+}
+
+void putU64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out += static_cast<char>(v >> (8 * i) & 0xff);
+}
+
+void putStr(std::string& out, std::string_view s) {
+    putU32(out, static_cast<uint32_t>(s.size()));
+    out += s;
+}
+
+uint32_t getU32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i);
+    return v;
+}
+
+/* Distinguishes the temporary files of concurrent writers, in this process and others */
+std::string tempName() {
+    static const uint64_t processToken = [] {
+        std::random_device rd;
+        return uint64_t{rd()} << 32 | rd();
+    }();
+    static std::atomic<uint64_t> counter{0};
+    char name[64];
+    std::snprintf(name, sizeof(name), "%.*s%016llx-%llu", static_cast<int>(kTempPrefix.size()), kTempPrefix.data(),
+                  static_cast<unsigned long long>(processToken),
+                  static_cast<unsigned long long>(counter.fetch_add(1, std::memory_order_relaxed)));
+    return name;
+}
+
+}   // namespace
+
+ResultCache::ResultCache(std::string dir, uint64_t limit) : directory(std::move(dir)), maxBytes(limit) {
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (!fs::is_directory(directory, ec))
+        throw std::runtime_error("could not create cache directory " + directory);
+}
+
+std::string ResultCache::key(const Function& fn, const TargetDesc& target, Writer::Format format, bool cleanup,
+                             bool speculativeSpills) {
+    std::string key = "ion-cache-key\n";
+    putU32(key, kAllocatorVersion);
+    key += static_cast<char>(format);
+    key += static_cast<char>(cleanup);
+    key += static_cast<char>(speculativeSpills);
+
+    // The register file; the target's name does not affect the output
+    putU32(key, target.numClasses);
+    for (unsigned i = 0; i < target.numClasses; ++i) {
+        const RegClass& rc = target.classes[i];
+        putStr(key, rc.name);
+        putStr(key, rc.prefix);
+        putU32(key, rc.numRegs);
+        putU64(key, rc.callerSaved);
+        putU64(key, rc.reserved);
+        putU32(key, rc.bank);
+    }
+    putU32(key, target.numAliases);
+    for (unsigned i = 0; i < target.numAliases; ++i) {
+        putStr(key, target.aliases[i].name);
+        key += static_cast<char>(target.aliases[i].regClass);
+        key += static_cast<char>(target.aliases[i].reg);
+    }
+    putU32(key, target.numVRegRanges);
+    for (unsigned i = 0; i < target.numVRegRanges; ++i) {
+        putU32(key, static_cast<uint32_t>(target.vregRanges[i].first));
+        putU32(key, static_cast<uint32_t>(target.vregRanges[i].last));
+        key += static_cast<char>(target.vregRanges[i].regClass);
+    }
+
+    Writer writer(key, Writer::Format::Binary, size_t{64} << 10);
+    writer.write(fn);
+    writer.flush();
+    return key;
+}
+
+std::string ResultCache::entryPath(uint64_t hash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return (fs::path(directory) / (std::string(name) + std::string(kEntrySuffix))).string();
+}
+
+bool ResultCache::lookup(std::string_view key, std::string& output) {
+    std::string path = entryPath(fnv1a(key));
+    bool hit = false;
+    if (std::FILE* in = std::fopen(path.c_str(), "rb")) {
+        thread_local std::string storedKey;
+        char header[kHeaderSize];
+        if (std::fread(header, 1, kHeaderSize, in) == kHeaderSize &&
+            std::string_view(header, sizeof(kEntryMagic)) == std::string_view(kEntryMagic, sizeof(kEntryMagic)) &&
+            static_cast<uint8_t>(header[4]) == kEntryVersion && getU32(header + 5) == key.size()) {
+            uint32_t outputLength = getU32(header + 9);
+            storedKey.resize(key.size());
+            if (std::fread(storedKey.data(), 1, key.size(), in) == key.size() && storedKey == key) {
+                output.resize(outputLength);
+                hit = std::fread(output.data(), 1, outputLength, in) == outputLength && std::fgetc(in) == EOF;
+                if (!hit) output.clear();
+            }
+        }
+        std::fclose(in);
+    }
+
+    if (hit) {
+        // Marks the entry as recently used for trim()
+        std::error_code ec;
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    }
+    stats::count(hit ? Counter::CacheHits : Counter::CacheMisses);
+    return hit;
+}
+
+void ResultCache::store(std::string_view key, std::string_view output) {
+    std::string header(kEntryMagic, sizeof(kEntryMagic));
+    header += static_cast<char>(kEntryVersion);
+    putU32(header, static_cast<uint32_t>(key.size()));
+    putU32(header, static_cast<uint32_t>(output.size()));
+
+    std::string temp = (fs::path(directory) / tempName()).string();
+    std::FILE* out = std::fopen(temp.c_str(), "wb");
+    if (!out) return;
+    bool ok = std::fwrite(header.data(), 1, header.size(), out) == header.size() &&
+              std::fwrite(key.data(), 1, key.size(), out) == key.size() &&
+              std::fwrite(output.data(), 1, output.size(), out) == output.size();
+    ok = std::fclose(out) == 0 && ok;
+
+    // rename() replaces an entry atomically, so readers never see a partial one
+    std::error_code ec;
+    if (ok) fs::rename(temp, entryPath(fnv1a(key)), ec);
+    if (!ok || ec) {
+        fs::remove(temp, ec);
+        return;
+    }
+
+    uint64_t written = writtenSinceTrim.fetch_add(header.size() + key.size() + output.size(),
+                                                  std::memory_order_relaxed);
+    if (written > maxBytes / 4 && !trimming.exchange(true, std::memory_order_acquire)) {
+        trim();
+        trimming.store(false, std::memory_order_release);
+    }
+}
+
+uint64_t ResultCache::trim() {
+    writtenSinceTrim.store(0, std::memory_order_relaxed);
+
+    struct Entry {
+        fs::file_time_type used;
+        uint64_t size;
+        fs::path path;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    uint64_t removed = 0;
+    auto now = fs::file_time_type::clock::now();
+
+    std::error_code ec;
+    for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code entryError;
+        std::string name = it->path().filename().string();
+        uint64_t size = it->file_size(entryError);
+        fs::file_time_type used = it->last_write_time(entryError);
+        if (entryError) continue;   // removed by another process meanwhile
+
+        if (name.compare(0, kTempPrefix.size(), kTempPrefix) == 0) {
+            if (now - used > kStaleTemp && fs::remove(it->path(), entryError)) removed += size;
+            continue;
+        }
+        if (name.size() <= kEntrySuffix.size() ||
+            name.compare(name.size() - kEntrySuffix.size(), kEntrySuffix.size(), kEntrySuffix) != 0)
+            continue;
+        entries.push_back({used, size, it->path()});
+        total += size;
+    }
+
+    if (total <= maxBytes) return removed;
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    for (const Entry& e : entries) {
+        if (total <= maxBytes) break;
+        // Another process may have evicted or replaced it first; either way it no longer counts
+        fs::remove(e.path, ec);
+        total -= e.size;
+        removed += e.size;
+    }
+    return removed;
+}
@@ -0,0 +1,316 @@
+/**
+    Implements copy propagation and dead code elimination. Copy
+    propagation is solved the way Liveness.cpp solves liveness: only
+    over the copies that can be used in another block than the one
+    making them, with a LiveSet per block since few copies are available
+    at any point. Dead code elimination works from the LiveOut sets of
+    LivenessAnalysis.
+*/
+
+#include "Cleanup.h"
+#include "LiveSet.h"
+#include "Liveness.h"
+#include "RegisterPressure.h"
+#include "Stats.h"
+
+#include <boost/dynamic_bitset.hpp>
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+// Made or read in more than one block
+constexpr int kManyBlocks = -2;
+
+size_t countVRegs(const Function& fn) {
+    boost::dynamic_bitset<> seen(maxVRegID(fn) + 1);
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.def.has_value()) seen.set(instr.def->id);
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use)) seen.set(reg->id);
+            }
+        }
+    }
+    return seen.count();
+}
+
+size_t countInstructions(const Function& fn) {
+    size_t n = 0;
+    for (const auto& block : fn.blocks)
+        n += block->instructions.size();
+    return n;
+}
+
+const VReg* copySource(const Instruction& instr) {
+    if (instr.op != OpCode::MOV || !instr.def.has_value()) return nullptr;
+    return std::get_if<VReg>(&instr.operands[0]);
+}
+
+}   // namespace
+
+unsigned propagateCopies(Function& fn) {
+    int numVars = maxVRegID(fn) + 1;
+    size_t N = fn.blocks.size();
+
+    // Index every distinct copy %dst <- %src, numbering instructions across the blocks laid end to
+    // end. A copy still holding at the end of a block is in its Gen set; Kill is all the copies
+    // mentioning a VR the block defines. Each VR notes the one block it is read in, and each copy
+    // the one block whose end it reaches, or kManyBlocks
+    std::vector<std::pair<int, int>> copies;
+    std::vector<int> madeAt, leftIn;
+    std::unordered_map<uint64_t, int> copyIndex;
+    std::vector<int> readIn(numVars, -1), defAt(numVars, -1);
+    std::vector<int> copyAt;                    // instruction -> its copy, or -1
+    std::vector<int> genStart, gen, defStart, defs;
+    std::vector<int> made;
+    auto note = [](int& where, int b) { where = where == -1 || where == b ? b : kManyBlocks; };
+    for (size_t b = 0; b < N; ++b) {
+        int first = static_cast<int>(copyAt.size());
+        genStart.push_back(static_cast<int>(gen.size()));
+        defStart.push_back(static_cast<int>(defs.size()));
+        for (const auto& instr : fn.blocks[b]->instructions) {
+            int i = static_cast<int>(copyAt.size());
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use)) note(readIn[reg->id], static_cast<int>(b));
+            }
+            if (instr.def.has_value()) {
+                if (defAt[instr.def->id] < first) defs.push_back(instr.def->id);
+                defAt[instr.def->id] = i;
+            }
+            const VReg* src = copySource(instr);
+            if (!src || src->id == instr.def->id) {
+                copyAt.push_back(-1);
+                continue;
+            }
+            uint64_t key = static_cast<uint64_t>(instr.def->id) << 32 | static_cast<uint32_t>(src->id);
+            auto [it, added] = copyIndex.try_emplace(key, static_cast<int>(copies.size()));
+            int c = it->second;
+            if (added) {
+                copies.emplace_back(instr.def->id, src->id);
+                madeAt.push_back(-1);
+                leftIn.push_back(-1);
+            }
+            if (madeAt[c] < first) made.push_back(c);
+            madeAt[c] = i;
+            copyAt.push_back(c);
+        }
+        for (int c : made) {
+            if (defAt[copies[c].first] == madeAt[c] && defAt[copies[c].second] < madeAt[c]) {
+                gen.push_back(c);
+                note(leftIn[c], static_cast<int>(b));
+            }
+        }
+        made.clear();
+    }
+    genStart.push_back(static_cast<int>(gen.size()));
+    defStart.push_back(static_cast<int>(defs.size()));
+    if (copies.empty()) return 0;
+
+    // Only a copy that reaches the end of a block and whose destination is read in another block can
+    // be used outside the block making it. Those are renumbered first and the dataflow is solved over
+    // them alone; any other copy only ever lives within its block's scan
+    size_t numCopies = copies.size();
+    auto global = [&](size_t c) {
+        int read = readIn[copies[c].first];
+        return leftIn[c] == kManyBlocks || (leftIn[c] != -1 && read != -1 && read != leftIn[c]);
+    };
+    std::vector<int> rank(numCopies);
+    size_t numGlobal = 0;
+    for (size_t c = 0; c < numCopies; ++c) {
+        if (global(c)) rank[c] = static_cast<int>(numGlobal++);
+    }
+    for (size_t c = 0, next = numGlobal; c < numCopies; ++c) {
+        if (!global(c)) rank[c] = static_cast<int>(next++);
+    }
+    {
+        std::vector<std::pair<int, int>> ranked(numCopies);
+        for (size_t c = 0; c < numCopies; ++c) ranked[rank[c]] = copies[c];
+        copies = std::move(ranked);
+        for (int& c : copyAt) {
+            if (c >= 0) c = rank[c];
+        }
+        for (int& c : gen) c = rank[c];
+    }
+
+    // The copies mentioning each VR, and those into it, as flat lists indexed by VR
+    std::vector<int> involvingStart(numVars + 1, 0), byDestStart(numVars + 1, 0);
+    for (const auto& [dst, src] : copies) {
+        ++involvingStart[dst + 1];
+        ++involvingStart[src + 1];
+        ++byDestStart[dst + 1];
+    }
+    for (int v = 0; v < numVars; ++v) {
+        involvingStart[v + 1] += involvingStart[v];
+        byDestStart[v + 1] += byDestStart[v];
+    }
+    std::vector<int> involving(involvingStart.back()), byDest(byDestStart.back());
+    {
+        std::vector<int> fillInvolving(involvingStart.begin(), involvingStart.end() - 1);
+        std::vector<int> fillByDest(byDestStart.begin(), byDestStart.end() - 1);
+        for (size_t c = 0; c < numCopies; ++c) {
+            auto [dst, src] = copies[c];
+            involving[fillInvolving[dst]++] = static_cast<int>(c);
+            involving[fillInvolving[src]++] = static_cast<int>(c);
+            byDest[fillByDest[dst]++] = static_cast<int>(c);
+        }
+    }
+
+    // AvailIn(B) = ∩ P ∈ preds(B): AvailOut(P), AvailOut(B) = Gen(B) | (AvailIn(B) & ~Kill(B)),
+    // over the global copies. Few of them hold at any point, so the sets are LiveSets. A block not
+    // yet visited stands for every copy, and AvailIn is not kept but recomputed into in
+    std::pmr::memory_resource* resource = fn.resource();
+    std::vector<LiveSet> availOut;
+    std::vector<uint8_t> visited(N, 0);
+    LiveSet in(numGlobal, resource), out(numGlobal, resource);
+    auto availIn = [&](size_t b) {
+        in.clear();
+        if (b == 0) return;
+        bool first = true;
+        for (const BasicBlock* pred : fn.blocks[b]->predecessors) {
+            if (!visited[pred->id]) continue;
+            if (first) in = availOut[pred->id];
+            else in &= availOut[pred->id];
+            first = false;
+        }
+    };
+    if (numGlobal > 0) {
+        // The global copies come first in each block's Gen list once it is sorted
+        for (size_t b = 0; b < N; ++b) std::sort(gen.begin() + genStart[b], gen.begin() + genStart[b + 1]);
+        std::vector<int> definedIn(numVars, -1);
+        std::vector<uint32_t> members;
+        availOut.reserve(N);
+        for (size_t b = 0; b < N; ++b) availOut.emplace_back(numGlobal, resource);
+
+        // Predecessors come first in reverse postorder, so only loops take more than one pass
+        std::pmr::vector<int> order = reversePostorder(fn, resource);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int b : order) {
+                availIn(b);
+                for (int d = defStart[b]; d < defStart[b + 1]; ++d) definedIn[defs[d]] = b;
+                members.clear();
+                in.forEach([&](uint32_t c) {
+                    if (definedIn[copies[c].first] != b && definedIn[copies[c].second] != b) members.push_back(c);
+                });
+                // A copy in Gen defines its destination here, so it was not kept from AvailIn
+                auto kept = static_cast<std::ptrdiff_t>(members.size());
+                for (int g = genStart[b]; g < genStart[b + 1] && static_cast<size_t>(gen[g]) < numGlobal; ++g)
+                    members.push_back(static_cast<uint32_t>(gen[g]));
+                std::inplace_merge(members.begin(), members.begin() + kept, members.end());
+                out.assignSorted(members);
+                if (!visited[b] || !(out == availOut[b])) {
+                    visited[b] = 1;
+                    changed = true;
+                    availOut[b].swap(out);
+                }
+            }
+        }
+    }
+
+    // Both kinds of copy share one set: the global ones are seeded from AvailIn, and every bit
+    // set in a block is cleared again before the next. A def kills every copy that mentions its
+    // VR; a copy then makes itself available
+    unsigned rewritten = 0;
+    boost::dynamic_bitset<> avail(numCopies);
+    for (size_t b = 0, i = 0; b < N; ++b) {
+        if (numGlobal > 0) {
+            availIn(b);
+            in.forEach([&](uint32_t c) {
+                avail.set(c);
+                made.push_back(static_cast<int>(c));
+            });
+        }
+        for (auto& instr : fn.blocks[b]->instructions) {
+            int copy = copyAt[i++];
+            for (auto& use : instr.operands) {
+                auto* reg = std::get_if<VReg>(&use);
+                if (!reg) continue;
+                // Follow chains %a <- %b <- %c; each step is a distinct available copy
+                for (size_t step = 0; step < numCopies; ++step) {
+                    int next = -1;
+                    for (int k = byDestStart[reg->id]; k < byDestStart[reg->id + 1]; ++k) {
+                        if (avail[byDest[k]]) { next = copies[byDest[k]].second; break; }
+                    }
+                    if (next < 0) break;
+                    reg->id = next;
+                    ++rewritten;
+                }
+            }
+            if (!instr.def.has_value()) continue;
+            int v = instr.def->id;
+            for (int k = involvingStart[v]; k < involvingStart[v + 1]; ++k) avail.reset(involving[k]);
+            if (copy >= 0) {
+                avail.set(copy);
+                made.push_back(copy);
+            }
+        }
+        for (int c : made) avail.reset(c);
+        made.clear();
+    }
+    return rewritten;
+}
+
+unsigned eliminateDeadCode(Function& fn) {
+    LivenessAnalysis la;
+    LivenessResult lr = la.analyse(fn);
+    int numVars = maxVRegID(fn) + 1;
+
+    unsigned removed = 0;
+    boost::dynamic_bitset<> live(numVars);
+    for (auto& block : fn.blocks) {
+        live.reset();
+        for (int v : lr.liveoutSet[block->id])
+            live.set(v);
+
+        auto& instrs = block->instructions;
+        std::vector<uint8_t> dead(instrs.size(), 0);
+        for (size_t i = instrs.size(); i-- > 0;) {
+            const Instruction& instr = instrs[i];
+            const VReg* src = copySource(instr);
+            bool selfCopy = src && src->id == instr.def->id;
+            if (instr.def.has_value() && (!live[instr.def->id] || selfCopy)) {
+                // The def is never read: drop it, and do not make its uses live
+                dead[i] = 1;
+                ++removed;
+                continue;
+            }
+            if (instr.def.has_value()) live.reset(instr.def->id);
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use)) live.set(reg->id);
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t i = 0; i < instrs.size(); ++i) {
+            if (dead[i]) continue;
+            // Moving an instruction onto itself would empty its labels
+            if (kept != i) instrs[kept] = std::move(instrs[i]);
+            ++kept;
+        }
+        instrs.resize(kept);
+    }
+    return removed;
+}
+
+CleanupStats cleanupFunction(Function& fn) {
+    trace::FunctionScope scope(fn.name);
+    stats::Timer timer(Phase::Cleanup);
+    CleanupStats stats;
+    stats.instructionsBefore = countInstructions(fn);
+    stats.vregsBefore = countVRegs(fn);
+
+    while (true) {
+        ++stats.iterations;
+        unsigned propagated = propagateCopies(fn);
+        unsigned removed = eliminateDeadCode(fn);
+        stats.propagatedUses += propagated;
+        stats.deadInstructions += removed;
+        if (propagated == 0 && removed == 0) break;
+    }
+
+    stats.instructionsAfter = countInstructions(fn);
+    stats.vregsAfter = countVRegs(fn);
+    return stats;
+}
@@ -0,0 +1,67 @@
+/**
+    Copy coalescing over the interference graph. Merges are applied to
+    the graph directly rather than by rewriting the IR and rebuilding,
+    and the pass sweeps the copies until a sweep merges nothing.
+*/
+
+#include "GraphCoalescing.h"
+
+int findAlias(std::vector<int>& alias, int v) {
+    while (alias[v] != v) {
+        alias[v] = alias[alias[v]];
+        v = alias[v];
+    }
+    return v;
+}
+
+namespace {
+
+/* Briggs: fewer than k neighbours of the merged node have degree >= k */
+bool briggsSafe(const InterferenceGraph& graph, int a, int b, unsigned k) {
+    const auto& na = graph.neighbours(a);
+    const auto& nb = graph.neighbours(b);
+    unsigned significant = 0;
+    size_t i = 0, j = 0;
+
+    // Both lists are sorted; walk the union once
+    while (i < na.size() || j < nb.size()) {
+        int n;
+        if (j == nb.size() || (i < na.size() && na[i] < nb[j])) n = na[i++];
+        else if (i == na.size() || nb[j] < na[i]) n = nb[j++];
+        else { n = na[i]; ++i; ++j; }
+
+        // A common neighbour loses one edge once a and b become one node
+        size_t deg = graph.degree(n);
+        if (graph.interferes(n, a) && graph.interferes(n, b)) --deg;
+        if (deg >= k && ++significant >= k) return false;
+    }
+    return true;
+}
+
+}   // namespace
+
+unsigned coalesceCopies(const Function& fn, InterferenceGraph& graph, unsigned k, std::vector<int>& alias) {
+    unsigned coalesced = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& block : fn.blocks) {
+            for (const Instruction& instr : block->instructions) {
+                if (instr.op != OpCode::MOV || !instr.def.has_value()) continue;
+                const VReg* src = std::get_if<VReg>(&instr.operands[0]);
+                if (!src) continue;
+
+                int a = findAlias(alias, instr.def->id);
+                int b = findAlias(alias, src->id);
+                if (a == b || !graph.isNode(a) || !graph.isNode(b)) continue;
+                if (graph.interferes(a, b) || !briggsSafe(graph, a, b, k)) continue;
+
+                graph.merge(a, b);
+                alias[b] = a;
+                ++coalesced;
+                changed = true;
+            }
+        }
+    }
+    return coalesced;
+}
@@ -0,0 +1,273 @@
+/**
+    Implements the simplify and select phases of the Chaitin-Briggs
+    allocator from EaC. Spill candidates are taken from a lazy min-heap
+    keyed on cost/degree or cost/degree^2; a node's degree only ever falls during
+    simplify, so its key only rises and a stale entry can be refreshed
+    and pushed back when it reaches the top.
+
+    Simplify and select never look beyond a node's neighbours, so each
+    connected component of the graph is coloured on its own. Components
+    are found with union-find and numbered by their lowest node, and a
+    large graph's components are coloured as tasks on the thread pool.
+    The per-node scratch is shared: components are disjoint, so no two
+    tasks touch the same element.
+
+    Select is a template over the register file width; colorGraph picks
+    the 16, 32 or 64-bit instantiation from the allocatable set.
+*/
+
+#include "GraphColoring.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <span>
+
+namespace {
+
+// Components are handed to tasks in batches of at least this much work (nodes plus edges)
+constexpr size_t kComponentGrain = 4096;
+
+/* Per-node state, indexed by node and shared by every component */
+struct Scratch {
+    std::vector<size_t> degree;
+    std::vector<uint8_t> removed;
+
+    explicit Scratch(size_t numNodes) : degree(numNodes, 0), removed(numNodes, 0) {}
+};
+
+/* Lists one simplify run needs, kept by a task from one component to the next */
+struct Worklists {
+    using Candidate = std::pair<float, int>;
+    std::vector<int> stack;
+    std::vector<int> lowDegree;
+    std::vector<Candidate> candidates;      // min-heap
+};
+
+/* Nodes of each component, ascending within it; components ordered by their lowest node */
+struct Components {
+    std::vector<int> nodes;
+    std::vector<size_t> start;              // component c is nodes[start[c], start[c + 1])
+    size_t count() const { return start.size() - 1; }
+};
+
+int findRoot(std::vector<int>& parent, int n) {
+    while (parent[n] != n) {
+        parent[n] = parent[parent[n]];
+        n = parent[n];
+    }
+    return n;
+}
+
+Components components(const InterferenceGraph& graph) {
+    int numNodes = graph.numNodes();
+    std::vector<int> parent(numNodes);
+    std::vector<int> size(numNodes, 1);
+    for (int n = 0; n < numNodes; ++n) parent[n] = n;
+    size_t sets = 0;
+    for (int n = 0; n < numNodes; ++n) sets += graph.isNode(n);
+    // Once everything is one set the remaining edges cannot join anything
+    for (int n = 0; n < numNodes && sets > 1; ++n) {
+        if (!graph.isNode(n)) continue;
+        // a stays the root of n's set: after a union it is the larger of the two roots
+        int a = findRoot(parent, n);
+        const auto& adj = graph.neighbours(n);
+        for (auto it = std::upper_bound(adj.begin(), adj.end(), n); it != adj.end(); ++it) {
+            if (parent[*it] == a) continue;
+            int b = findRoot(parent, *it);
+            if (a == b) continue;
+            if (size[a] < size[b]) std::swap(a, b);
+            parent[b] = a;
+            size[a] += size[b];
+            --sets;
+        }
+    }
+
+    // Numbering roots in node order numbers every component by its lowest node
+    std::vector<int> index(numNodes, -1);
+    std::vector<size_t> counts;
+    for (int n = 0; n < numNodes; ++n) {
+        if (!graph.isNode(n)) continue;
+        int& c = index[findRoot(parent, n)];
+        if (c < 0) {
+            c = static_cast<int>(counts.size());
+            counts.push_back(0);
+        }
+        ++counts[c];
+    }
+
+    Components result;
+    result.start.assign(counts.size() + 1, 0);
+    for (size_t c = 0; c < counts.size(); ++c)
+        result.start[c + 1] = result.start[c] + counts[c];
+    result.nodes.resize(result.start.back());
+    std::vector<size_t> fill(result.start.begin(), result.start.end() - 1);
+    for (int n = 0; n < numNodes; ++n) {
+        if (graph.isNode(n)) result.nodes[fill[index[findRoot(parent, n)]]++] = n;
+    }
+    return result;
+}
+
+/* Leaves nodes, in the order simplify removed them, in lists.stack */
+void simplify(const InterferenceGraph& graph, std::span<const int> nodes, unsigned k,
+              const std::vector<float>& spillCost, SpillDivisor divisor, Scratch& scratch, Worklists& lists) {
+    std::vector<size_t>& degree = scratch.degree;
+    std::vector<uint8_t>& removed = scratch.removed;
+    std::vector<int>& stack = lists.stack;
+    std::vector<int>& lowDegree = lists.lowDegree;
+    auto& candidates = lists.candidates;
+    stack.clear();
+    lowDegree.clear();
+    candidates.clear();
+
+    auto key = [&](int n) {
+        float d = static_cast<float>(degree[n] + 1);
+        return spillCost[n] / (divisor == SpillDivisor::DegreeSquared ? d * d : d);
+    };
+    auto push = [&](float cost, int n) {
+        candidates.push_back({cost, n});
+        std::push_heap(candidates.begin(), candidates.end(), std::greater<>());
+    };
+
+    for (int n : nodes) {
+        degree[n] = graph.degree(n);
+        if (degree[n] < k) lowDegree.push_back(n);
+        else push(key(n), n);
+    }
+
+    auto remove = [&](int n) {
+        removed[n] = 1;
+        stack.push_back(n);
+        for (int m : graph.neighbours(n)) {
+            if (removed[m]) continue;
+            if (degree[m]-- == k) lowDegree.push_back(m);
+        }
+    };
+
+    while (stack.size() < nodes.size()) {
+        if (!lowDegree.empty()) {
+            int n = lowDegree.back();
+            lowDegree.pop_back();
+            if (!removed[n]) remove(n);
+            continue;
+        }
+
+        // Every remaining node is significant: push the cheapest optimistically
+        std::pop_heap(candidates.begin(), candidates.end(), std::greater<>());
+        auto [cost, n] = candidates.back();
+        candidates.pop_back();
+        if (removed[n]) continue;
+        if (cost != key(n)) {
+            push(key(n), n);
+            continue;
+        }
+        remove(n);
+    }
+}
+
+/* Select over one stack, with colours kept as one-hot words; 0 while uncoloured, so no branch is needed */
+template <unsigned K>
+void selectInto(const InterferenceGraph& graph, const std::vector<int>& stack, uint64_t allocatable,
+                uint64_t preferred, std::vector<int>& color, std::vector<ColorWord<K>>& colorBit,
+                std::vector<int>& spilled) {
+    using Word = ColorWord<K>;
+    const Word allowed = static_cast<Word>(allocatable);
+    const Word prefer = static_cast<Word>(preferred);
+
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+        int n = *it;
+        Word used = 0;
+        for (int m : graph.neighbours(n))
+            used |= colorBit[m];
+
+        Word free = allowed & static_cast<Word>(~used);
+        if (free == 0) {
+            spilled.push_back(n);
+            continue;
+        }
+        Word pick = (free & prefer) ? (free & prefer) : free;
+        int r = std::countr_zero(pick);
+        color[n] = r;
+        colorBit[n] = static_cast<Word>(Word{1} << r);
+    }
+}
+
+template <unsigned K>
+ColoringResult colorComponents(const InterferenceGraph& graph, uint64_t allocatable, uint64_t preferred,
+                               const std::vector<float>& spillCost, ThreadPool* pool, SpillDivisor divisor) {
+    unsigned k = static_cast<unsigned>(std::popcount(allocatable));
+    Components comps = components(graph);
+    Scratch scratch(graph.numNodes());
+    std::vector<ColorWord<K>> colorBit(graph.numNodes(), 0);
+    ColoringResult result;
+    result.color.assign(graph.numNodes(), -1);
+
+    auto work = [&](size_t c) {
+        size_t w = comps.start[c + 1] - comps.start[c];
+        for (size_t i = comps.start[c]; i < comps.start[c + 1]; ++i) w += graph.degree(comps.nodes[i]);
+        return w;
+    };
+    bool parallel = pool && pool->size() > 1 && comps.count() > 1 && comps.nodes.size() >= kParallelColoringThreshold;
+
+    // Consecutive components make up a batch; batches' spills are joined in order,
+    // so the result is the same however the components were batched
+    std::vector<size_t> batchStart{0};
+    if (parallel) {
+        size_t total = comps.nodes.size() + 2 * graph.numEdges();
+        size_t grain = std::max(kComponentGrain, total / (8 * pool->size()));
+        size_t acc = 0;
+        for (size_t c = 0; c < comps.count(); ++c) {
+            acc += work(c);
+            if (acc >= grain && c + 1 < comps.count()) {
+                batchStart.push_back(c + 1);
+                acc = 0;
+            }
+        }
+    }
+    batchStart.push_back(comps.count());
+    size_t batches = batchStart.size() - 1;
+
+    std::vector<std::vector<int>> spilled(batches);
+    auto colorBatch = [&](size_t b) {
+        Worklists lists;
+        for (size_t c = batchStart[b]; c < batchStart[b + 1]; ++c) {
+            std::span<const int> nodes(comps.nodes.data() + comps.start[c], comps.start[c + 1] - comps.start[c]);
+            simplify(graph, nodes, k, spillCost, divisor, scratch, lists);
+            selectInto<K>(graph, lists.stack, allocatable, preferred, result.color, colorBit, spilled[b]);
+        }
+    };
+    if (parallel && batches > 1) pool->parallelFor(batches, colorBatch);
+    else colorBatch(0);
+
+    for (auto& s : spilled)
+        result.spilled.insert(result.spilled.end(), s.begin(), s.end());
+    return result;
+}
+
+}   // namespace
+
+template <unsigned K>
+void selectColors(const InterferenceGraph& graph, const std::vector<int>& stack,
+                  uint64_t allocatable, uint64_t preferred, ColoringResult& result) {
+    result.color.assign(graph.numNodes(), -1);
+    std::vector<ColorWord<K>> colorBit(graph.numNodes(), 0);
+    selectInto<K>(graph, stack, allocatable, preferred, result.color, colorBit, result.spilled);
+}
+
+template void selectColors<16>(const InterferenceGraph&, const std::vector<int>&,
+                               uint64_t, uint64_t, ColoringResult&);
+template void selectColors<32>(const InterferenceGraph&, const std::vector<int>&,
+                               uint64_t, uint64_t, ColoringResult&);
+template void selectColors<64>(const InterferenceGraph&, const std::vector<int>&,
+                               uint64_t, uint64_t, ColoringResult&);
+
+ColoringResult colorGraph(const InterferenceGraph& graph, uint64_t allocatable, uint64_t preferred,
+                          const std::vector<float>& spillCost, ThreadPool* pool, SpillDivisor divisor) {
+    // The highest allocatable register decides which word it fits in
+    int width = std::bit_width(allocatable);
+    if (width <= 16)
+        return colorComponents<16>(graph, allocatable, preferred, spillCost, pool, divisor);
+    if (width <= 32)
+        return colorComponents<32>(graph, allocatable, preferred, spillCost, pool, divisor);
+    return colorComponents<64>(graph, allocatable, preferred, spillCost, pool, divisor);
+}
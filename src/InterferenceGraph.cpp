@@ -0,0 +1,115 @@
+/**
+    Builds the interference graph from the LiveOut sets computed by
+    LivenessAnalysis. Edges are collected unsorted while walking the
+    blocks and are sorted and deduplicated once in finalise(), which
+    is cheaper than keeping every list ordered during construction.
+*/
+
+#include "InterferenceGraph.h"
+#include "SparseSet.h"
+
+#include <algorithm>
+
+// Each adjacency list takes adj's allocator, so the whole graph lives in resource
+InterferenceGraph::InterferenceGraph(int numNodes, std::pmr::memory_resource* resource)
+    : adj(numNodes, resource), present(numNodes, 0, resource) {}
+
+void InterferenceGraph::addNode(int n) {
+    present[n] = 1;
+}
+
+void InterferenceGraph::addEdge(int a, int b) {
+    if (a == b) return;
+    adj[a].push_back(b);
+    adj[b].push_back(a);
+}
+
+void InterferenceGraph::finalise() {
+    for (auto& list : adj) {
+        std::sort(list.begin(), list.end());
+        list.erase(std::unique(list.begin(), list.end()), list.end());
+    }
+}
+
+bool InterferenceGraph::interferes(int a, int b) const {
+    const auto& shorter = adj[a].size() <= adj[b].size() ? adj[a] : adj[b];
+    int other = adj[a].size() <= adj[b].size() ? b : a;
+    return std::binary_search(shorter.begin(), shorter.end(), other);
+}
+
+void InterferenceGraph::merge(int a, int b) {
+    for (int n : adj[b]) {
+        auto& nList = adj[n];
+        nList.erase(std::lower_bound(nList.begin(), nList.end(), b));
+        auto pos = std::lower_bound(nList.begin(), nList.end(), a);
+        if (n == a || (pos != nList.end() && *pos == a)) continue;
+        nList.insert(pos, a);
+
+        auto aPos = std::lower_bound(adj[a].begin(), adj[a].end(), n);
+        adj[a].insert(aPos, n);
+    }
+    adj[b].clear();
+    present[b] = 0;
+}
+
+size_t InterferenceGraph::numEdges() const {
+    size_t total = 0;
+    for (const auto& list : adj)
+        total += list.size();
+    return total / 2;
+}
+
+std::vector<int> InterferenceGraph::nodes() const {
+    std::vector<int> result;
+    for (int n = 0; n < numNodes(); ++n) {
+        if (present[n]) result.push_back(n);
+    }
+    return result;
+}
+
+InterferenceGraph buildInterferenceGraph(const Function& fn, const LivenessResult& lr,
+                                         const std::vector<uint8_t>& regClass,
+                                         const std::vector<unsigned>& classBank,
+                                         unsigned bank,
+                                         std::pmr::memory_resource* resource) {
+    int numVRegs = static_cast<int>(regClass.size());
+    InterferenceGraph graph(numVRegs, resource);
+    auto inBank = [&](int v) { return classBank[regClass[v]] == bank; };
+
+    SparseSet live(numVRegs, resource);
+    for (const auto& block : fn.blocks) {
+        live.clear();
+        if (auto it = lr.liveoutSet.find(block->id); it != lr.liveoutSet.end()) {
+            for (int v : it->second) {
+                if (v < numVRegs && inBank(v)) live.insert(v);
+            }
+        }
+
+        for (auto it = block->instructions.rbegin(); it != block->instructions.rend(); ++it) {
+            const Instruction& instr = *it;
+
+            if (instr.def.has_value() && inBank(instr.def->id)) {
+                int d = instr.def->id;
+                graph.addNode(d);
+
+                // MOV d, s: d and s hold the same value, so they do not interfere
+                const VReg* copySrc = instr.op == OpCode::MOV ? std::get_if<VReg>(&instr.operands[0]) : nullptr;
+                for (int l : live) {
+                    if (copySrc && l == copySrc->id) continue;
+                    graph.addEdge(d, l);
+                }
+                live.erase(d);
+            }
+
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use); reg && inBank(reg->id)) {
+                    graph.addNode(reg->id);
+                    live.insert(reg->id);
+                }
+            }
+        }
+    }
+
+    graph.finalise();
+    return graph;
+}
@@ -0,0 +1,250 @@
+/**
+    Interpreter.cpp: decoding and the dispatch loop behind interpret.
+    Both ways of running a function share one decoder, parameterised by
+    where a VR's value lives, and one loop, so the two runs differ only
+    in the cells their operands name.
+*/
+
+#include "Interpreter.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+enum class Kind : uint8_t {
+    Add, Sub, Mul,
+    Move,           // MOV of an immediate, which the program computes
+    Copy,           // MOV of a register
+    Load, Store,
+    SpillLoad, SpillStore,
+    Jump, BranchEq, BranchZero, BranchNonZero,
+    Ret,
+    FallOff         // past the last instruction of a block that has no terminator
+};
+
+struct Op {
+    Kind kind;
+    int32_t def = 0;            // cell written
+    int32_t a = 0;              // cells read
+    int32_t b = 0;
+    int32_t origin = 0;         // name a computed value is hashed under
+    int32_t target[2] = {0, 0}; // block positions: taken, not taken
+};
+
+struct Program {
+    std::vector<Op> code;
+    std::vector<uint32_t> blockStart;   // block position -> its first op
+    std::vector<int> blockId;           // block position -> BasicBlock::id, hashed for each branch taken
+    std::vector<int64_t> cells;         // initial value of every cell: locations, spill slots, then immediates
+};
+
+int slotOf(const Instruction& instr) {
+    return std::get<int>(instr.op == OpCode::LOAD ? instr.operands[0] : instr.operands[1]);
+}
+
+/**
+    Decodes fn. cellOf(v) is the cell holding VR v, below numLocations,
+    and originOf(v) the name its computed values are hashed under. Spill
+    slots follow the locations and each immediate gets a cell of its own.
+*/
+template <typename CellOf, typename OriginOf>
+Program decode(const Function& fn, size_t numLocations, CellOf&& cellOf, OriginOf&& originOf) {
+    Program p;
+    std::unordered_map<std::string_view, int> position;
+    int numSlots = 0;
+    for (size_t b = 0; b < fn.blocks.size(); ++b) {
+        position.emplace(fn.blocks[b]->label, static_cast<int>(b));
+        for (const auto& instr : fn.blocks[b]->instructions) {
+            if (instr.spill) numSlots = std::max(numSlots, slotOf(instr) + 1);
+        }
+    }
+    int slotBase = static_cast<int>(numLocations);
+    p.cells.assign(numLocations + static_cast<size_t>(numSlots), 0);
+
+    auto operand = [&](const Operands& use) -> int32_t {
+        if (auto* reg = std::get_if<VReg>(&use)) return cellOf(reg->id);
+        p.cells.push_back(std::holds_alternative<int>(use) ? std::get<int>(use) : 0);
+        return static_cast<int32_t>(p.cells.size() - 1);
+    };
+    auto target = [&](const std::optional<std::string>& label) {
+        auto it = label ? position.find(*label) : position.end();
+        if (it == position.end())
+            throw std::runtime_error(fn.name + ": branch to unknown label " + label.value_or(""));
+        return it->second;
+    };
+
+    for (size_t b = 0; b < fn.blocks.size(); ++b) {
+        const BasicBlock& block = *fn.blocks[b];
+        p.blockStart.push_back(static_cast<uint32_t>(p.code.size()));
+        p.blockId.push_back(block.id);
+        bool terminated = false;
+        for (const auto& instr : block.instructions) {
+            Op op{.kind = Kind::Ret};
+            if (instr.def.has_value()) {
+                op.def = cellOf(instr.def->id);
+                op.origin = originOf(instr.def->id);
+            }
+            switch (instr.op) {
+                case OpCode::ADD:
+                case OpCode::SUB:
+                case OpCode::MUL:
+                    op.kind = instr.op == OpCode::ADD ? Kind::Add : instr.op == OpCode::SUB ? Kind::Sub : Kind::Mul;
+                    op.a = operand(instr.operands[0]);
+                    op.b = operand(instr.operands[1]);
+                    break;
+                case OpCode::MOV:
+                    op.kind = std::holds_alternative<VReg>(instr.operands[0]) ? Kind::Copy : Kind::Move;
+                    op.a = operand(instr.operands[0]);
+                    // A copy within one register, which the Writer leaves out
+                    if (op.kind == Kind::Copy && op.a == op.def) continue;
+                    break;
+                case OpCode::LOAD:
+                    op.kind = instr.spill ? Kind::SpillLoad : Kind::Load;
+                    op.a = instr.spill ? slotBase + slotOf(instr) : operand(instr.operands[0]);
+                    break;
+                case OpCode::STORE:
+                    op.kind = instr.spill ? Kind::SpillStore : Kind::Store;
+                    op.a = operand(instr.operands[0]);
+                    if (instr.spill) op.def = slotBase + slotOf(instr);
+                    else op.b = operand(instr.operands[1]);
+                    break;
+                case OpCode::JMP:
+                    op.kind = Kind::Jump;
+                    op.target[0] = target(instr.labels[0]);
+                    break;
+                case OpCode::BEQ:
+                case OpCode::BZ:
+                case OpCode::BNZ:
+                    op.kind = instr.op == OpCode::BEQ ? Kind::BranchEq
+                            : instr.op == OpCode::BZ ? Kind::BranchZero : Kind::BranchNonZero;
+                    op.a = operand(instr.operands[0]);
+                    if (instr.op == OpCode::BEQ) op.b = operand(instr.operands[1]);
+                    op.target[0] = target(instr.labels[0]);
+                    op.target[1] = target(instr.labels[1]);
+                    break;
+                case OpCode::RET:
+                    break;
+            }
+            p.code.push_back(op);
+            terminated = op.kind >= Kind::Jump;
+        }
+        if (!terminated) p.code.push_back(Op{.kind = Kind::FallOff, .a = static_cast<int32_t>(b)});
+    }
+    return p;
+}
+
+// One FNV-1a step per 64-bit word
+constexpr uint64_t kHashSeed = 0xcbf29ce484222325ull;
+inline uint64_t mix(uint64_t h, int64_t x) { return (h ^ static_cast<uint64_t>(x)) * 0x100000001b3ull; }
+
+// Wrapping arithmetic, as the hardware would do it
+inline int64_t wrap(uint64_t x) { return static_cast<int64_t>(x); }
+
+Execution run(const Function& fn, Program p, uint64_t maxInstructions) {
+    Execution result;
+    if (p.blockStart.empty()) {
+        result.completed = true;
+        return result;
+    }
+    std::vector<int64_t>& cell = p.cells;
+    std::unordered_map<int64_t, int64_t> memory;
+    ExecutionStats& stats = result.stats;
+    uint64_t h = kHashSeed;
+    size_t pc = p.blockStart[0];
+
+    for (;;) {
+        const Op& op = p.code[pc++];
+        ++stats.instructions;
+        int next = -1;
+        switch (op.kind) {
+            case Kind::Add:
+                cell[op.def] = wrap(static_cast<uint64_t>(cell[op.a]) + static_cast<uint64_t>(cell[op.b]));
+                h = mix(mix(h, op.origin), cell[op.def]);
+                break;
+            case Kind::Sub:
+                cell[op.def] = wrap(static_cast<uint64_t>(cell[op.a]) - static_cast<uint64_t>(cell[op.b]));
+                h = mix(mix(h, op.origin), cell[op.def]);
+                break;
+            case Kind::Mul:
+                cell[op.def] = wrap(static_cast<uint64_t>(cell[op.a]) * static_cast<uint64_t>(cell[op.b]));
+                h = mix(mix(h, op.origin), cell[op.def]);
+                break;
+            case Kind::Move:
+                cell[op.def] = cell[op.a];
+                h = mix(mix(h, op.origin), cell[op.def]);
+                break;
+            case Kind::Copy:
+                cell[op.def] = cell[op.a];
+                ++stats.copies;
+                break;
+            case Kind::Load: {
+                auto it = memory.find(cell[op.a]);
+                cell[op.def] = it == memory.end() ? 0 : it->second;
+                h = mix(mix(h, op.origin), cell[op.def]);
+                ++stats.memoryOps;
+                break;
+            }
+            case Kind::Store:
+                memory[cell[op.b]] = cell[op.a];
+                h = mix(mix(h, cell[op.b]), cell[op.a]);
+                ++stats.memoryOps;
+                break;
+            case Kind::SpillLoad:
+                cell[op.def] = cell[op.a];
+                ++stats.spillLoads;
+                break;
+            case Kind::SpillStore:
+                cell[op.def] = cell[op.a];
+                ++stats.spillStores;
+                break;
+            case Kind::Jump:
+                next = op.target[0];
+                break;
+            case Kind::BranchEq:
+                next = op.target[cell[op.a] == cell[op.b] ? 0 : 1];
+                break;
+            case Kind::BranchZero:
+                next = op.target[cell[op.a] == 0 ? 0 : 1];
+                break;
+            case Kind::BranchNonZero:
+                next = op.target[cell[op.a] != 0 ? 0 : 1];
+                break;
+            case Kind::Ret:
+                result.completed = true;
+                result.behaviour = h;
+                return result;
+            case Kind::FallOff:
+                throw std::runtime_error(fn.name + ": control falls off the end of block " +
+                                         fn.blocks[op.a]->label);
+        }
+        if (next < 0) continue;
+        h = mix(h, p.blockId[next]);
+        pc = p.blockStart[next];
+        if (stats.instructions > maxInstructions) break;
+    }
+    result.behaviour = h;
+    return result;
+}
+
+}   // namespace
+
+Execution interpret(const Function& fn, uint64_t maxInstructions) {
+    auto self = [](int v) { return v; };
+    return run(fn, decode(fn, static_cast<size_t>(maxVRegID(fn) + 1), self, self), maxInstructions);
+}
+
+Execution interpret(const Function& fn, const Allocation& alloc, const TargetDesc& target,
+                    uint64_t maxInstructions) {
+    auto cellOf = [&](int v) {
+        int reg = v < static_cast<int>(alloc.reg.size()) ? alloc.reg[v] : -1;
+        if (reg < 0) throw std::runtime_error(fn.name + ": %" + std::to_string(v) + " has no register");
+        return static_cast<int>(target.classes[alloc.regClass[v]].bank * kMaxRegsPerClass) + reg;
+    };
+    auto originOf = [&](int v) { return v < static_cast<int>(alloc.origin.size()) ? alloc.origin[v] : v; };
+    return run(fn, decode(fn, kMaxRegClasses * kMaxRegsPerClass, cellOf, originOf), maxInstructions);
+}
@@ -0,0 +1,309 @@
+/**
+    LiveSet.cpp: the kernels work on whole words wherever they can. A
+    result whose form may change is gathered in per-thread scratch
+    space and copied into the set's own memory in its new form.
+*/
+
+#include "LiveSet.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Per-thread, so that sets on different threads never share them
+struct Scratch {
+    std::vector<uint32_t> members;
+    std::vector<uint32_t> keys[3];
+    std::vector<uint64_t> words[3];
+};
+thread_local Scratch scratch;
+
+}   // namespace
+
+LiveSet::LiveSet(size_t universe, std::pmr::memory_resource* resource)
+    : size(universe), numWords((universe + 63) / 64), form(numWords <= kDenseWords ? Kind::Dense : Kind::Sparse),
+      index(resource), words(resource) {
+    if (form == Kind::Dense) words.assign(numWords, 0);
+}
+
+LiveSet& LiveSet::operator=(const LiveSet& other) {
+    size = other.size;
+    numWords = other.numWords;
+    form = other.form;
+    index.assign(other.index.begin(), other.index.end());
+    words.assign(other.words.begin(), other.words.end());
+    return *this;
+}
+
+size_t LiveSet::count() const {
+    if (form == Kind::Sparse) return index.size();
+    size_t n = 0;
+    for (uint64_t w : words) n += std::popcount(w);
+    return n;
+}
+
+bool LiveSet::test(uint32_t name) const {
+    switch (form) {
+    case Kind::Sparse:
+        return std::binary_search(index.begin(), index.end(), name);
+    case Kind::Chunked: {
+        auto it = std::lower_bound(index.begin(), index.end(), name / 64);
+        return it != index.end() && *it == name / 64 && (words[it - index.begin()] >> (name % 64) & 1);
+    }
+    case Kind::Dense:
+        return words[name / 64] >> (name % 64) & 1;
+    }
+    return false;
+}
+
+uint64_t LiveSet::wordAt(uint32_t k) const {
+    switch (form) {
+    case Kind::Sparse: {
+        uint64_t w = 0;
+        for (auto it = std::lower_bound(index.begin(), index.end(), k * 64); it != index.end() && *it / 64 == k; ++it)
+            w |= uint64_t{1} << (*it % 64);
+        return w;
+    }
+    case Kind::Chunked: {
+        auto it = std::lower_bound(index.begin(), index.end(), k);
+        return it != index.end() && *it == k ? words[it - index.begin()] : 0;
+    }
+    case Kind::Dense:
+        return words[k];
+    }
+    return 0;
+}
+
+void LiveSet::clear() {
+    if (numWords <= kDenseWords) {
+        std::fill(words.begin(), words.end(), 0);
+        return;
+    }
+    form = Kind::Sparse;
+    index.clear();
+    words.clear();
+}
+
+LiveSet::Kind LiveSet::choose(size_t members, size_t nonZeroWords) const {
+    if (numWords <= kDenseWords) return Kind::Dense;
+    size_t sparse = members * sizeof(uint32_t);
+    size_t chunked = nonZeroWords * (sizeof(uint32_t) + sizeof(uint64_t));
+    size_t dense = numWords * sizeof(uint64_t);
+    if (dense <= sparse && dense <= chunked) return Kind::Dense;
+    return sparse <= chunked ? Kind::Sparse : Kind::Chunked;
+}
+
+void LiveSet::assignSorted(std::span<const uint32_t> members) {
+    size_t nonZero = 0;
+    for (size_t i = 0; i < members.size(); ++i) {
+        if (i == 0 || members[i] / 64 != members[i - 1] / 64) ++nonZero;
+    }
+    form = choose(members.size(), nonZero);
+    switch (form) {
+    case Kind::Sparse:
+        index.assign(members.begin(), members.end());
+        words.clear();
+        break;
+    case Kind::Chunked:
+        index.clear();
+        words.clear();
+        for (uint32_t name : members) {
+            if (index.empty() || index.back() != name / 64) {
+                index.push_back(name / 64);
+                words.push_back(0);
+            }
+            words.back() |= uint64_t{1} << (name % 64);
+        }
+        break;
+    case Kind::Dense:
+        index.clear();
+        words.assign(numWords, 0);
+        for (uint32_t name : members) words[name / 64] |= uint64_t{1} << (name % 64);
+        break;
+    }
+}
+
+void LiveSet::assignWords(std::span<const uint32_t> keys, std::span<const uint64_t> values) {
+    size_t members = 0;
+    for (uint64_t w : values) members += std::popcount(w);
+    form = choose(members, keys.size());
+    switch (form) {
+    case Kind::Sparse:
+        index.clear();
+        words.clear();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            for (uint64_t w = values[i]; w != 0; w &= w - 1)
+                index.push_back(keys[i] * 64 + static_cast<uint32_t>(std::countr_zero(w)));
+        }
+        break;
+    case Kind::Chunked:
+        index.assign(keys.begin(), keys.end());
+        words.assign(values.begin(), values.end());
+        break;
+    case Kind::Dense:
+        index.clear();
+        words.assign(numWords, 0);
+        for (size_t i = 0; i < keys.size(); ++i) words[keys[i]] = values[i];
+        break;
+    }
+}
+
+void LiveSet::refitDense() {
+    if (numWords <= kDenseWords) return;
+    size_t members = 0, nonZero = 0;
+    for (uint64_t w : words) {
+        nonZero += w != 0;
+        members += std::popcount(w);
+    }
+    if (choose(members, nonZero) == Kind::Dense) return;
+    auto& keys = scratch.keys[0];
+    auto& values = scratch.words[0];
+    keys.clear();
+    values.clear();
+    forEachWord([&](uint32_t k, uint64_t w) {
+        keys.push_back(k);
+        values.push_back(w);
+    });
+    assignWords(keys, values);
+}
+
+LiveSet& LiveSet::operator|=(const LiveSet& other) {
+    // A union only grows a set, and a dense set stays dense as it grows
+    if (form == Kind::Dense) {
+        other.forEachWord([&](uint32_t k, uint64_t w) { words[k] |= w; });
+        return *this;
+    }
+    if (other.form == Kind::Sparse) {
+        if (other.index.empty()) return *this;
+        if (form == Kind::Sparse) {
+            auto& merged = scratch.members;
+            merged.clear();
+            std::set_union(index.begin(), index.end(), other.index.begin(), other.index.end(),
+                           std::back_inserter(merged));
+            if (merged.size() != index.size()) assignSorted(merged);
+            return *this;
+        }
+    }
+
+    // Merge the two lists of non-zero words
+    auto gather = [](const LiveSet& set, std::vector<uint32_t>& keys, std::vector<uint64_t>& values) {
+        keys.clear();
+        values.clear();
+        set.forEachWord([&](uint32_t k, uint64_t w) {
+            keys.push_back(k);
+            values.push_back(w);
+        });
+    };
+    gather(*this, scratch.keys[0], scratch.words[0]);
+    gather(other, scratch.keys[1], scratch.words[1]);
+    const auto &ak = scratch.keys[0], &bk = scratch.keys[1];
+    const auto &aw = scratch.words[0], &bw = scratch.words[1];
+    auto& keys = scratch.keys[2];
+    auto& values = scratch.words[2];
+    keys.clear();
+    values.clear();
+    size_t i = 0, j = 0;
+    while (i < ak.size() || j < bk.size()) {
+        if (j == bk.size() || (i < ak.size() && ak[i] < bk[j])) {
+            keys.push_back(ak[i]);
+            values.push_back(aw[i++]);
+        } else if (i == ak.size() || bk[j] < ak[i]) {
+            keys.push_back(bk[j]);
+            values.push_back(bw[j++]);
+        } else {
+            keys.push_back(ak[i]);
+            values.push_back(aw[i++] | bw[j++]);
+        }
+    }
+    assignWords(keys, values);
+    return *this;
+}
+
+LiveSet& LiveSet::operator-=(const LiveSet& other) {
+    switch (form) {
+    case Kind::Dense:
+        other.forEachWord([&](uint32_t k, uint64_t w) { words[k] &= ~w; });
+        refitDense();
+        break;
+    case Kind::Sparse: {
+        auto& kept = scratch.members;
+        kept.clear();
+        std::copy_if(index.begin(), index.end(), std::back_inserter(kept),
+                     [&](uint32_t name) { return !other.test(name); });
+        if (kept.size() != index.size()) assignSorted(kept);
+        break;
+    }
+    case Kind::Chunked: {
+        auto& keys = scratch.keys[0];
+        auto& values = scratch.words[0];
+        keys.clear();
+        values.clear();
+        for (size_t i = 0; i < index.size(); ++i) {
+            if (uint64_t w = words[i] & ~other.wordAt(index[i])) {
+                keys.push_back(index[i]);
+                values.push_back(w);
+            }
+        }
+        assignWords(keys, values);
+        break;
+    }
+    }
+    return *this;
+}
+
+LiveSet& LiveSet::operator&=(const LiveSet& other) {
+    switch (form) {
+    case Kind::Sparse: {
+        auto& kept = scratch.members;
+        kept.clear();
+        std::copy_if(index.begin(), index.end(), std::back_inserter(kept),
+                     [&](uint32_t name) { return other.test(name); });
+        if (kept.size() != index.size()) assignSorted(kept);
+        break;
+    }
+    case Kind::Chunked: {
+        auto& keys = scratch.keys[0];
+        auto& values = scratch.words[0];
+        keys.clear();
+        values.clear();
+        for (size_t i = 0; i < index.size(); ++i) {
+            if (uint64_t w = words[i] & other.wordAt(index[i])) {
+                keys.push_back(index[i]);
+                values.push_back(w);
+            }
+        }
+        assignWords(keys, values);
+        break;
+    }
+    case Kind::Dense: {
+        if (other.form == Kind::Dense) {
+            for (size_t k = 0; k < words.size(); ++k) words[k] &= other.words[k];
+            refitDense();
+            break;
+        }
+        // The result has no more words than other, so build it from those
+        auto& keys = scratch.keys[0];
+        auto& values = scratch.words[0];
+        keys.clear();
+        values.clear();
+        other.forEachWord([&](uint32_t k, uint64_t w) {
+            if (uint64_t v = words[k] & w) {
+                keys.push_back(k);
+                values.push_back(v);
+            }
+        });
+        assignWords(keys, values);
+        break;
+    }
+    }
+    return *this;
+}
+
+void LiveSet::swap(LiveSet& other) noexcept {
+    std::swap(size, other.size);
+    std::swap(numWords, other.numWords);
+    std::swap(form, other.form);
+    index.swap(other.index);
+    words.swap(other.words);
+}
@@ -2,20 +2,29 @@
     Performs liveness analysis on the iON IR. Liveness.cpp
     is composed of two functions, computeUseDef which is responsible
     for gathering the initial information to create the UEVar and VarKill
-    sets, which are then used by LivenessAnalysis::analyse to
-    compute the LiveIn and LiveOut sets. The analysis is performed
-    on the CFG in a RPO traversal, since the computations
-    performed proogate backwards through the graph.
+    sets, and LivenessAnalysis::analyse which computes the LiveIn and
+    LiveOut sets from the same information, restricted to the names
+    that live across blocks. The analysis works through the CFG's
+    strongly connected components sinks first, since the computations
+    performed propagate backwards through the graph.
 */
 
 #include "Liveness.h"
+#include "LiveSet.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
 LivenessInfo computeUseDef(Function& fn) {
     /* 
         Gather the initial information for liveness analysis,
         each block has k operations of the (generic) form "x <- y op z". 
      **/
-    LivenessInfo li;
+    stats::Timer timer(Phase::UseDef);
+    LivenessInfo li(fn.resource());
 
     // Compute global maxID across all blocks so all vectors are uniformly sized
     int globalMaxID = 1;
@@ -33,8 +42,9 @@ LivenessInfo computeUseDef(Function& fn) {
     int numVars = globalMaxID + 1;
 
     for (const auto &block : fn.blocks) {
-        li.UEVar.insert({block->id, boost::dynamic_bitset<>(numVars)});
-        li.VarKill.insert({block->id, boost::dynamic_bitset<>(numVars)});
+        // Built in place, so the bitsets take the maps' allocator
+        LiveBits& ueVar = li.UEVar.try_emplace(block->id, numVars, 0ul).first->second;
+        LiveBits& varKill = li.VarKill.try_emplace(block->id, numVars, 0ul).first->second;
         int k = block->instructions.size();
         for (int i = 0; i < k; ++i) {
             const Instruction& instr = block->instructions[i];
@@ -46,15 +56,15 @@ LivenessInfo computeUseDef(Function& fn) {
                 if (std::holds_alternative<VReg>(var)) {
                     // If var NOT IN VarKill(block)
                     VReg v = std::get<VReg>(var);
-                    if (!li.VarKill[block->id][v.id])
-                        li.UEVar[block->id].set(v.id);
+                    if (!varKill[v.id])
+                        ueVar.set(v.id);
                 }
             }
 
             // Add x (operand) to VarKill unconditionally
             if (def.has_value()) {
                 VReg x = def.value();
-                li.VarKill[block->id].set(x.id);
+                varKill.set(x.id);
             }
 
         }
@@ -62,47 +72,322 @@ LivenessInfo computeUseDef(Function& fn) {
     return li;
 }
 
+namespace {
+
+/**
+    The use/def sets of the global names only: those upward-exposed in
+    some block. Any other name is defined before every use in its block,
+    so it is in no LiveIn set and hence in no LiveOut set either; it is
+    live only within its block, where the interference graph's backward
+    scan from LiveOut finds it. Solving over the global names alone gives
+    the same sets with bitsets the width of that (usually far smaller)
+    set.
+
+    The names are cut into slices of whole words. The equations never
+    mix bits, so each slice reaches its fixed point on its own.
+*/
+struct GlobalUseDef {
+    std::pmr::vector<int> names;            // bit -> VR, ascending
+    size_t sliceBits = 0;                   // a multiple of 64; the last slice may be narrower
+    // [slice][block position]. The sets carry the resource themselves:
+    // a pmr::vector would need them to be constructible with an allocator
+    std::vector<std::vector<LiveSet>> ueVar;
+    std::vector<std::vector<LiveSet>> varKill;
+    std::pmr::vector<int> succStart;        // block position -> its first entry in succ
+    std::pmr::vector<int> succ;             // successor positions
+    // The CFG's strongly connected components, sinks first: component c holds the blocks
+    // sccOrder[sccStart[c] .. sccStart[c + 1]), and is cyclic if it has a loop in it
+    std::pmr::vector<int> sccOrder;
+    std::pmr::vector<int> sccStart;
+    std::pmr::vector<bool> sccCyclic;
+
+    explicit GlobalUseDef(std::pmr::memory_resource* resource)
+        : names(resource), succStart(resource), succ(resource),
+          sccOrder(resource), sccStart(resource), sccCyclic(resource) {}
+
+    size_t slices() const { return ueVar.size(); }
+};
+
+/**
+    Tarjan's algorithm, without recursion so deep CFGs cannot overflow
+    the stack. It emits each component once all the components it
+    reaches are out, i.e. sinks first: the order a backward problem
+    wants.
+*/
+void condense(GlobalUseDef& ud, int N, std::pmr::memory_resource* resource) {
+    std::pmr::vector<int> index(N, -1, resource);
+    std::pmr::vector<int> low(N, 0, resource);
+    std::pmr::vector<bool> onStack(N, false, resource);
+    std::pmr::vector<int> stack(resource);
+    std::pmr::vector<std::pair<int, int>> calls(resource);     // block, its next edge
+    int counter = 0;
+
+    auto enter = [&](int v) {
+        index[v] = low[v] = counter++;
+        stack.push_back(v);
+        onStack[v] = true;
+        calls.push_back({v, ud.succStart[v]});
+    };
+    for (int root = 0; root < N; ++root) {
+        if (index[root] >= 0) continue;
+        enter(root);
+        while (!calls.empty()) {
+            auto [v, e] = calls.back();
+            if (e < ud.succStart[v + 1]) {
+                ++calls.back().second;
+                int w = ud.succ[e];
+                if (index[w] < 0) enter(w);
+                else if (onStack[w]) low[v] = std::min(low[v], index[w]);
+                continue;
+            }
+            calls.pop_back();
+            if (!calls.empty()) {
+                int u = calls.back().first;
+                low[u] = std::min(low[u], low[v]);
+            }
+            if (low[v] != index[v]) continue;
+
+            size_t start = ud.sccOrder.size();
+            int w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                onStack[w] = false;
+                ud.sccOrder.push_back(w);
+            } while (w != v);
+            ud.sccStart.push_back(static_cast<int>(start));
+            bool cyclic = ud.sccOrder.size() - start > 1 ||
+                std::find(ud.succ.begin() + ud.succStart[v], ud.succ.begin() + ud.succStart[v + 1], v) !=
+                    ud.succ.begin() + ud.succStart[v + 1];
+            ud.sccCyclic.push_back(cyclic);
+        }
+    }
+    ud.sccStart.push_back(static_cast<int>(ud.sccOrder.size()));
+}
+
+/* Whole words, one slice per worker once there are minNames names; a single slice otherwise */
+size_t sliceWidth(size_t names, unsigned workers, size_t minNames) {
+    size_t words = (names + 63) / 64;
+    if (names < minNames || workers < 2) return std::max<size_t>(words, 1) * 64;
+    return std::max<size_t>((words + workers - 1) / workers, 1) * 64;
+}
+
+GlobalUseDef computeGlobalUseDef(Function& fn, unsigned workers, size_t minNames) {
+    stats::Timer timer(Phase::UseDef);
+    std::pmr::memory_resource* resource = fn.resource();
+    GlobalUseDef ud(resource);
+    int N = fn.blocks.size();
+
+    int maxID = 0;
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.def.has_value()) maxID = std::max(maxID, instr.def->id);
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use)) maxID = std::max(maxID, reg->id);
+            }
+        }
+    }
+
+    // A use is upward-exposed unless this block defined the VR before it
+    std::pmr::vector<int> definedIn(maxID + 1, -1, resource);
+    std::pmr::vector<int> bit(maxID + 1, -1, resource);
+    for (int b = 0; b < N; ++b) {
+        for (const auto& instr : fn.blocks[b]->instructions) {
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use); reg && definedIn[reg->id] != b) bit[reg->id] = 0;
+            }
+            if (instr.def.has_value()) definedIn[instr.def->id] = b;
+        }
+    }
+    for (int v = 0; v <= maxID; ++v) {
+        if (bit[v] == 0) {
+            bit[v] = static_cast<int>(ud.names.size());
+            ud.names.push_back(v);
+        }
+    }
+    stats::count(Counter::GlobalNames, ud.names.size());
+
+    size_t width = ud.names.size();
+    ud.sliceBits = sliceWidth(width, workers, minNames);
+    size_t slices = std::max<size_t>((width + ud.sliceBits - 1) / ud.sliceBits, 1);
+    ud.ueVar.resize(slices);
+    ud.varKill.resize(slices);
+    for (size_t s = 0; s < slices; ++s) {
+        size_t bits = std::min(ud.sliceBits, width - std::min(width, s * ud.sliceBits));
+        ud.ueVar[s].reserve(N);
+        ud.varKill[s].reserve(N);
+        for (int b = 0; b < N; ++b) {
+            ud.ueVar[s].emplace_back(bits, resource);
+            ud.varKill[s].emplace_back(bits, resource);
+        }
+    }
+    if (width > 0) {
+        // Each block's sets are gathered as member lists, sorted, then cut at the slice boundaries
+        std::pmr::vector<int> usedIn(width, -1, resource);
+        std::pmr::vector<int> killedIn(width, -1, resource);
+        std::pmr::vector<uint32_t> ue(resource), kill(resource), local(resource);
+        auto distribute = [&](std::pmr::vector<uint32_t>& members, std::vector<std::vector<LiveSet>>& sets, int b) {
+            std::sort(members.begin(), members.end());
+            auto it = members.begin();
+            for (size_t s = 0; s < slices && it != members.end(); ++s) {
+                auto base = static_cast<uint32_t>(s * ud.sliceBits);
+                local.clear();
+                for (; it != members.end() && *it - base < ud.sliceBits; ++it) local.push_back(*it - base);
+                if (!local.empty()) sets[s][b].assignSorted(local);
+            }
+        };
+        for (int b = 0; b < N; ++b) {
+            ue.clear();
+            kill.clear();
+            for (const auto& instr : fn.blocks[b]->instructions) {
+                for (const auto& use : instr.operands) {
+                    auto* reg = std::get_if<VReg>(&use);
+                    if (!reg || bit[reg->id] < 0) continue;
+                    int g = bit[reg->id];
+                    if (killedIn[g] != b && usedIn[g] != b) {
+                        usedIn[g] = b;
+                        ue.push_back(g);
+                    }
+                }
+                if (instr.def.has_value() && bit[instr.def->id] >= 0) {
+                    int g = bit[instr.def->id];
+                    if (killedIn[g] != b) {
+                        killedIn[g] = b;
+                        kill.push_back(g);
+                    }
+                }
+            }
+            distribute(ue, ud.ueVar, b);
+            distribute(kill, ud.varKill, b);
+        }
+    }
+
+    std::pmr::unordered_map<const BasicBlock*, int> position(resource);
+    position.reserve(N);
+    for (int b = 0; b < N; ++b) position.emplace(fn.blocks[b].get(), b);
+    ud.succStart.reserve(N + 1);
+    for (int b = 0; b < N; ++b) {
+        ud.succStart.push_back(static_cast<int>(ud.succ.size()));
+        for (const BasicBlock* s : fn.blocks[b]->successors) ud.succ.push_back(position.at(s));
+    }
+    ud.succStart.push_back(static_cast<int>(ud.succ.size()));
+    condense(ud, N, resource);
+    return ud;
+}
+
+struct SliceSets {
+    std::vector<LiveSet> liveOut;           // by block position
+    std::vector<LiveSet> liveIn;
+    unsigned iterations = 0;                // passes over the component that needed the most
+    uint64_t visits = 0;                    // blocks evaluated
+};
+
+/* Solves the equations over one slice, taking all its memory from resource */
+SliceSets solveSlice(const GlobalUseDef& ud, size_t s, std::pmr::memory_resource* resource) {
+    const std::vector<LiveSet>& ueVar = ud.ueVar[s];
+    const std::vector<LiveSet>& varKill = ud.varKill[s];
+    size_t N = ueVar.size();
+    size_t width = N > 0 ? ueVar[0].universe() : 0;
+
+    // LiveIn is kept up to date with LiveOut, so a block's LiveOut is just the union of its
+    // successors' LiveIn. Scratch sets are updated in place, keeping their memory
+    SliceSets sets;
+    sets.liveOut.reserve(N);
+    sets.liveIn.reserve(N);
+    for (size_t i = 0; i < N; i++) {
+        sets.liveOut.emplace_back(width, resource);
+        // Assigned rather than moved from a copy, which would take ueVar's resource
+        sets.liveIn.emplace_back(width, resource) = ueVar[i];
+    }
+    if (width == 0) return sets;
+    LiveSet newLiveOut(width, resource);
+
+    // Returns whether LiveOut(B) changed
+    auto visit = [&](int b) {
+        ++sets.visits;
+        newLiveOut.clear();
+        // LiveOut(B) = ⋃ S ∈ succs(B): LiveIn(S)
+        for (int e = ud.succStart[b]; e < ud.succStart[b + 1]; ++e)
+            newLiveOut |= sets.liveIn[ud.succ[e]];
+        LiveSet& current = sets.liveOut[b];
+        if (current == newLiveOut) return false;
+        current.swap(newLiveOut);
+        // LiveIn(B) = UEVar(B) | (LiveOut(B) & ~VarKill(B))
+        LiveSet& liveIn = sets.liveIn[b];
+        liveIn = current;
+        liveIn -= varKill[b];
+        liveIn |= ueVar[b];
+        return true;
+    };
+
+    // Components come sinks first, so every successor outside a component is final by the time
+    // it is reached: an acyclic block is visited once, and a loop iterates only within itself
+    for (size_t c = 0; c + 1 < ud.sccStart.size(); ++c) {
+        const int* first = ud.sccOrder.data() + ud.sccStart[c];
+        const int* last = ud.sccOrder.data() + ud.sccStart[c + 1];
+        unsigned passes = 0;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            ++passes;
+            for (const int* b = first; b != last; ++b)
+                changed |= visit(*b);
+            if (!ud.sccCyclic[c]) break;
+        }
+        sets.iterations = std::max(sets.iterations, passes);
+    }
+    return sets;
+}
+
+}   // namespace
+
 LivenessResult LivenessAnalysis::analyse(Function& fn) {
     /**
         Compute the LiveIn and LiveOut sets for each block
-        within the CFG (function) 
+        within the CFG (function), over its global names
     */
-    LivenessInfo li = computeUseDef(fn);
-    LivenessResult lr;
+    GlobalUseDef ud = computeGlobalUseDef(fn, pool ? pool->size() : 1, parallelMinNames);
+    std::pmr::memory_resource* resource = fn.resource();
+    LivenessResult lr(resource);
+    stats::Timer timer(Phase::Liveness);
 
-    int N = fn.blocks.size();
-    size_t numVars = li.UEVar.empty() ? 1 : li.UEVar.begin()->second.size();
-
-    std::map<int, boost::dynamic_bitset<>> liveout;
-    for (int i = 0; i < N; i++)
-        liveout[fn.blocks[i]->id] = boost::dynamic_bitset<>(numVars);
-
-    bool changed = true;
-    while (changed) {
-        changed = false;
-        for (int i = 0; i < N; i++) {
-            boost::dynamic_bitset<> newLiveOut(numVars);
-            // LiveOut(B) = ⋃ S ∈ succs(B): UEVar(S) | (LiveOut(S) & ~VarKill(S))
-            for (const auto& succ : fn.blocks[i]->successors)
-                newLiveOut |= li.UEVar[succ->id] | (liveout[succ->id] & ~li.VarKill[succ->id]);
-
-            if (liveout[fn.blocks[i]->id] != newLiveOut) {
-                changed = true;
-                liveout[fn.blocks[i]->id] = newLiveOut;
-            }
-        }
+    // The function's arena is not thread-safe, so concurrent slices each take their sets
+    // from a resource of their own, declared first to outlive them
+    size_t numSlices = ud.slices();
+    std::vector<std::pmr::monotonic_buffer_resource> arenas(numSlices > 1 ? numSlices : 0);
+    std::vector<SliceSets> slices(numSlices);
+    if (numSlices == 1) {
+        slices[0] = solveSlice(ud, 0, resource);
+    } else {
+        pool->parallelFor(numSlices, [&](size_t s) {
+            // Slices run on pool threads, which start with no function scope
+            trace::FunctionScope scope(fn.name);
+            trace::Span span("LivenessSlice", static_cast<int64_t>(s));
+            slices[s] = solveSlice(ud, s, &arenas[s]);
+        });
     }
 
-    // Compute LiveIn and convert bitsets -> std::set<int> for LivenessResult
-    // LiveIn(B) = UEVar(B) | (LiveOut(B) & ~VarKill(B))
-    for (int i = 0; i < N; i++) {
-        int id = fn.blocks[i]->id;
-        boost::dynamic_bitset<> liveIn = li.UEVar[id] | (liveout[id] & ~li.VarKill[id]);
+    // A sequential solve makes as many passes and visits as its slowest slice
+    unsigned iterations = 0;
+    uint64_t visits = 0;
+    for (const SliceSets& slice : slices) {
+        iterations = std::max(iterations, slice.iterations);
+        visits = std::max(visits, slice.visits);
+    }
+    stats::count(Counter::LivenessIterations, iterations);
+    stats::count(Counter::LivenessVisits, visits);
 
-        for (size_t v = liveout[id].find_first(); v != boost::dynamic_bitset<>::npos; v = liveout[id].find_next(v))
-            lr.liveoutSet[id].insert(static_cast<int>(v));
-        for (size_t v = liveIn.find_first(); v != boost::dynamic_bitset<>::npos; v = liveIn.find_next(v))
-            lr.liveinSet[id].insert(static_cast<int>(v));
+    // Convert bitsets -> sets of VRs for LivenessResult. Slices and the bits
+    // within them follow VR order, so each insert goes at the end
+    for (size_t i = 0; i < fn.blocks.size(); i++) {
+        int id = fn.blocks[i]->id;
+        std::pmr::set<int>& out = lr.liveoutSet[id];
+        std::pmr::set<int>& in = lr.liveinSet[id];
+        for (size_t s = 0; s < numSlices; ++s) {
+            const int* names = ud.names.data() + s * ud.sliceBits;
+            slices[s].liveOut[i].forEach([&](uint32_t v) { out.insert(out.end(), names[v]); });
+            slices[s].liveIn[i].forEach([&](uint32_t v) { in.insert(in.end(), names[v]); });
+        }
     }
 
     return lr;
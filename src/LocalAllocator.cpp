@@ -0,0 +1,354 @@
+/**
+    LocalAllocator.cpp: the bottom-up allocator over a tree of blocks.
+    The next-use pass keeps, for every block, the path position of the
+    next use of each value live into it; a branch's LiveOut is the
+    pointwise minimum over its successors. The allocation pass walks the
+    tree depth first and records every change to the register state on a
+    trail, so each successor of a branch starts from the state at the
+    branch by undoing its siblings' changes.
+*/
+
+#include "LocalAllocator.h"
+#include "Stats.h"
+
+#include <array>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+constexpr int kNever = std::numeric_limits<int>::max();
+
+using NextUses = std::pmr::unordered_map<int, int>;
+
+int newVReg(Allocation& alloc, int like) {
+    int id = static_cast<int>(alloc.regClass.size());
+    alloc.regClass.push_back(alloc.regClass[like]);
+    alloc.origin.push_back(alloc.origin[like]);
+    alloc.reg.push_back(-1);
+    return id;
+}
+
+class Local {
+public:
+    Local(Function& fn, const TargetDesc& target, Allocation& alloc);
+    void run();
+
+private:
+    static constexpr size_t kRegs = kMaxRegsPerClass;
+
+    void computeNextUses();
+    void allocateBlock(int b);
+
+    unsigned bankOf(int v) const { return target.classes[alloc.regClass[v]].bank; }
+    size_t slot(unsigned bank, int r) const { return bank * kRegs + static_cast<size_t>(r); }
+
+    // Every change to the register state goes through set, so it can be undone at a branch
+    void set(int& field, int value) {
+        trail.push_back({&field, field});
+        field = value;
+    }
+    void undo(size_t mark);
+
+    // A register of bank for a new value: prefer if free, else a free one, else the farthest next use
+    int take(unsigned bank, int prefer, std::array<int, 2> reserved, std::pmr::vector<Instruction>& out);
+    void evict(unsigned bank, int r, std::pmr::vector<Instruction>& out);
+    // Puts v's value in r and returns the VR naming it there
+    int bind(int v, unsigned bank, int r, bool dirty);
+    void release(int v);
+
+    Function& fn;
+    const TargetDesc& target;
+    Allocation& alloc;
+    std::pmr::memory_resource* resource;
+    int numVRegs;
+
+    std::pmr::unordered_map<const BasicBlock*, int> position;
+    std::pmr::vector<int> preorder;
+    std::pmr::vector<int> depth;            // block -> path position of its first instruction
+    std::pmr::vector<size_t> base;          // block -> index of its first instruction
+    std::pmr::vector<NextUses> liveIn;      // block -> next use of every value live into it
+    std::pmr::vector<int> useNext;          // 2 per instruction: next use of each operand's value after it
+    std::pmr::vector<int> defNext;          // next use of the value an instruction defines
+
+    std::array<uint64_t, kMaxRegClasses> preferred{};
+    // Per bank and register: the VR whose value it holds, its next use, and whether its slot is stale
+    std::array<int, kMaxRegClasses * kRegs> holder;
+    std::array<int, kMaxRegClasses * kRegs> next;
+    std::array<int, kMaxRegClasses * kRegs> dirty;
+    std::pmr::vector<int> where;            // VR -> register holding its value, -1 if none
+    std::pmr::vector<int> current;          // VR -> the VR naming its value there
+    std::pmr::vector<int> spillSlot;        // VR -> its slot, -1 until first stored
+    std::pmr::vector<std::pair<int*, int>> trail;
+    size_t spillInstructions = 0;
+};
+
+Local::Local(Function& fn, const TargetDesc& target, Allocation& alloc)
+    : fn(fn), target(target), alloc(alloc), resource(fn.resource()),
+      numVRegs(static_cast<int>(alloc.regClass.size())), position(resource), preorder(resource),
+      depth(resource), base(resource), liveIn(resource), useNext(resource), defNext(resource),
+      where(numVRegs, -1, resource), current(resource), spillSlot(numVRegs, -1, resource), trail(resource) {
+    holder.fill(-1);
+    next.fill(kNever);
+    dirty.fill(0);
+    current.reserve(numVRegs);
+    for (int v = 0; v < numVRegs; ++v)
+        current.push_back(v);
+    for (unsigned c = 0; c < target.numClasses; ++c)
+        preferred[target.classes[c].bank] |= target.classes[c].callerSaved;
+
+    int N = static_cast<int>(fn.blocks.size());
+    base.resize(N + 1, 0);
+    for (int i = 0; i < N; ++i) {
+        position[fn.blocks[i].get()] = i;
+        base[i + 1] = base[i] + fn.blocks[i]->instructions.size();
+    }
+    useNext.assign(2 * base[N], kNever);
+    defNext.assign(base[N], kNever);
+    depth.assign(N, 0);
+
+    // Depth first from the entry, first successor first
+    std::pmr::vector<int> stack(1, 0, resource);
+    while (!stack.empty()) {
+        int b = stack.back();
+        stack.pop_back();
+        preorder.push_back(b);
+        const auto& succs = fn.blocks[b]->successors;
+        for (auto it = succs.rbegin(); it != succs.rend(); ++it) {
+            int s = position.at(*it);
+            depth[s] = depth[b] + static_cast<int>(fn.blocks[b]->instructions.size());
+            stack.push_back(s);
+        }
+    }
+}
+
+void Local::computeNextUses() {
+    liveIn.resize(fn.blocks.size());
+    // Every block comes after its predecessor in preorder, so backwards every successor is done first
+    for (auto bit = preorder.rbegin(); bit != preorder.rend(); ++bit) {
+        int b = *bit;
+        const BasicBlock& block = *fn.blocks[b];
+        NextUses uses(resource);
+        for (const BasicBlock* succ : block.successors) {
+            for (auto [v, pos] : liveIn[position.at(succ)]) {
+                auto [it, inserted] = uses.try_emplace(v, pos);
+                if (!inserted) it->second = std::min(it->second, pos);
+            }
+        }
+
+        auto find = [&](int v) {
+            auto it = uses.find(v);
+            return it == uses.end() ? kNever : it->second;
+        };
+        for (size_t j = block.instructions.size(); j-- > 0;) {
+            const Instruction& instr = block.instructions[j];
+            size_t i = base[b] + j;
+            if (instr.def.has_value()) {
+                defNext[i] = find(instr.def->id);
+                uses.erase(instr.def->id);
+            }
+            for (size_t k = 0; k < 2; ++k) {
+                if (auto* reg = std::get_if<VReg>(&instr.operands[k])) useNext[2 * i + k] = find(reg->id);
+            }
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use)) uses[reg->id] = depth[b] + static_cast<int>(j);
+            }
+        }
+        liveIn[b] = std::move(uses);
+    }
+}
+
+void Local::undo(size_t mark) {
+    while (trail.size() > mark) {
+        *trail.back().first = trail.back().second;
+        trail.pop_back();
+    }
+}
+
+void Local::evict(unsigned bank, int r, std::pmr::vector<Instruction>& out) {
+    size_t g = slot(bank, r);
+    int v = holder[g];
+    if (dirty[g]) {
+        if (spillSlot[v] < 0) {
+            spillSlot[v] = alloc.numSpillSlots++;
+            ++alloc.spilledVRegs;
+        }
+        out.push_back(Instruction{.op = OpCode::STORE, .def = std::nullopt, .labels = {},
+                                  .operands = {VReg{current[v]}, spillSlot[v]}, .spill = true});
+        ++spillInstructions;
+    }
+    set(where[v], -1);
+    set(holder[g], -1);
+}
+
+int Local::take(unsigned bank, int prefer, std::array<int, 2> reserved, std::pmr::vector<Instruction>& out) {
+    if (prefer >= 0 && holder[slot(bank, prefer)] < 0) return prefer;
+
+    uint64_t free = 0;
+    int victim = -1;
+    for (uint64_t regs = target.allocatable(bank); regs != 0; regs &= regs - 1) {
+        int r = std::countr_zero(regs);
+        size_t g = slot(bank, r);
+        if (holder[g] < 0) {
+            free |= uint64_t{1} << r;
+        } else if (r != reserved[0] && r != reserved[1] && (victim < 0 || next[g] > next[slot(bank, victim)])) {
+            victim = r;
+        }
+    }
+    if (free != 0) return std::countr_zero((free & preferred[bank]) ? (free & preferred[bank]) : free);
+    if (victim < 0) {
+        throw std::runtime_error("register allocation of " + fn.name + " needs more registers than bank " +
+                                 std::to_string(bank) + " has");
+    }
+    evict(bank, victim, out);
+    return victim;
+}
+
+int Local::bind(int v, unsigned bank, int r, bool isDirty) {
+    int id = alloc.reg[v] < 0 || alloc.reg[v] == r ? v : newVReg(alloc, v);
+    alloc.reg[id] = r;
+    size_t g = slot(bank, r);
+    set(current[v], id);
+    set(where[v], r);
+    set(holder[g], v);
+    set(dirty[g], isDirty);
+    return id;
+}
+
+void Local::release(int v) {
+    if (where[v] < 0) return;
+    set(holder[slot(bankOf(v), where[v])], -1);
+    set(where[v], -1);
+}
+
+void Local::allocateBlock(int b) {
+    BasicBlock& block = *fn.blocks[b];
+
+    // Values live out of the branch above but not into this side of it are dead here
+    for (unsigned bank = 0; bank < target.numBanks(); ++bank) {
+        for (int r = 0; r < static_cast<int>(kRegs); ++r) {
+            size_t g = slot(bank, r);
+            if (holder[g] < 0) continue;
+            auto it = liveIn[b].find(holder[g]);
+            if (it == liveIn[b].end()) release(holder[g]);
+            else set(next[g], it->second);
+        }
+    }
+
+    std::pmr::vector<Instruction> rewritten(block.instructions.get_allocator());
+    rewritten.reserve(block.instructions.size());
+    for (size_t j = 0; j < block.instructions.size(); ++j) {
+        Instruction instr = block.instructions[j];
+        size_t i = base[b] + j;
+
+        std::array<int, 2> reserved{-1, -1};
+        std::array<int, 2> original{-1, -1};
+        for (size_t k = 0; k < 2; ++k) {
+            auto* reg = std::get_if<VReg>(&instr.operands[k]);
+            if (!reg) continue;
+            int u = reg->id;
+            unsigned bank = bankOf(u);
+            if (where[u] < 0) {
+                int r = take(bank, -1, reserved, rewritten);
+                // A value never seen before is live into the function and already in its register
+                int id = bind(u, bank, r, spillSlot[u] < 0);
+                if (spillSlot[u] >= 0) {
+                    rewritten.push_back(Instruction{
+                        .op = OpCode::LOAD, .def = VReg{id}, .labels = {},
+                        .operands = {spillSlot[u], std::monostate{}}, .spill = true});
+                    ++spillInstructions;
+                }
+            }
+            original[k] = u;
+            reserved[k] = where[u];
+            reg->id = current[u];
+        }
+
+        // Operands read for the last time free their registers before the def takes one
+        int freedBySource = -1;
+        for (size_t k = 0; k < 2; ++k) {
+            int u = original[k];
+            if (u < 0 || where[u] < 0) continue;
+            if (useNext[2 * i + k] == kNever) {
+                if (instr.op == OpCode::MOV && k == 0) freedBySource = where[u];
+                release(u);
+            } else {
+                set(next[slot(bankOf(u), where[u])], useNext[2 * i + k]);
+            }
+        }
+
+        int dead = -1;
+        if (instr.def.has_value()) {
+            int d = instr.def->id;
+            unsigned bank = bankOf(d);
+            release(d);
+            // MOV d, s with s dead: d takes s's register and the copy disappears
+            int prefer = freedBySource >= 0 && bankOf(original[0]) == bank ? freedBySource : -1;
+            int r = take(bank, prefer, {-1, -1}, rewritten);
+            instr.def = VReg{bind(d, bank, r, true)};
+            if (defNext[i] == kNever) dead = d;
+            else set(next[slot(bank, r)], defNext[i]);
+        }
+        rewritten.push_back(std::move(instr));
+        if (dead >= 0) release(dead);
+    }
+    block.instructions = std::move(rewritten);
+}
+
+void Local::run() {
+    computeNextUses();
+
+    // Each successor of a branch is entered with the trail as it was at the branch
+    std::pmr::vector<std::pair<int, size_t>> stack(resource);
+    stack.push_back({0, 0});
+    while (!stack.empty()) {
+        auto [b, mark] = stack.back();
+        stack.pop_back();
+        undo(mark);
+        allocateBlock(b);
+        const auto& succs = fn.blocks[b]->successors;
+        for (auto it = succs.rbegin(); it != succs.rend(); ++it)
+            stack.push_back({position.at(*it), trail.size()});
+    }
+    stats::count(Counter::SpillInstructions, spillInstructions);
+}
+
+}   // namespace
+
+bool hasNoMerges(const Function& fn) {
+    if (fn.blocks.empty() || !fn.blocks[0]->predecessors.empty()) return false;
+    for (size_t i = 1; i < fn.blocks.size(); ++i) {
+        if (fn.blocks[i]->predecessors.size() != 1) return false;
+    }
+
+    // One predecessor each still allows a cycle that the entry never reaches
+    size_t reached = 0;
+    std::vector<const BasicBlock*> stack{fn.blocks[0].get()};
+    while (!stack.empty()) {
+        const BasicBlock* b = stack.back();
+        stack.pop_back();
+        ++reached;
+        for (const BasicBlock* s : b->successors) stack.push_back(s);
+    }
+    return reached == fn.blocks.size();
+}
+
+void allocateLocal(Function& fn, const TargetDesc& target, Allocation& alloc) {
+    stats::Timer timer(Phase::LocalAllocation);
+    Local(fn, target, alloc).run();
+
+    unsigned shared = 0;
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.op != OpCode::MOV || !instr.def.has_value()) continue;
+            auto* src = std::get_if<VReg>(&instr.operands[0]);
+            if (src && src->id != instr.def->id && alloc.reg[src->id] == alloc.reg[instr.def->id] &&
+                target.classes[alloc.regClass[src->id]].bank == target.classes[alloc.regClass[instr.def->id]].bank)
+                ++shared;
+        }
+    }
+    alloc.coalescedCopies = shared;
+    alloc.rounds = 1;
+}
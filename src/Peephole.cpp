@@ -0,0 +1,144 @@
+/**
+    Peephole.cpp works on physical registers: two VRs are the same
+    register when they have the same register index in the same bank.
+    The forward pass keeps a short list of spill slots whose value is
+    still sitting in a register; a def of that register drops the entry.
+*/
+
+#include "Peephole.h"
+#include "Stats.h"
+
+#include <algorithm>
+
+namespace {
+
+struct SlotCopy {
+    int slot;
+    int vreg;       // VR that holds the slot's value
+    int phys;       // its physical register
+};
+
+// Enough for spill-everywhere code, and keeps the pass linear
+constexpr size_t kMaxTracked = 8;
+
+}   // namespace
+
+PeepholeStats runPeephole(Function& fn, const Allocation& alloc, const TargetDesc& target) {
+    trace::FunctionScope scope(fn.name);
+    stats::Timer timer(Phase::Peephole);
+    PeepholeStats stats;
+
+    auto phys = [&](int v) {
+        int reg = alloc.reg[v];
+        return reg < 0 ? -1 - v : static_cast<int>(target.classes[alloc.regClass[v]].bank << 8) | reg;
+    };
+    auto slotOf = [](const Instruction& instr) {
+        return std::get<int>(instr.op == OpCode::LOAD ? instr.operands[0] : instr.operands[1]);
+    };
+
+    std::vector<int> pendingStore(alloc.numSpillSlots, -1);
+    std::vector<int> stored;        // slots given a pending store in this block, so the reset stays linear
+    std::vector<SlotCopy> tracked;
+
+    for (auto& block : fn.blocks) {
+        std::pmr::vector<Instruction> out(block->instructions.get_allocator());
+        std::vector<uint8_t> dead;
+        out.reserve(block->instructions.size());
+        tracked.clear();
+        for (int slot : stored) pendingStore[slot] = -1;
+        stored.clear();
+
+        auto clobber = [&](int p) {
+            std::erase_if(tracked, [p](const SlotCopy& c) { return c.phys == p; });
+        };
+        auto track = [&](int slot, int vreg) {
+            std::erase_if(tracked, [slot](const SlotCopy& c) { return c.slot == slot; });
+            if (tracked.size() == kMaxTracked) tracked.erase(tracked.begin());
+            tracked.push_back({slot, vreg, phys(vreg)});
+        };
+        auto find = [&](int slot) {
+            return std::find_if(tracked.begin(), tracked.end(), [slot](const SlotCopy& c) { return c.slot == slot; });
+        };
+
+        for (Instruction& instr : block->instructions) {
+            if (instr.op == OpCode::MOV && instr.def.has_value()) {
+                auto* src = std::get_if<VReg>(&instr.operands[0]);
+                if (src && phys(src->id) == phys(instr.def->id)) {
+                    // Changes no register, so nothing tracked is clobbered; the Writer leaves it out
+                    ++stats.selfMoves;
+                    out.push_back(std::move(instr));
+                    dead.push_back(0);
+                    continue;
+                }
+            }
+
+            if (instr.spill && instr.op == OpCode::LOAD) {
+                int slot = slotOf(instr);
+                int d = instr.def->id;
+                auto hit = find(slot);
+                if (hit != tracked.end() && hit->phys == phys(d)) {
+                    ++stats.reloadsRemoved;
+                    continue;
+                }
+                if (hit != tracked.end()) {
+                    instr = Instruction{.op = OpCode::MOV, .def = VReg{d}, .labels = {},
+                                        .operands = {VReg{hit->vreg}, std::monostate{}}, .spill = false};
+                    ++stats.reloadsToCopies;
+                } else {
+                    pendingStore[slot] = -1;
+                }
+                clobber(phys(d));
+                track(slot, d);
+                out.push_back(std::move(instr));
+                dead.push_back(0);
+                continue;
+            }
+
+            if (instr.spill && instr.op == OpCode::STORE) {
+                int slot = slotOf(instr);
+                int src = std::get<VReg>(instr.operands[0]).id;
+                auto hit = find(slot);
+                if (hit != tracked.end() && hit->phys == phys(src)) {
+                    // The slot already holds this register's value
+                    ++stats.deadStores;
+                    continue;
+                }
+                if (pendingStore[slot] >= 0) {
+                    dead[pendingStore[slot]] = 1;
+                    ++stats.deadStores;
+                } else {
+                    stored.push_back(slot);
+                }
+                pendingStore[slot] = static_cast<int>(out.size());
+                track(slot, src);
+                out.push_back(std::move(instr));
+                dead.push_back(0);
+                continue;
+            }
+
+            if (instr.def.has_value()) clobber(phys(instr.def->id));
+            out.push_back(std::move(instr));
+            dead.push_back(0);
+        }
+
+        block->instructions.clear();
+        for (size_t i = 0; i < out.size(); ++i) {
+            if (!dead[i]) block->instructions.push_back(std::move(out[i]));
+        }
+    }
+
+    // A slot no reload reads is never observed, so its stores are dead
+    std::vector<uint8_t> reloaded(alloc.numSpillSlots, 0);
+    for (const auto& block : fn.blocks) {
+        for (const Instruction& instr : block->instructions) {
+            if (instr.spill && instr.op == OpCode::LOAD) reloaded[slotOf(instr)] = 1;
+        }
+    }
+    for (auto& block : fn.blocks) {
+        stats.deadStores += static_cast<unsigned>(std::erase_if(block->instructions, [&](const Instruction& instr) {
+            return instr.spill && instr.op == OpCode::STORE && !reloaded[slotOf(instr)];
+        }));
+    }
+    stats::count(Counter::PeepholeRemoved, stats.instructionsRemoved());
+    return stats;
+}
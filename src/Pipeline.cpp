@@ -0,0 +1,124 @@
+/**
+    Pipeline.cpp strings the stages together in the order main.cpp used
+    to: Reader, Cleanup, RegisterAllocator, Peephole and Writer. A
+    function read from a file lives in the calling thread's arena,
+    which is released once its output has been produced.
+*/
+
+#include "Pipeline.h"
+#include "Arena.h"
+#include "Cleanup.h"
+#include "Interpreter.h"
+#include "Peephole.h"
+#include "Reader.h"
+#include "Stats.h"
+#include "Verifier.h"
+
+#include <stdexcept>
+
+PipelineResult runPipeline(Function& fn, const PipelineOptions& opts) {
+    PipelineResult result;
+    runPipeline(fn, opts, result);
+    return result;
+}
+
+void runPipeline(Function& fn, const PipelineOptions& opts, PipelineResult& result) {
+    if (!opts.target) throw std::invalid_argument("runPipeline: no target");
+    const TargetDesc& target = *opts.target;
+    result.output.clear();
+    result.log.clear();
+    result.cached = false;
+
+    // The key is taken before any pass rewrites fn. It must not be thread_local: while the allocator waits
+    // on the pool, this thread may run another function's pipeline
+    std::string key;
+    bool useCache = opts.cache && !opts.beforeAllocation && !opts.afterAllocation && !opts.execute;
+    if (useCache) {
+        key = ResultCache::key(fn, target, opts.format, opts.cleanup, opts.speculativeSpills);
+        if (opts.cache->lookup(key, result.output)) {
+            result.cached = true;
+            result.log += "[INFO] " + fn.name + ": cached result, pipeline skipped\n";
+            return;
+        }
+    }
+
+    if (opts.cleanup) {
+        CleanupStats cs = cleanupFunction(fn);
+        result.log += "[INFO] Cleanup removed " + std::to_string(cs.deadInstructions) +
+                      " dead instructions and propagated " + std::to_string(cs.propagatedUses) +
+                      " copy uses; VRs " + std::to_string(cs.vregsBefore) + " -> " + std::to_string(cs.vregsAfter) +
+                      ", instructions " + std::to_string(cs.instructionsBefore) + " -> " +
+                      std::to_string(cs.instructionsAfter) + "\n";
+    }
+    if (opts.beforeAllocation) opts.beforeAllocation(fn);
+    Execution input;
+    if (opts.execute) {
+        trace::FunctionScope scope(fn.name);
+        stats::Timer timer(Phase::Execute);
+        input = interpret(fn);
+        stats::count(Counter::ExecutedInput, input.stats.instructions);
+    }
+
+    RegisterAllocator allocator(target);
+    allocator.parallelLiveness(opts.pool);
+    allocator.parallelColoring(opts.pool);
+    allocator.speculativeSpills(opts.speculativeSpills);
+    Allocation alloc = allocator.allocate(fn);
+    if (opts.afterAllocation) opts.afterAllocation(fn, alloc);
+    if (opts.speculativeSpills) {
+        result.log += "[INFO] Spill heuristic wins:";
+        for (size_t h = 0; h < kNumSpillHeuristics; ++h) {
+            result.log += std::string(h == 0 ? " " : ", ") + std::string(kSpillHeuristicNames[h]) + " " +
+                          std::to_string(alloc.spillWins[h]);
+        }
+        result.log += "\n";
+    }
+
+    PeepholeStats peephole = runPeephole(fn, alloc, target);
+    result.log += "[INFO] Peephole removed " + std::to_string(peephole.instructionsRemoved()) + " instructions, " +
+                  std::to_string(peephole.memoryOpsRemoved()) + " memory ops\n";
+    // After the peephole pass, so that the code checked is the code written
+    if (opts.verify) {
+        trace::FunctionScope scope(fn.name);
+        stats::Timer timer(Phase::Verify);
+        std::vector<std::string> errors = verifyAllocation(fn, alloc, target, 1);
+        if (!errors.empty()) throw std::runtime_error("allocation failed verification: " + errors[0]);
+    }
+    if (opts.execute) {
+        Execution allocated;
+        {
+            trace::FunctionScope scope(fn.name);
+            stats::Timer timer(Phase::Execute);
+            allocated = interpret(fn, alloc, target);
+        }
+        stats::count(Counter::ExecutedAllocated, allocated.stats.instructions);
+        stats::count(Counter::ExecutedSpillOps, allocated.stats.spillOps());
+        result.log += "[INFO] Executed " + std::to_string(input.stats.instructions) + " -> " +
+                      std::to_string(allocated.stats.instructions) + " instructions, " +
+                      std::to_string(input.stats.memoryOps) + " -> " + std::to_string(allocated.stats.memoryOps) +
+                      " memory ops, " + std::to_string(allocated.stats.spillLoads) + " spill loads, " +
+                      std::to_string(allocated.stats.spillStores) + " spill stores, " +
+                      std::to_string(input.stats.copies) + " -> " + std::to_string(allocated.stats.copies) +
+                      " copies\n";
+        if (!input.completed || !allocated.completed) {
+            result.log += "[INFO] Execution stopped before RET; behaviour not compared\n";
+        } else if (!sameBehaviour(input, allocated)) {
+            throw std::runtime_error("allocated code behaves differently from its input");
+        }
+    }
+
+    trace::FunctionScope scope(fn.name);
+    stats::Timer timer(Phase::Write);
+    Writer writer(result.output, opts.format);
+    writer.write(fn, alloc, target);
+    writer.flush();
+    if (useCache) opts.cache->store(key, result.output);
+}
+
+PipelineResult runPipeline(const std::string& filename, const PipelineOptions& opts) {
+    ArenaScope arena;
+    Reader reader(arena.resource());
+    reader.parallelParse(opts.pool);
+    Function fn = reader.BuildCFG(filename);
+    return runPipeline(fn, opts);
+}
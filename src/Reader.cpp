@@ -11,122 +11,296 @@
 */
 
 #include "Reader.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+#include "Writer.h"
 #include "utils/h/Parser.h"
 
+#include <algorithm>
+#include <exception>
+#include <iterator>
 #include <stdexcept>
 #include <fstream>
 #include <string>
-#include <iostream>
-
-static OpCode toOpCode(std::string_view sv) {
-    if (sv == "ADD")   return OpCode::ADD;
-    if (sv == "SUB")   return OpCode::SUB;
-    if (sv == "MUL")   return OpCode::MUL;
-    if (sv == "MOV")   return OpCode::MOV;
-    if (sv == "LOAD")  return OpCode::LOAD;
-    if (sv == "STORE") return OpCode::STORE;
-    if (sv == "RET")   return OpCode::RET;
-    if (sv == "JMP")   return OpCode::JMP;
-    if (sv == "BEQ")   return OpCode::BEQ;
-    if (sv == "BZ")    return OpCode::BZ;
-    if (sv == "BNZ")   return OpCode::BNZ;
-    throw std::invalid_argument(std::string("Unknown opcode: ") + std::string(sv));
-}
+#include <filesystem>
 
-void TraverseCFG(const Function& func, const std::string& dotFileName) {
-    /* Traverse the CFG and output to a .dot file for a graphiz dump */
-    std::ofstream dotFile(dotFileName);
-    if (!dotFile.is_open()) {
-        std::cerr << "[ERROR] Could not open " << dotFileName << "\n";
-        return;
+namespace {
+
+// Chunks smaller than this are not worth a task of their own
+constexpr size_t kMinChunk = size_t{256} << 10;
+
+Instruction toInstruction(const ParsedInstr& parsed) {
+    if (parsed.form == ParsedInstr::Unknown)
+        throw std::invalid_argument(std::string("Unknown opcode: ") + std::string(parsed.opcode));
+    if (parsed.form == ParsedInstr::Malformed)
+        throw std::invalid_argument(std::string("Missing or malformed operands for ") + std::string(parsed.opcode));
+
+    // Convert string_view targets to optional<string> labels
+    std::array<std::optional<std::string>, 2> labels;
+    for (size_t t = 0; t < 2; ++t) {
+        if (parsed.targets[t].has_value()) labels[t] = std::string(*parsed.targets[t]);
     }
+    return Instruction{
+        .op       = parsed.op,
+        .def      = parsed.def,
+        .labels   = std::move(labels),
+        .operands = parsed.uses,
+        .spill    = parsed.spill
+    };
+}
 
-    dotFile << "digraph CFG {\n";
-    dotFile << "    node [shape=box];\n\n";
-    for (const auto& blockPtr : func.blocks) {
-        BasicBlock* curBlock = blockPtr.get();
-        dotFile << "    \"" << curBlock << "\" [label=\"" << curBlock->label << "\"];\n";
+/**
+    Parses text into blocks: newBlock(label) is called for each label
+    definition and addInstr(instr) for each instruction after it. Lines
+    before the first label belong to no block and are skipped.
+*/
+template <typename NewBlock, typename AddInstr>
+void parseBlocks(std::string_view text, NewBlock&& newBlock, AddInstr&& addInstr) {
+    InstrParser parser;
+    bool inBlock = false;
+    parser.parseText(text, [&](const ParsedInstr& result) {
+        if (result.form == ParsedInstr::LabelDef) {
+            newBlock(result.label);
+            inBlock = true;
+        } else if (inBlock) {
+            addInstr(toInstruction(result));
+        }
+    });
+}
 
-        for (BasicBlock* connectedBlock : curBlock->successors) {
-            dotFile << "    \"" << curBlock << "\" -> \"" << connectedBlock << "\";\n";
+/* Splits source into about n chunks, each but the first starting at a label line */
+std::vector<std::string_view> splitAtLabels(std::string_view source, size_t n) {
+    std::vector<std::string_view> chunks;
+    size_t start = 0;
+    for (size_t c = 1; c < n; ++c) {
+        // From an even split point, on to the start of the next label line
+        size_t pos = std::max(source.size() / n * c, start + 1);
+        pos = source.find('\n', pos - 1);
+        pos = pos == std::string_view::npos ? source.size() : pos + 1;
+        while (pos < source.size()) {
+            size_t eol = source.find('\n', pos);
+            if (eol == std::string_view::npos) eol = source.size();
+            if (InstrParser::isLabel(source.substr(pos, eol - pos))) break;
+            pos = eol + 1;
         }
+        if (pos >= source.size()) break;
+        chunks.push_back(source.substr(start, pos - start));
+        start = pos;
+    }
+    chunks.push_back(source.substr(start));
+    return chunks;
+}
+
+}   // namespace
 
-        // for (BasicBlock* connectedBlock : curBlock->predecessors) {
-        //     dotFile << "    \"" << curBlock << "\" -> \"" << connectedBlock << "\";\n";
-        // }
+Function Reader::BuildCFG(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("could not open " + filename);
+    std::string source{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    return BuildCFGFromSource(source, std::filesystem::path(filename).stem().string());
+}
+
+Function Reader::BuildCFGFromSource(std::string_view source, const std::string& name) {
+    func.name = name;
+    trace::FunctionScope scope(func.name);
+    {
+        stats::Timer timer(Phase::FindLeaders);
+        FindLeaders(source);
     }
+    return finish();
+}
 
-    dotFile << "}\n";
-    std::cout << "[INFO] CFG exported to " << dotFileName << "\n";
+Function Reader::BuildCFGFromBinary(std::string_view data, const std::string& name) {
+    func.name = name;
+    trace::FunctionScope scope(func.name);
+    {
+        stats::Timer timer(Phase::FindLeaders);
+        ReadBinary(data);
+    }
+    return finish();
 }
 
-Function Reader::BuildCFG(const std::string& filename) {
-    FindLeaders(filename);
-    BuildGraph();
-    // NOTE: There is a copy here
-    TraverseCFG(func, "test.dot");
+Function Reader::finish() {
+    {
+        stats::Timer timer(Phase::BuildGraph);
+        BuildGraph();
+    }
+    if (stats::current()) {
+        size_t instructions = 0;
+        for (const auto& block : func.blocks)
+            instructions += block->instructions.size();
+        stats::count(Counter::Blocks, func.blocks.size());
+        stats::count(Counter::Instructions, instructions);
+    }
     return std::move(func);
 }
 
-void Reader::FindLeaders(const std::string& filename) {
+void Reader::FindLeaders(std::string_view source) {
     /**
         Iterate through the file's lines. When a label declaration
-        is found, collect subsequent instructions into a vector. When
-        another label declaration is found, create and add a BasicBlock
-        with the accumulated instructions. The loop then processes the
-        new label on the next iteration.
+        is found, start a new BasicBlock and collect the subsequent
+        instructions into it until the next label declaration.
     */
+    if (parsePool && source.size() >= parallelMinBytes && source.size() >= 2 * kMinChunk) {
+        FindLeadersParallel(source);
+        return;
+    }
 
-    InstrParser parser;
-    std::ifstream file(filename);
-    std::vector<std::string> lines;
-    std::string str;
-    while (std::getline(file, str)) {
-        lines.push_back(str);
+    int idCounter = 0;
+    BasicBlock* block = nullptr;
+    parseBlocks(source,
+        [&](std::string_view label) {
+            block = func.addBlock(idCounter++, std::string(label));
+            func.labelToBlock[block->label] = block;
+        },
+        [&](Instruction&& instr) { block->instructions.push_back(std::move(instr)); });
+}
+
+void Reader::FindLeadersParallel(std::string_view source) {
+    /**
+        Each chunk starts at a label line (the first at the start of the
+        file), so chunks parse independently into their own block lists.
+        The function's arena is not thread-safe: blocks and instruction
+        lists are allocated from it afterwards on this thread, and the
+        chunks then move their instructions into the reserved lists.
+    */
+    struct ChunkBlock {
+        std::string_view label;
+        std::vector<Instruction> instructions;
+    };
+
+    size_t wanted = std::min<size_t>(size_t{parsePool->size()} * 4, source.size() / kMinChunk);
+    std::vector<std::string_view> chunks = splitAtLabels(source, std::max<size_t>(wanted, 1));
+    std::vector<std::vector<ChunkBlock>> parsed(chunks.size());
+    std::vector<std::exception_ptr> errors(chunks.size());
+
+    parsePool->parallelFor(chunks.size(), [&](size_t c) {
+        trace::FunctionScope scope(func.name);
+        trace::Span span("ParseChunk", static_cast<int64_t>(c));
+        try {
+            std::vector<ChunkBlock>& blocks = parsed[c];
+            parseBlocks(chunks[c],
+                [&](std::string_view label) { blocks.push_back({label, {}}); },
+                [&](Instruction&& instr) { blocks.back().instructions.push_back(std::move(instr)); });
+        } catch (...) {
+            errors[c] = std::current_exception();
+        }
+    });
+    // The earliest chunk's error is the one a sequential parse would have hit first
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
     }
 
+    // Numbered in file order, exactly as the sequential parse numbers them
+    std::vector<size_t> firstBlock(chunks.size());
     int idCounter = 0;
-    size_t i = 0;
-
-    while (i < lines.size()) {
-        auto result = parser.parse(lines[i]);
-        if (!result || result->form != ParsedInstr::LabelDef) { ++i; continue; }
-
-        std::string blockLabel{result->label};
-        ++i;
-        std::vector<Instruction> blockInstructions;
-
-        while (i < lines.size()) {
-            auto inner = parser.parse(lines[i]);
-            if (!inner) { ++i; continue; }
-            if (inner->form == ParsedInstr::LabelDef) break;
-
-            // Convert string_view targets to optional<string> labels
-            std::array<std::optional<std::string>, 2> labels;
-            labels[0] = inner->targets[0].has_value()
-                ? std::optional<std::string>{std::string(inner->targets[0].value())}
-                : std::nullopt;
-            labels[1] = inner->targets[1].has_value()
-                ? std::optional<std::string>{std::string(inner->targets[1].value())}
-                : std::nullopt;
-
-            blockInstructions.push_back(Instruction{
-                .op       = toOpCode(inner->opcode),
-                .def      = inner->def,
-                .labels   = labels,
-                .operands = inner->uses
-            });
-            ++i;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        firstBlock[c] = func.blocks.size();
+        for (const ChunkBlock& cb : parsed[c]) {
+            BasicBlock* block = func.addBlock(idCounter++, std::string(cb.label));
+            block->instructions.reserve(cb.instructions.size());
+            func.labelToBlock[block->label] = block;
+        }
+    }
+    parsePool->parallelFor(chunks.size(), [&](size_t c) {
+        for (size_t b = 0; b < parsed[c].size(); ++b) {
+            auto& from = parsed[c][b].instructions;
+            auto& to = func.blocks[firstBlock[c] + b]->instructions;
+            to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
         }
+    });
+}
+
+void Reader::ReadBinary(std::string_view data) {
+    /*
+        Mirrors Writer::writeBinary. Branch targets are block indices,
+        which may point forward, so they are resolved to labels once
+        every block has been read.
+    **/
+    size_t pos = 0;
+    auto need = [&](size_t n) {
+        if (data.size() - pos < n) throw std::runtime_error("truncated binary IR");
+    };
+    auto u8 = [&] {
+        need(1);
+        return static_cast<uint8_t>(data[pos++]);
+    };
+    auto u32 = [&] {
+        need(4);
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= static_cast<uint32_t>(static_cast<uint8_t>(data[pos++])) << (8 * i);
+        return v;
+    };
+    auto operand = [&]() -> Operands {
+        auto kind = static_cast<BinaryOperand>(u8());
+        auto value = static_cast<int32_t>(u32());
+        if (kind == BinaryOperand::VReg) {
+            // VR ids index every per-VR table of the passes
+            if (value < 0) throw std::runtime_error("negative virtual register in binary IR");
+            return VReg{value};
+        }
+        if (kind == BinaryOperand::Immediate) return value;
+        throw std::runtime_error("binary IR input must use virtual registers");
+    };
 
-        auto block = std::make_unique<BasicBlock>(BasicBlock{
-            .id           = idCounter++,
-            .label        = blockLabel,
-            .instructions = std::move(blockInstructions)
-        });
+    need(sizeof(kBinaryMagic));
+    if (data.substr(0, sizeof(kBinaryMagic)) != std::string_view(kBinaryMagic, sizeof(kBinaryMagic)))
+        throw std::runtime_error("not binary iON IR");
+    pos += sizeof(kBinaryMagic);
+    if (u8() != kBinaryVersion) throw std::runtime_error("unsupported binary IR version");
+
+    uint32_t numBlocks = u32();
+    struct Branch {
+        uint32_t block, instr;
+        std::array<uint32_t, 2> targets;
+    };
+    std::vector<Branch> branches;
+    for (uint32_t b = 0; b < numBlocks; ++b) {
+        uint32_t length = u32();
+        need(length);
+        std::string label(data.substr(pos, length));
+        pos += length;
+
+        uint32_t numInstrs = u32();
+        BasicBlock* block = func.addBlock(static_cast<int>(b), label);
+        block->instructions.reserve(std::min<size_t>(numInstrs, data.size() - pos));
+        for (uint32_t i = 0; i < numInstrs; ++i) {
+            Instruction instr{.op = static_cast<OpCode>(u8()), .def = std::nullopt, .labels = {}, .operands = {}};
+            if (instr.op > OpCode::BNZ) throw std::runtime_error("unknown opcode in binary IR");
+            uint8_t flags = u8();
+            if (flags & 2) throw std::runtime_error("binary IR input must not contain spill code");
+            if (flags & 1) {
+                Operands def = operand();
+                if (!std::holds_alternative<VReg>(def)) throw std::runtime_error("def must be a register");
+                instr.def = std::get<VReg>(def);
+            }
+            uint8_t numUses = u8();
+            if (numUses > 2) throw std::runtime_error("too many operands in binary IR");
+            for (uint8_t u = 0; u < numUses; ++u)
+                instr.operands[u] = operand();
+            uint8_t numTargets = u8();
+            if (numTargets > 2) throw std::runtime_error("too many branch targets in binary IR");
+            std::array<uint32_t, 2> targets{};
+            for (uint8_t t = 0; t < numTargets; ++t) {
+                targets[t] = u32();
+                if (targets[t] >= numBlocks) throw std::runtime_error("branch to unknown block in binary IR");
+            }
+            block->instructions.push_back(std::move(instr));
+            if (numTargets > 0) {
+                for (uint8_t t = numTargets; t < 2; ++t) targets[t] = UINT32_MAX;
+                branches.push_back({b, i, targets});
+            }
+        }
+        func.labelToBlock[label] = block;
+    }
 
-        func.labelToBlock[blockLabel] = block.get();
-        func.blocks.push_back(std::move(block));
+    for (const Branch& br : branches) {
+        Instruction& instr = func.blocks[br.block]->instructions[br.instr];
+        for (size_t t = 0; t < 2; ++t) {
+            if (br.targets[t] != UINT32_MAX) instr.labels[t] = func.blocks[br.targets[t]]->label;
+        }
     }
 }
 
@@ -137,6 +311,14 @@ void Reader::BuildGraph() {
         the instructions. Edges are created by using the predecessor
         and successor vectors of BasicBlock* inside of each BasicBlock.
     */
+    auto edge = [&](BasicBlock* block, const std::string& label) {
+        auto it = func.labelToBlock.find(label);
+        if (it == func.labelToBlock.end())
+            throw std::invalid_argument("Branch to unknown label: " + label);
+        block->successors.push_back(it->second);
+        it->second->predecessors.push_back(block);
+    };
+
     for (size_t i = 0; i < func.blocks.size(); i++) {
         BasicBlock* block = func.blocks[i].get();
         for (size_t j = 0; j < block->instructions.size(); j++) {
@@ -144,34 +326,18 @@ void Reader::BuildGraph() {
 
             /**
                 BEQ: <opcode> <operand1>, <operand2>, <label1>, <label2>
-                Add edges from current block to both target blocks.
-            */
-            if (instr.op == OpCode::BEQ) {
-                BasicBlock* target1 = func.labelToBlock[instr.labels[0].value()];
-                BasicBlock* target2 = func.labelToBlock[instr.labels[1].value()];
-
-                block->successors.push_back(target1);
-                block->successors.push_back(target2);
-
-                target1->predecessors.push_back(block);
-                target2->predecessors.push_back(block);
-            }
-
-            /**
                 BZ/BNZ: <opcode> <operand1>, <label1>, <label2>
-                Add edge from current block to one target block.
+                Add edges from current block to both target blocks.
             */
-            else if (instr.op == OpCode::BZ || instr.op == OpCode::BNZ) {
-                BasicBlock* target1 = func.labelToBlock[instr.labels[0].value()];
-                block->successors.push_back(target1);
-                target1->predecessors.push_back(block);
+            if (instr.op == OpCode::BEQ || instr.op == OpCode::BZ || instr.op == OpCode::BNZ) {
+                for (const auto& label : instr.labels) {
+                    if (label.has_value()) edge(block, *label);
+                }
             }
 
             /* Unconditional jump */
             else if (instr.op == OpCode::JMP) {
-                BasicBlock* target = func.labelToBlock[instr.labels[0].value()];
-                block->successors.push_back(target);
-                target->predecessors.push_back(block);
+                edge(block, instr.labels[0].value());
             }
         }
     }
@@ -0,0 +1,376 @@
+/**
+    RegisterAllocator.cpp ties the allocator stages together. The
+    interference graph, coalescing and colouring of a bank only read the
+    function, so banks run as independent tasks; spill code is inserted
+    afterwards, on one thread, once every bank has finished the round.
+    With speculative spilling a bank's graph is coloured once per spill
+    metric; the colourings only read the graph, so they share it.
+*/
+
+#include "RegisterAllocator.h"
+#include "Liveness.h"
+#include "InterferenceGraph.h"
+#include "GraphCoalescing.h"
+#include "GraphColoring.h"
+#include "LocalAllocator.h"
+#include "RegisterPressure.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <future>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+
+// Each round spills only VRs the previous one could not colour, so this is generous
+constexpr unsigned kMaxRounds = 32;
+
+struct BankResult {
+    ColoringResult coloring;
+    std::vector<int> alias;
+    unsigned coalesced = 0;
+    // Speculative spilling only: the metric kept, and whether any metric spilled
+    SpillHeuristic heuristic = SpillHeuristic::CostOverDegree;
+    bool contested = false;
+};
+
+/* What speculative spilling needs on top of the plain costs, for one round */
+struct LoopCosts {
+    std::vector<float> weight;      // block position -> 10^loop depth
+    std::vector<float> cost;        // VR -> weighted defs and uses; infinite for spill temporaries
+};
+
+void neverSpillTemporaries(std::vector<float>& cost, const Allocation& alloc) {
+    for (size_t v = 0; v < cost.size(); ++v) {
+        if (alloc.origin[v] != static_cast<int>(v))
+            cost[v] = std::numeric_limits<float>::infinity();
+    }
+}
+
+/* Number of defs and uses; spill temporaries must never be spilled again */
+std::vector<float> spillCosts(const Function& fn, const Allocation& alloc) {
+    std::vector<float> cost(alloc.regClass.size(), 0.0f);
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.def.has_value()) cost[instr.def->id] += 1.0f;
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use)) cost[reg->id] += 1.0f;
+            }
+        }
+    }
+    neverSpillTemporaries(cost, alloc);
+    return cost;
+}
+
+/* Copies within the bank whose two sides were given the same register, which the writer drops */
+unsigned sharedCopies(const Function& fn, const Allocation& alloc, const std::vector<unsigned>& classBank,
+                      unsigned bank, const std::vector<int>& color) {
+    unsigned shared = 0;
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.op != OpCode::MOV || !instr.def.has_value()) continue;
+            auto* src = std::get_if<VReg>(&instr.operands[0]);
+            int d = instr.def->id;
+            if (src && src->id != d && classBank[alloc.regClass[d]] == bank && color[src->id] == color[d])
+                ++shared;
+        }
+    }
+    return shared;
+}
+
+/**
+    Colours graph once per SpillHeuristic and keeps the colouring whose
+    spilled nodes have the lowest loop-weighted cost. Every metric is
+    scaled by the same relief as nodeCost, so only the metric differs.
+*/
+void colorSpeculatively(const Function& fn, const LivenessResult& lr, const InterferenceGraph& graph,
+                        const LoopCosts& loop, const std::vector<float>& nodeCost,
+                        const std::vector<unsigned>& nodeRelief, uint64_t allocatable, uint64_t preferred,
+                        ThreadPool* pool, BankResult& result) {
+    size_t numVRegs = nodeCost.size();
+    std::vector<float> area = liveArea(fn, lr, loop.weight, numVRegs);
+    std::vector<float> nodeArea(numVRegs, 0.0f);
+    std::vector<float> nodeLoopCost(numVRegs, 0.0f);
+    for (size_t v = 0; v < numVRegs; ++v) {
+        int rep = findAlias(result.alias, static_cast<int>(v));
+        nodeArea[rep] += area[v];
+        nodeLoopCost[rep] += loop.cost[v];
+    }
+    std::vector<float> areaRank(numVRegs);
+    std::vector<float> loopRank(numVRegs);
+    for (size_t v = 0; v < numVRegs; ++v) {
+        areaRank[v] = nodeCost[v] / std::max(nodeArea[v], 1.0f);
+        loopRank[v] = nodeLoopCost[v] / static_cast<float>(1 + nodeRelief[v]);
+    }
+
+    // In SpillHeuristic order; the two degree metrics differ only in the divisor
+    const std::array<const std::vector<float>*, kNumSpillHeuristics> rank{
+        &nodeCost, &nodeCost, &areaRank, &loopRank};
+    std::array<ColoringResult, kNumSpillHeuristics> colorings;
+    auto color = [&](size_t h) {
+        SpillDivisor divisor = static_cast<SpillHeuristic>(h) == SpillHeuristic::CostOverDegreeSquared
+                                   ? SpillDivisor::DegreeSquared
+                                   : SpillDivisor::Degree;
+        colorings[h] = colorGraph(graph, allocatable, preferred, *rank[h], pool, divisor);
+    };
+    if (pool && pool->size() > 1) {
+        pool->parallelFor(kNumSpillHeuristics, color);
+    } else {
+        for (size_t h = 0; h < kNumSpillHeuristics; ++h) color(h);
+    }
+
+    size_t best = 0;
+    float bestCost = std::numeric_limits<float>::infinity();
+    for (size_t h = 0; h < kNumSpillHeuristics; ++h) {
+        float spillCost = 0.0f;
+        for (int n : colorings[h].spilled) spillCost += nodeLoopCost[n];
+        result.contested |= !colorings[h].spilled.empty();
+        if (h == 0 || spillCost < bestCost) {
+            best = h;
+            bestCost = spillCost;
+        }
+    }
+    result.heuristic = static_cast<SpillHeuristic>(best);
+    result.coloring = std::move(colorings[best]);
+}
+
+BankResult allocateBank(const Function& fn, const LivenessResult& lr, const Allocation& alloc,
+                        const std::vector<unsigned>& classBank, const std::vector<float>& cost,
+                        const LoopCosts* loop, uint64_t allocatable, uint64_t preferred, unsigned bank,
+                        std::pmr::memory_resource* resource, ThreadPool* pool) {
+    BankResult result;
+    result.alias.resize(alloc.regClass.size());
+    for (size_t v = 0; v < result.alias.size(); ++v)
+        result.alias[v] = static_cast<int>(v);
+    unsigned k = static_cast<unsigned>(std::popcount(allocatable));
+
+    // Within k everywhere, the bank is usually coloured without building its graph
+    RegisterPressure pressure(resource);
+    {
+        stats::Timer timer(Phase::Pressure);
+        pressure = computePressure(fn, lr, alloc.regClass, classBank, bank, resource);
+        if (pressure.max <= k &&
+            assignWithoutGraph(fn, lr, alloc.regClass, classBank, bank, allocatable, preferred, result.coloring,
+                               resource)) {
+            result.coalesced = sharedCopies(fn, alloc, classBank, bank, result.coloring.color);
+            stats::count(Counter::FastPathBanks, 1);
+            return result;
+        }
+    }
+
+    InterferenceGraph graph = [&] {
+        stats::Timer timer(Phase::InterferenceGraph);
+        return buildInterferenceGraph(fn, lr, alloc.regClass, classBank, bank, resource);
+    }();
+    if (stats::current()) {
+        stats::count(Counter::InterferenceNodes, graph.nodes().size());
+        stats::count(Counter::InterferenceEdges, graph.numEdges());
+    }
+
+    {
+        stats::Timer timer(Phase::Coalescing);
+        result.coalesced = coalesceCopies(fn, graph, k, result.alias);
+    }
+
+    // A coalesced node costs as much as all of the VRs merged into it, spread over the
+    // blocks above k that spilling it relieves
+    std::vector<unsigned> relief = excessBlocks(fn, lr, pressure, k, alloc.regClass, classBank, bank);
+    std::vector<float> nodeCost(cost.size(), 0.0f);
+    std::vector<unsigned> nodeRelief(cost.size(), 0);
+    for (size_t v = 0; v < cost.size(); ++v) {
+        int rep = findAlias(result.alias, static_cast<int>(v));
+        nodeCost[rep] += cost[v];
+        nodeRelief[rep] = std::max(nodeRelief[rep], relief[v]);
+    }
+    for (size_t v = 0; v < cost.size(); ++v)
+        nodeCost[v] /= static_cast<float>(1 + nodeRelief[v]);
+
+    stats::Timer timer(Phase::Coloring);
+    if (loop) colorSpeculatively(fn, lr, graph, *loop, nodeCost, nodeRelief, allocatable, preferred, pool, result);
+    else result.coloring = colorGraph(graph, allocatable, preferred, nodeCost, pool);
+    return result;
+}
+
+int newVReg(Allocation& alloc, int like) {
+    int id = static_cast<int>(alloc.regClass.size());
+    alloc.regClass.push_back(alloc.regClass[like]);
+    alloc.origin.push_back(alloc.origin[like]);
+    alloc.reg.push_back(-1);
+    return id;
+}
+
+/**
+    EaC's spill everywhere: every use of a spilled VR reloads it into a
+    fresh temporary just before the instruction, and every def writes a
+    fresh temporary that is stored straight after it. The temporaries
+    live for a single instruction, so they are never spilled again.
+*/
+void insertSpillCode(Function& fn, Allocation& alloc, const std::vector<int>& slotOf) {
+    stats::Timer timer(Phase::SpillCode);
+    auto slot = [&](int v) { return v < static_cast<int>(slotOf.size()) ? slotOf[v] : -1; };
+
+    for (auto& block : fn.blocks) {
+        std::pmr::vector<Instruction> rewritten(block->instructions.get_allocator());
+        rewritten.reserve(block->instructions.size());
+
+        for (Instruction instr : block->instructions) {
+            std::array<std::pair<int, int>, 2> reloaded{{{-1, -1}, {-1, -1}}};
+            for (size_t i = 0; i < instr.operands.size(); ++i) {
+                auto* reg = std::get_if<VReg>(&instr.operands[i]);
+                if (!reg || slot(reg->id) < 0) continue;
+
+                // ADD %1, %2, %2 reloads %2 once
+                if (i == 1 && reloaded[0].first == reg->id) {
+                    reg->id = reloaded[0].second;
+                    continue;
+                }
+                int temp = newVReg(alloc, reg->id);
+                rewritten.push_back(Instruction{
+                    .op = OpCode::LOAD, .def = VReg{temp}, .labels = {},
+                    .operands = {slot(reg->id), std::monostate{}}, .spill = true});
+                reloaded[i] = {reg->id, temp};
+                reg->id = temp;
+            }
+
+            int storeSlot = -1;
+            int storeTemp = -1;
+            if (instr.def.has_value() && slot(instr.def->id) >= 0) {
+                storeSlot = slot(instr.def->id);
+                storeTemp = newVReg(alloc, instr.def->id);
+                instr.def = VReg{storeTemp};
+            }
+
+            rewritten.push_back(std::move(instr));
+            if (storeTemp >= 0) {
+                rewritten.push_back(Instruction{
+                    .op = OpCode::STORE, .def = std::nullopt, .labels = {},
+                    .operands = {VReg{storeTemp}, storeSlot}, .spill = true});
+            }
+        }
+        stats::count(Counter::SpillInstructions, rewritten.size() - block->instructions.size());
+        block->instructions = std::move(rewritten);
+    }
+}
+
+}   // namespace
+
+Allocation RegisterAllocator::allocate(Function& fn) {
+    trace::FunctionScope scope(fn.name);
+    trace::Span span("Allocate");
+    // Spill slots are numbered from 0 per allocation, so ones the input already uses would be shared
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.spill) throw std::runtime_error(fn.name + ": input must not contain spill code");
+        }
+    }
+    Allocation alloc;
+    int numVRegs = maxVRegID(fn) + 1;
+    alloc.reg.assign(numVRegs, -1);
+    alloc.regClass.resize(numVRegs);
+    alloc.origin.resize(numVRegs);
+    for (int v = 0; v < numVRegs; ++v) {
+        alloc.regClass[v] = target.classOf(v);
+        alloc.origin[v] = v;
+    }
+
+    std::vector<unsigned> classBank(target.numClasses);
+    for (unsigned c = 0; c < target.numClasses; ++c)
+        classBank[c] = target.classes[c].bank;
+
+    std::vector<unsigned> banks;
+    std::vector<uint64_t> preferred(target.numBanks(), 0);
+    for (unsigned b = 0; b < target.numBanks(); ++b) {
+        if (target.bankRegs(b) != 0) banks.push_back(b);
+    }
+    for (unsigned c = 0; c < target.numClasses; ++c)
+        preferred[classBank[c]] |= target.classes[c].callerSaved;
+
+    // Without merges every path is straight-line code, which needs neither liveness nor a graph
+    if (hasNoMerges(fn)) {
+        allocateLocal(fn, target, alloc);
+        stats::count(Counter::AllocationRounds, alloc.rounds);
+        stats::count(Counter::SpilledVRegs, alloc.spilledVRegs);
+        stats::count(Counter::CoalescedCopies, alloc.coalescedCopies);
+        return alloc;
+    }
+
+    LivenessAnalysis la;
+    la.parallelSolve(livenessPool);
+    // Spill code adds no blocks, so the loop nest holds for every round
+    std::optional<LoopCosts> loop;
+    if (speculative) loop.emplace().weight = blockWeights(loopDepths(fn));
+    while (alloc.rounds < kMaxRounds) {
+        ++alloc.rounds;
+        trace::Span round("Round", alloc.rounds);
+        LivenessResult lr = la.analyse(fn);
+        std::vector<float> cost = spillCosts(fn, alloc);
+        if (loop) {
+            loop->cost = weightedOccurrences(fn, loop->weight, alloc.regClass.size());
+            neverSpillTemporaries(loop->cost, alloc);
+        }
+
+        auto run = [&](unsigned bank) {
+            // Bank tasks run on their own threads, which start with no function scope
+            trace::FunctionScope bankScope(fn.name);
+            // A function's arena is not thread-safe, so concurrent banks each build their graph in their own
+            std::pmr::monotonic_buffer_resource bankArena;
+            std::pmr::memory_resource* resource = banks.size() == 1 ? fn.resource() : &bankArena;
+            return allocateBank(fn, lr, alloc, classBank, cost, loop ? &*loop : nullptr,
+                                target.allocatable(bank), preferred[bank], bank, resource, coloringPool);
+        };
+        std::vector<BankResult> results;
+        if (banks.size() == 1) {
+            results.push_back(run(banks[0]));
+        } else {
+            std::vector<std::future<BankResult>> pending;
+            for (unsigned bank : banks)
+                pending.push_back(std::async(std::launch::async, run, bank));
+            for (auto& f : pending)
+                results.push_back(f.get());
+        }
+
+        // Coalesced VRs share their representative's register and spill slot
+        std::vector<int> slotOf;
+        std::vector<int> repSlot(alloc.regClass.size(), -1);
+        bool spilled = false;
+        alloc.coalescedCopies = 0;
+        for (size_t i = 0; i < banks.size(); ++i) {
+            BankResult& br = results[i];
+            alloc.coalescedCopies += br.coalesced;
+            if (br.contested) {
+                ++alloc.spillWins[static_cast<size_t>(br.heuristic)];
+                stats::count(static_cast<Counter>(static_cast<size_t>(Counter::SpillWinsCostDegree) +
+                                                  static_cast<size_t>(br.heuristic)), 1);
+            }
+            for (int rep : br.coloring.spilled) {
+                repSlot[rep] = alloc.numSpillSlots++;
+                ++alloc.spilledVRegs;
+                spilled = true;
+            }
+            for (size_t v = 0; v < alloc.regClass.size(); ++v) {
+                if (classBank[alloc.regClass[v]] != banks[i]) continue;
+                int rep = findAlias(br.alias, static_cast<int>(v));
+                alloc.reg[v] = br.coloring.color[rep];
+                if (repSlot[rep] >= 0) {
+                    slotOf.resize(alloc.regClass.size(), -1);
+                    slotOf[v] = repSlot[rep];
+                }
+            }
+        }
+
+        if (!spilled) {
+            stats::count(Counter::AllocationRounds, alloc.rounds);
+            stats::count(Counter::SpilledVRegs, alloc.spilledVRegs);
+            stats::count(Counter::CoalescedCopies, alloc.coalescedCopies);
+            return alloc;
+        }
+        insertSpillCode(fn, alloc, slotOf);
+    }
+    throw std::runtime_error("register allocation of " + fn.name + " did not converge after " +
+                             std::to_string(kMaxRounds) + " rounds");
+}
@@ -0,0 +1,213 @@
+/**
+    RegisterPressure.cpp: MaxLive per block and the graph-free
+    assignment it enables. Both walk each block bottom-up from LiveOut
+    over a SparseSet of live VRs, as the interference graph builder
+    does. The assignment also keeps a count of the live VRs holding each
+    register, so finding a free register and checking a def are a few
+    word operations whatever the number of VRs.
+*/
+
+#include "RegisterPressure.h"
+#include "SparseSet.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <unordered_map>
+#include <utility>
+
+std::pmr::vector<int> reversePostorder(const Function& fn, std::pmr::memory_resource* resource) {
+    int N = static_cast<int>(fn.blocks.size());
+    std::pmr::unordered_map<const BasicBlock*, int> position(resource);
+    for (int i = 0; i < N; ++i)
+        position[fn.blocks[i].get()] = i;
+
+    std::pmr::vector<int> order(resource);
+    order.reserve(N);
+    std::pmr::vector<uint8_t> visited(N, 0, resource);
+    std::pmr::vector<std::pair<int, size_t>> stack(resource);
+    for (int root = 0; root < N; ++root) {
+        if (visited[root]) continue;
+        size_t reachable = order.size();
+        visited[root] = 1;
+        stack.push_back({root, 0});
+        while (!stack.empty()) {
+            auto& [b, next] = stack.back();
+            const auto& succs = fn.blocks[b]->successors;
+            if (next < succs.size()) {
+                int s = position.at(succs[next++]);
+                if (!visited[s]) {
+                    visited[s] = 1;
+                    stack.push_back({s, 0});
+                }
+                continue;
+            }
+            order.push_back(b);
+            stack.pop_back();
+        }
+        std::reverse(order.begin() + static_cast<std::ptrdiff_t>(reachable), order.end());
+    }
+    return order;
+}
+
+RegisterPressure computePressure(const Function& fn, const LivenessResult& lr,
+                                 const std::vector<uint8_t>& regClass,
+                                 const std::vector<unsigned>& classBank, unsigned bank,
+                                 std::pmr::memory_resource* resource) {
+    int numVRegs = static_cast<int>(regClass.size());
+    auto inBank = [&](int v) { return classBank[regClass[v]] == bank; };
+
+    RegisterPressure pressure(resource);
+    pressure.block.reserve(fn.blocks.size());
+    SparseSet live(numVRegs, resource);
+    for (const auto& block : fn.blocks) {
+        live.clear();
+        if (auto it = lr.liveoutSet.find(block->id); it != lr.liveoutSet.end()) {
+            for (int v : it->second) {
+                if (v < numVRegs && inBank(v)) live.insert(v);
+            }
+        }
+
+        size_t peak = live.size();
+        for (auto it = block->instructions.rbegin(); it != block->instructions.rend(); ++it) {
+            const Instruction& instr = *it;
+            if (instr.def.has_value() && inBank(instr.def->id)) {
+                peak = std::max(peak, live.size() + !live.contains(instr.def->id));
+                live.erase(instr.def->id);
+            }
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use); reg && inBank(reg->id)) live.insert(reg->id);
+            }
+            peak = std::max(peak, live.size());
+        }
+        pressure.block.push_back(static_cast<unsigned>(peak));
+        pressure.max = std::max(pressure.max, static_cast<unsigned>(peak));
+    }
+    return pressure;
+}
+
+bool assignWithoutGraph(const Function& fn, const LivenessResult& lr,
+                        const std::vector<uint8_t>& regClass,
+                        const std::vector<unsigned>& classBank, unsigned bank,
+                        uint64_t allocatable, uint64_t preferred, ColoringResult& result,
+                        std::pmr::memory_resource* resource) {
+    int numVRegs = static_cast<int>(regClass.size());
+    auto inBank = [&](int v) { return classBank[regClass[v]] == bank; };
+    result.color.assign(numVRegs, -1);
+    result.spilled.clear();
+    std::vector<int>& color = result.color;
+
+    // Live VRs holding each register, and the registers with any
+    std::array<unsigned, 64> holders{};
+    uint64_t busy = 0;
+    SparseSet live(numVRegs, resource);
+
+    auto firstFree = [&]() {
+        uint64_t free = allocatable & ~busy;
+        if (free == 0) return -1;
+        return std::countr_zero((free & preferred) ? (free & preferred) : free);
+    };
+    // The other side of a copy v takes part in, whose register v would rather share
+    std::pmr::vector<int> partner(numVRegs, -1, resource);
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.op != OpCode::MOV || !instr.def.has_value() || !inBank(instr.def->id)) continue;
+            if (auto* src = std::get_if<VReg>(&instr.operands[0]); src && inBank(src->id)) {
+                partner[instr.def->id] = src->id;
+                partner[src->id] = instr.def->id;
+            }
+        }
+    }
+    auto choose = [&](int v, int hint) {
+        int partnerColor = partner[v] >= 0 ? color[partner[v]] : -1;
+        for (int c : {hint, partnerColor}) {
+            if (c >= 0 && !(busy >> c & 1)) return c;
+        }
+        return firstFree();
+    };
+    // Makes v live, giving it a register first if it has none yet
+    auto enter = [&](int v, int hint) {
+        if (live.contains(v)) return true;
+        if (color[v] < 0 && (color[v] = choose(v, hint)) < 0) return false;
+        live.insert(v);
+        if (holders[color[v]]++ == 0) busy |= uint64_t{1} << color[v];
+        return true;
+    };
+    auto leave = [&](int v) {
+        if (!live.contains(v)) return;
+        live.erase(v);
+        if (--holders[color[v]] == 0) busy &= ~(uint64_t{1} << color[v]);
+    };
+
+    for (int b : reversePostorder(fn, resource)) {
+        const BasicBlock& block = *fn.blocks[b];
+        while (live.size() > 0) leave(*live.begin());
+        if (auto it = lr.liveoutSet.find(block.id); it != lr.liveoutSet.end()) {
+            for (int v : it->second) {
+                if (v < numVRegs && inBank(v) && !enter(v, -1)) return false;
+            }
+        }
+
+        for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it) {
+            const Instruction& instr = *it;
+            int hint = -1;
+            if (instr.def.has_value() && inBank(instr.def->id)) {
+                int d = instr.def->id;
+                // MOV d, s: d and s hold the same value, so they may share a register
+                const VReg* copySrc = instr.op == OpCode::MOV ? std::get_if<VReg>(&instr.operands[0]) : nullptr;
+                int s = copySrc && inBank(copySrc->id) && copySrc->id != d ? copySrc->id : -1;
+                bool sLive = s >= 0 && live.contains(s);
+                if (color[d] < 0) {
+                    if (s >= 0 && color[s] >= 0 && holders[color[s]] == static_cast<unsigned>(sLive))
+                        color[d] = color[s];
+                    else if ((color[d] = choose(d, -1)) < 0)
+                        return false;
+                }
+
+                // Nothing live across d other than d itself and its copy source may share its register
+                unsigned others = holders[color[d]] - live.contains(d) - (sLive && color[s] == color[d]);
+                if (others > 0) return false;
+                leave(d);
+                if (s >= 0) hint = color[d];
+            }
+
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use); reg && inBank(reg->id) && !enter(reg->id, hint))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<unsigned> excessBlocks(const Function& fn, const LivenessResult& lr,
+                                   const RegisterPressure& pressure, unsigned k,
+                                   const std::vector<uint8_t>& regClass,
+                                   const std::vector<unsigned>& classBank, unsigned bank) {
+    int numVRegs = static_cast<int>(regClass.size());
+    std::vector<unsigned> count(numVRegs, 0);
+    // Block position a VR was last counted in, so each block counts it once
+    std::vector<int> seenIn(numVRegs, -1);
+    auto note = [&](int v, int b) {
+        if (v >= numVRegs || seenIn[v] == b || classBank[regClass[v]] != bank) return;
+        seenIn[v] = b;
+        ++count[v];
+    };
+
+    for (int b = 0; b < static_cast<int>(fn.blocks.size()); ++b) {
+        if (pressure.block[b] <= k) continue;
+        const BasicBlock& block = *fn.blocks[b];
+        for (const auto* sets : {&lr.liveinSet, &lr.liveoutSet}) {
+            if (auto it = sets->find(block.id); it != sets->end()) {
+                for (int v : it->second) note(v, b);
+            }
+        }
+        for (const auto& instr : block.instructions) {
+            if (instr.def.has_value()) note(instr.def->id, b);
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use)) note(reg->id, b);
+            }
+        }
+    }
+    return count;
+}
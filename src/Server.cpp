@@ -0,0 +1,261 @@
+/**
+    Server.cpp runs one thread per connection that only reads frames
+    and submits them to the pool. Whichever task finishes the next
+    response in sequence writes it, followed by any later responses
+    that were already waiting, so a slow request delays the replies
+    behind it on its own connection but never blocks a worker.
+*/
+
+#include "Server.h"
+#include "Arena.h"
+#include "Reader.h"
+#include "Writer.h"
+
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define ION_HAVE_UNIX_SOCKETS 1
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+struct Server::Connection {
+    int fd = -1;
+    std::thread thread;
+    std::atomic<bool> finished{false};
+    ThreadPool::TaskGroup group;
+
+    std::mutex writeMutex;
+    uint64_t nextToSend = 0;
+    std::map<uint64_t, std::string> waiting;    // complete frames that are ahead of their turn
+    bool broken = false;
+};
+
+#ifdef ION_HAVE_UNIX_SOCKETS
+
+namespace {
+
+bool readExact(int fd, char* data, size_t n) {
+    while (n > 0) {
+        ssize_t got = ::recv(fd, data, n, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        n -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool sendAll(int fd, std::string_view head, std::string_view body) {
+    while (!head.empty() || !body.empty()) {
+        iovec iov[2] = {{const_cast<char*>(head.data()), head.size()},
+                        {const_cast<char*>(body.data()), body.size()}};
+        msghdr msg{};
+        msg.msg_iov = head.empty() ? iov + 1 : iov;
+        msg.msg_iovlen = head.empty() ? 1 : 2;
+        ssize_t sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        size_t n = static_cast<size_t>(sent);
+        size_t fromHead = std::min(n, head.size());
+        head.remove_prefix(fromHead);
+        body.remove_prefix(n - fromHead);
+    }
+    return true;
+}
+
+/* u32 length (status byte included) followed by the status */
+std::string frameHeader(uint8_t status, size_t payload) {
+    uint32_t length = static_cast<uint32_t>(payload + 1);
+    std::string header(5, '\0');
+    for (int i = 0; i < 4; ++i)
+        header[i] = static_cast<char>(length >> (8 * i) & 0xff);
+    header[4] = static_cast<char>(status);
+    return header;
+}
+
+}   // namespace
+
+Server::Server(std::string path, PipelineOptions options, unsigned workers)
+    : socketPath(std::move(path)), opts(std::move(options)), pool(workers) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("socket path too long: " + socketPath);
+    std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    if (::pipe(wakeFds) != 0) throw std::runtime_error("could not create wake-up pipe");
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) throw std::runtime_error("could not create socket");
+    ::unlink(socketPath.c_str());
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listenFd, 128) != 0) {
+        std::string err = std::strerror(errno);
+        ::close(listenFd);
+        ::close(wakeFds[0]);
+        ::close(wakeFds[1]);
+        throw std::runtime_error("could not listen on " + socketPath + ": " + err);
+    }
+}
+
+Server::~Server() {
+    for (Connection& conn : connections) {
+        ::shutdown(conn.fd, SHUT_RDWR);
+        if (conn.thread.joinable()) conn.thread.join();
+        ::close(conn.fd);
+    }
+    ::close(listenFd);
+    ::close(wakeFds[0]);
+    ::close(wakeFds[1]);
+    ::unlink(socketPath.c_str());
+}
+
+void Server::stop() {
+    char byte = 1;
+    [[maybe_unused]] ssize_t n = ::write(wakeFds[1], &byte, 1);
+}
+
+void Server::run() {
+    while (true) {
+        pollfd fds[2] = {{listenFd, POLLIN, 0}, {wakeFds[0], POLLIN, 0}};
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("poll failed");
+        }
+        if (fds[1].revents) break;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        // Reap connections whose client has gone
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (!it->finished.load(std::memory_order_acquire)) { ++it; continue; }
+            it->thread.join();
+            ::close(it->fd);
+            it = connections.erase(it);
+        }
+        Connection& conn = connections.emplace_back();
+        conn.fd = fd;
+        conn.thread = std::thread([this, &conn] { serve(conn); });
+    }
+
+    // Unblock every reader; each then drains its in-flight requests
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    for (Connection& conn : connections)
+        ::shutdown(conn.fd, SHUT_RD);
+    for (Connection& conn : connections) {
+        if (conn.thread.joinable()) conn.thread.join();
+    }
+}
+
+void Server::serve(Connection& conn) {
+    uint64_t seq = 0;
+    while (true) {
+        char header[4];
+        if (!readExact(conn.fd, header, sizeof(header))) break;
+        uint32_t length = 0;
+        for (int i = 0; i < 4; ++i)
+            length |= static_cast<uint32_t>(static_cast<uint8_t>(header[i])) << (8 * i);
+        if (length > kMaxFrameSize) break;
+
+        std::string request = acquireBuffer();
+        request.resize(length);
+        if (!readExact(conn.fd, request.data(), length)) break;
+        pool.submit(conn.group, [this, &conn, seq, request = std::move(request)]() mutable {
+            handle(conn, seq, std::move(request));
+        });
+        ++seq;
+    }
+    pool.wait(conn.group);
+    conn.finished.store(true, std::memory_order_release);
+}
+
+void Server::handle(Connection& conn, uint64_t seq, std::string request) {
+    // Reused by every request this worker serves
+    thread_local PipelineResult scratch;
+    thread_local std::string error;
+
+    uint8_t status = 0;
+    try {
+        ArenaScope arena;
+        Reader reader(arena.resource());
+        reader.parallelParse(&pool);
+        bool binary = std::string_view(request).substr(0, sizeof(kBinaryMagic)) ==
+                      std::string_view(kBinaryMagic, sizeof(kBinaryMagic));
+        Function fn = binary ? reader.BuildCFGFromBinary(request, "request")
+                             : reader.BuildCFGFromSource(request, "request");
+        PipelineOptions requestOpts{.target = opts.target,
+                                    .format = binary ? Writer::Format::Binary : Writer::Format::Text,
+                                    .cleanup = opts.cleanup,
+                                    .speculativeSpills = opts.speculativeSpills,
+                                    .verify = opts.verify,
+                                    .execute = opts.execute,
+                                    .cache = opts.cache,
+                                    // Requests already keep the workers busy; only parsing uses the pool
+                                    .pool = nullptr,
+                                    .beforeAllocation = {},
+                                    .afterAllocation = {}};
+        runPipeline(fn, requestOpts, scratch);
+    } catch (const std::exception& e) {
+        status = 1;
+        error = e.what();
+    }
+    releaseBuffer(std::move(request));
+    std::string_view payload = status == 0 ? std::string_view(scratch.output) : std::string_view(error);
+
+    std::lock_guard<std::mutex> lock(conn.writeMutex);
+    if (seq != conn.nextToSend) {
+        conn.waiting.emplace(seq, frameHeader(status, payload.size()).append(payload));
+        return;
+    }
+    if (!conn.broken) conn.broken = !sendAll(conn.fd, frameHeader(status, payload.size()), payload);
+    ++conn.nextToSend;
+    for (auto it = conn.waiting.begin(); it != conn.waiting.end() && it->first == conn.nextToSend;) {
+        if (!conn.broken) conn.broken = !sendAll(conn.fd, it->second, {});
+        ++conn.nextToSend;
+        it = conn.waiting.erase(it);
+    }
+}
+
+#else
+
+Server::Server(std::string path, PipelineOptions options, unsigned workers)
+    : socketPath(std::move(path)), opts(std::move(options)), pool(workers) {
+    throw std::runtime_error("--serve needs Unix domain sockets");
+}
+Server::~Server() = default;
+void Server::stop() {}
+void Server::run() {}
+void Server::serve(Connection&) {}
+void Server::handle(Connection&, uint64_t, std::string) {}
+
+#endif
+
+std::string Server::acquireBuffer() {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    if (buffers.empty()) return {};
+    std::string buffer = std::move(buffers.back());
+    buffers.pop_back();
+    return buffer;
+}
+
+void Server::releaseBuffer(std::string buffer) {
+    // Keep a bounded number of buffers, and none that a huge request blew up
+    constexpr size_t kMaxPooled = 64;
+    constexpr size_t kMaxPooledCapacity = 4u << 20;
+    if (buffer.capacity() > kMaxPooledCapacity) return;
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    if (buffers.size() < kMaxPooled) buffers.push_back(std::move(buffer));
+}
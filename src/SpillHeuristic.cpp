@@ -0,0 +1,189 @@
+/**
+    SpillHeuristic.cpp: the per-VR quantities the spill metrics are made
+    of. Loop nests are found as nested strongly connected components,
+    with an iterative Tarjan so that deep CFGs do not exhaust the stack.
+*/
+
+#include "SpillHeuristic.h"
+#include "SparseSet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory_resource>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+using Adjacency = std::vector<std::vector<int>>;
+
+/**
+    Appends to out the strongly connected components of the subgraph of
+    the blocks whose region is `region`. index, low and onStack are
+    indexed by block position and must be -1, -1 and 0 for those blocks.
+*/
+void components(const Adjacency& succ, const std::vector<int>& nodes, const std::vector<int>& regionOf,
+                int region, std::vector<int>& index, std::vector<int>& low, std::vector<uint8_t>& onStack,
+                std::vector<std::vector<int>>& out) {
+    int counter = 0;
+    std::vector<int> stack;
+    std::vector<std::pair<int, size_t>> calls;
+    for (int root : nodes) {
+        if (index[root] >= 0) continue;
+        index[root] = low[root] = counter++;
+        stack.push_back(root);
+        onStack[root] = 1;
+        calls.push_back({root, 0});
+        while (!calls.empty()) {
+            auto& [b, next] = calls.back();
+            if (next < succ[b].size()) {
+                int s = succ[b][next++];
+                if (regionOf[s] != region) continue;
+                if (index[s] < 0) {
+                    index[s] = low[s] = counter++;
+                    stack.push_back(s);
+                    onStack[s] = 1;
+                    calls.push_back({s, 0});
+                } else if (onStack[s]) {
+                    low[b] = std::min(low[b], index[s]);
+                }
+                continue;
+            }
+
+            int done = b;
+            calls.pop_back();
+            if (!calls.empty()) low[calls.back().first] = std::min(low[calls.back().first], low[done]);
+            if (low[done] != index[done]) continue;
+            std::vector<int>& scc = out.emplace_back();
+            int m;
+            do {
+                m = stack.back();
+                stack.pop_back();
+                onStack[m] = 0;
+                scc.push_back(m);
+            } while (m != done);
+        }
+    }
+}
+
+}   // namespace
+
+std::vector<unsigned> loopDepths(const Function& fn) {
+    int N = static_cast<int>(fn.blocks.size());
+    std::unordered_map<const BasicBlock*, int> position;
+    for (int i = 0; i < N; ++i)
+        position[fn.blocks[i].get()] = i;
+    Adjacency succ(N);
+    Adjacency pred(N);
+    for (int b = 0; b < N; ++b) {
+        for (const BasicBlock* s : fn.blocks[b]->successors) {
+            int t = position.at(s);
+            succ[b].push_back(t);
+            pred[t].push_back(b);
+        }
+    }
+
+    std::vector<unsigned> depth(N, 0);
+    // Blocks of the region being split into loops share a number; a header taken out of its loop gets -1
+    std::vector<int> regionOf(N, 0);
+    std::vector<int> index(N, -1);
+    std::vector<int> low(N, -1);
+    std::vector<uint8_t> onStack(N, 0);
+    std::vector<std::vector<int>> regions;
+    regions.emplace_back(N);
+    for (int b = 0; b < N; ++b) regions[0][b] = b;
+    int nextRegion = 1;
+
+    while (!regions.empty()) {
+        std::vector<int> nodes = std::move(regions.back());
+        regions.pop_back();
+        int region = regionOf[nodes[0]];
+        std::vector<std::vector<int>> sccs;
+        components(succ, nodes, regionOf, region, index, low, onStack, sccs);
+
+        for (auto& scc : sccs) {
+            int b = scc[0];
+            bool cyclic = scc.size() > 1 || std::find(succ[b].begin(), succ[b].end(), b) != succ[b].end();
+            if (!cyclic) continue;
+            int loop = nextRegion++;
+            for (int m : scc) {
+                ++depth[m];
+                regionOf[m] = loop;
+                index[m] = low[m] = -1;
+            }
+
+            // The header is entered from outside the loop; the lowest such block if there are several
+            std::sort(scc.begin(), scc.end());
+            auto entered = [&](int m) {
+                return std::any_of(pred[m].begin(), pred[m].end(), [&](int p) { return regionOf[p] != loop; });
+            };
+            auto header = std::find_if(scc.begin(), scc.end(), entered);
+            if (header == scc.end()) header = scc.begin();
+            regionOf[*header] = -1;
+            scc.erase(header);
+            if (!scc.empty()) regions.push_back(std::move(scc));
+        }
+    }
+    return depth;
+}
+
+std::vector<float> blockWeights(const std::vector<unsigned>& depths) {
+    std::vector<float> weight(depths.size());
+    for (size_t b = 0; b < depths.size(); ++b)
+        weight[b] = std::pow(10.0f, static_cast<float>(std::min(depths[b], kMaxWeightedLoopDepth)));
+    return weight;
+}
+
+std::vector<float> weightedOccurrences(const Function& fn, const std::vector<float>& weight, size_t numVRegs) {
+    std::vector<float> cost(numVRegs, 0.0f);
+    for (size_t b = 0; b < fn.blocks.size(); ++b) {
+        for (const auto& instr : fn.blocks[b]->instructions) {
+            if (instr.def.has_value()) cost[instr.def->id] += weight[b];
+            for (const auto& use : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&use)) cost[reg->id] += weight[b];
+            }
+        }
+    }
+    return cost;
+}
+
+std::vector<float> liveArea(const Function& fn, const LivenessResult& lr, const std::vector<float>& weight,
+                            size_t numVRegs) {
+    std::vector<float> area(numVRegs, 0.0f);
+    // Instruction, counted from the bottom of the block, from which a live VR has been live
+    std::vector<size_t> since(numVRegs, 0);
+    std::pmr::monotonic_buffer_resource scratch;
+    SparseSet live(numVRegs, &scratch);
+
+    for (size_t b = 0; b < fn.blocks.size(); ++b) {
+        const BasicBlock& block = *fn.blocks[b];
+        live.clear();
+        if (auto it = lr.liveoutSet.find(block.id); it != lr.liveoutSet.end()) {
+            for (int v : it->second) {
+                if (static_cast<size_t>(v) >= numVRegs) continue;
+                live.insert(v);
+                since[v] = 0;
+            }
+        }
+
+        size_t p = 0;
+        for (auto it = block.instructions.rbegin(); it != block.instructions.rend(); ++it, ++p) {
+            const Instruction& instr = *it;
+            if (instr.def.has_value()) {
+                int d = instr.def->id;
+                // A def nothing reads still holds its register at its own instruction
+                area[d] += weight[b] * static_cast<float>(live.contains(d) ? p - since[d] + 1 : 1);
+                live.erase(d);
+            }
+            for (const auto& use : instr.operands) {
+                auto* reg = std::get_if<VReg>(&use);
+                if (!reg || live.contains(reg->id)) continue;
+                live.insert(reg->id);
+                since[reg->id] = p;
+            }
+        }
+        for (int v : live)
+            area[v] += weight[b] * static_cast<float>(p - since[v]);
+    }
+    return area;
+}
@@ -0,0 +1,99 @@
+/**
+    Stats.cpp holds the totals behind `ion --stats` and formats them.
+    Timers and counters only ever add, so every field is a relaxed
+    atomic and the bank tasks of the allocator can report without a lock.
+*/
+
+#include "Stats.h"
+
+#include <iomanip>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+/* Peak resident set size of the process in bytes, 0 where it cannot be queried */
+uint64_t peakResidentBytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+double millis(uint64_t nanos) { return static_cast<double>(nanos) / 1e6; }
+
+}   // namespace
+
+Stats::Stats() : start(std::chrono::steady_clock::now()) {}
+
+void Stats::record(Phase p, uint64_t nanos, uint64_t allocations) {
+    PhaseTotals& t = phases[index(p)];
+    t.nanos.fetch_add(nanos, std::memory_order_relaxed);
+    t.calls.fetch_add(1, std::memory_order_relaxed);
+    t.allocations.fetch_add(allocations, std::memory_order_relaxed);
+    samplePeakMemory();
+}
+
+void Stats::samplePeakMemory() {
+    uint64_t bytes = peakResidentBytes();
+    uint64_t seen = peakBytes.load(std::memory_order_relaxed);
+    while (bytes > seen && !peakBytes.compare_exchange_weak(seen, bytes, std::memory_order_relaxed)) {}
+}
+
+void Stats::writeText(std::ostream& os) const {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    uint64_t total = static_cast<uint64_t>(std::chrono::nanoseconds(elapsed).count());
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+
+    os << "[STATS] " << std::left << std::setw(24) << "phase" << std::right << std::setw(8) << "calls"
+       << std::setw(12) << "ms" << std::setw(12) << "allocs" << "\n";
+    for (size_t p = 0; p < phases.size(); ++p) {
+        const PhaseTotals& t = phases[p];
+        if (t.calls.load(std::memory_order_relaxed) == 0) continue;
+        os << "[STATS] " << std::left << std::setw(24) << kPhaseNames[p] << std::right << std::setw(8)
+           << t.calls.load(std::memory_order_relaxed) << std::setw(12) << std::fixed << std::setprecision(3)
+           << millis(t.nanos.load(std::memory_order_relaxed)) << std::setw(12)
+           << t.allocations.load(std::memory_order_relaxed) << "\n";
+    }
+    os << "[STATS] " << std::left << std::setw(24) << "total" << std::right << std::setw(20) << millis(total)
+       << "\n";
+    for (size_t c = 0; c < counters.size(); ++c) {
+        os << "[STATS] " << std::left << std::setw(24) << kCounterNames[c] << std::right << std::setw(8)
+           << counters[c].load(std::memory_order_relaxed) << "\n";
+    }
+    os << "[STATS] " << std::left << std::setw(24) << "peak_memory_kib" << std::right << std::setw(8)
+       << peakMemory() / 1024 << "\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void Stats::writeJSON(std::ostream& os) const {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    os << "{\n  \"total_ns\": " << std::chrono::nanoseconds(elapsed).count() << ",\n  \"phases\": {";
+    bool first = true;
+    for (size_t p = 0; p < phases.size(); ++p) {
+        const PhaseTotals& t = phases[p];
+        if (t.calls.load(std::memory_order_relaxed) == 0) continue;
+        os << (first ? "\n" : ",\n") << "    \"" << kPhaseNames[p]
+           << "\": {\"calls\": " << t.calls.load(std::memory_order_relaxed)
+           << ", \"ns\": " << t.nanos.load(std::memory_order_relaxed)
+           << ", \"allocations\": " << t.allocations.load(std::memory_order_relaxed) << "}";
+        first = false;
+    }
+    os << "\n  },\n  \"counters\": {";
+    for (size_t c = 0; c < counters.size(); ++c) {
+        os << (c ? ",\n" : "\n") << "    \"" << kCounterNames[c]
+           << "\": " << counters[c].load(std::memory_order_relaxed);
+    }
+    os << "\n  },\n  \"peak_memory_bytes\": " << peakMemory() << "\n}\n";
+}
@@ -0,0 +1,168 @@
+/**
+    Target.cpp looks up the preset targets and reads target config
+    files. The config is line based, one directive per line, with
+    whitespace separated fields; see Target.h for the grammar.
+*/
+
+#include "Target.h"
+
+#include <charconv>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+const TargetDesc* findTarget(std::string_view name) {
+    for (const TargetDesc* t : targets::presets) {
+        if (t->name == name)
+            return t;
+    }
+    return nullptr;
+}
+
+namespace {
+
+[[noreturn]] void configError(size_t lineNo, const std::string& msg) {
+    throw std::runtime_error("target config line " + std::to_string(lineNo) + ": " + msg);
+}
+
+unsigned parseUnsigned(std::string_view tok, size_t lineNo) {
+    unsigned val = 0;
+    auto [ptr, ec] = std::from_chars(tok.data(), tok.data() + tok.size(), val);
+    if (ec != std::errc() || ptr != tok.data() + tok.size())
+        configError(lineNo, "expected a number, got '" + std::string(tok) + "'");
+    return val;
+}
+
+/* "<first>-<last>" or "<n>" */
+std::pair<unsigned, unsigned> parseRange(std::string_view tok, size_t lineNo) {
+    size_t dash = tok.find('-');
+    if (dash == std::string_view::npos) {
+        unsigned n = parseUnsigned(tok, lineNo);
+        return {n, n};
+    }
+    unsigned first = parseUnsigned(tok.substr(0, dash), lineNo);
+    unsigned last = parseUnsigned(tok.substr(dash + 1), lineNo);
+    if (last < first) configError(lineNo, "empty range '" + std::string(tok) + "'");
+    return {first, last};
+}
+
+/* "0-7,12" -> bitmask */
+uint64_t parseRegSet(std::string_view tok, unsigned numRegs, size_t lineNo) {
+    uint64_t mask = 0;
+    while (!tok.empty()) {
+        size_t comma = tok.find(',');
+        auto [first, last] = parseRange(tok.substr(0, comma), lineNo);
+        if (last >= numRegs) configError(lineNo, "register index out of range");
+        for (unsigned r = first; r <= last; ++r)
+            mask |= uint64_t{1} << r;
+        tok = comma == std::string_view::npos ? std::string_view{} : tok.substr(comma + 1);
+    }
+    return mask;
+}
+
+std::vector<std::string_view> splitFields(std::string_view line) {
+    std::vector<std::string_view> fields;
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')) ++i;
+        if (i >= line.size() || line[i] == '#') break;
+        size_t start = i;
+        while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r') ++i;
+        fields.push_back(line.substr(start, i - start));
+    }
+    return fields;
+}
+
+}   // namespace
+
+std::unique_ptr<TargetConfig> parseTarget(std::string source) {
+    auto cfg = std::make_unique<TargetConfig>();
+    cfg->source = std::move(source);
+    TargetDesc& desc = cfg->desc;
+    // Views below point into cfg->source, which stays put from here on
+    std::string_view text = cfg->source;
+
+    size_t lineNo = 0;
+    while (!text.empty()) {
+        ++lineNo;
+        size_t nl = text.find('\n');
+        std::string_view line = text.substr(0, nl);
+        text = nl == std::string_view::npos ? std::string_view{} : text.substr(nl + 1);
+
+        std::vector<std::string_view> f = splitFields(line);
+        if (f.empty()) continue;
+
+        if (f[0] == "target") {
+            if (f.size() != 2) configError(lineNo, "usage: target <name>");
+            desc.name = f[1];
+        }
+        else if (f[0] == "class") {
+            if (f.size() < 4 || f.size() % 2 != 0)
+                configError(lineNo, "usage: class <name> <prefix> <numRegs> [bank <n>] [caller <set>] [reserved <set>]");
+            if (desc.numClasses == kMaxRegClasses) configError(lineNo, "too many register classes");
+            if (desc.findClass(f[1]) >= 0) configError(lineNo, "duplicate class '" + std::string(f[1]) + "'");
+
+            RegClass rc{.name = f[1], .prefix = f[2], .numRegs = parseUnsigned(f[3], lineNo)};
+            if (rc.numRegs == 0 || rc.numRegs > kMaxRegsPerClass)
+                configError(lineNo, "a class must have between 1 and 64 registers");
+            for (size_t i = 4; i < f.size(); i += 2) {
+                if (f[i] == "bank") rc.bank = parseUnsigned(f[i + 1], lineNo);
+                else if (f[i] == "caller") rc.callerSaved = parseRegSet(f[i + 1], rc.numRegs, lineNo);
+                else if (f[i] == "reserved") rc.reserved = parseRegSet(f[i + 1], rc.numRegs, lineNo);
+                else configError(lineNo, "unknown class attribute '" + std::string(f[i]) + "'");
+            }
+            if (rc.bank >= kMaxRegClasses) configError(lineNo, "bank index out of range");
+            desc.classes[desc.numClasses++] = rc;
+        }
+        else if (f[0] == "alias") {
+            if (f.size() != 4) configError(lineNo, "usage: alias <name> <class> <index>");
+            if (desc.numAliases == kMaxRegAliases) configError(lineNo, "too many aliases");
+            int cls = desc.findClass(f[2]);
+            if (cls < 0) configError(lineNo, "unknown class '" + std::string(f[2]) + "'");
+            unsigned reg = parseUnsigned(f[3], lineNo);
+            if (reg >= desc.classes[cls].numRegs) configError(lineNo, "register index out of range");
+            desc.aliases[desc.numAliases++] = RegAlias{
+                .name = f[1], .regClass = static_cast<uint8_t>(cls), .reg = static_cast<uint8_t>(reg)};
+        }
+        else if (f[0] == "vregs") {
+            if (f.size() != 3) configError(lineNo, "usage: vregs <class> <first>-<last>");
+            if (desc.numVRegRanges == kMaxVRegRanges) configError(lineNo, "too many vreg ranges");
+            int cls = desc.findClass(f[1]);
+            if (cls < 0) configError(lineNo, "unknown class '" + std::string(f[1]) + "'");
+            auto [first, last] = parseRange(f[2], lineNo);
+            if (last > static_cast<unsigned>(std::numeric_limits<int>::max()))
+                configError(lineNo, "vreg index out of range '" + std::string(f[2]) + "'");
+            desc.vregRanges[desc.numVRegRanges++] = VRegRange{
+                .first = static_cast<int>(first), .last = static_cast<int>(last),
+                .regClass = static_cast<uint8_t>(cls)};
+        }
+        else {
+            configError(lineNo, "unknown directive '" + std::string(f[0]) + "'");
+        }
+    }
+
+    if (desc.numClasses == 0)
+        throw std::runtime_error("target config declares no register classes");
+    for (unsigned i = 0; i < desc.numClasses; ++i) {
+        const RegClass& rc = desc.classes[i];
+        if (rc.numRegs != desc.bankRegs(rc.bank))
+            throw std::runtime_error("classes sharing bank " + std::to_string(rc.bank) +
+                                     " must have the same number of registers");
+    }
+    for (unsigned b = 0; b < desc.numBanks(); ++b) {
+        if (desc.bankRegs(b) != 0 && desc.allocatable(b) == 0)
+            throw std::runtime_error("bank " + std::to_string(b) + " has no allocatable registers");
+    }
+    return cfg;
+}
+
+std::unique_ptr<TargetConfig> loadTarget(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("could not open target config " + filename);
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    return parseTarget(ss.str());
+}
@@ -0,0 +1,126 @@
+/**
+    ThreadPool.cpp implements the deques and the stealing loop. Each
+    deque has its own mutex, which only a thief ever contends for; the
+    shared state is two counters and the condition variable idle
+    threads sleep on.
+*/
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+
+// The pool the calling thread works for and its index in it
+thread_local const ThreadPool* tPool = nullptr;
+thread_local unsigned tIndex = 0;
+
+}   // namespace
+
+ThreadPool::ThreadPool(unsigned numWorkers) {
+    if (numWorkers == 0) numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < numWorkers; ++i)
+        workers.push_back(std::make_unique<Worker>());
+    for (unsigned i = 0; i < numWorkers; ++i)
+        threads.emplace_back([this, i] { run(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+void ThreadPool::submit(TaskGroup& group, std::function<void()> task) {
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+
+    // A worker keeps its own subtasks; other threads spread theirs round-robin
+    unsigned q = tPool == this ? tIndex : nextQueue.fetch_add(1, std::memory_order_relaxed) % size();
+    {
+        std::lock_guard<std::mutex> lock(workers[q]->mutex);
+        workers[q]->tasks.push_back(Task{&group, std::move(task)});
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+bool ThreadPool::tryRunOne(unsigned self) {
+    Task task;
+    bool found = false;
+    bool isWorker = tPool == this;
+
+    if (isWorker) {
+        Worker& own = *workers[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (unsigned i = isWorker ? 1 : 0; !found && i < size(); ++i) {
+        Worker& victim = *workers[(self + i) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    execute(task);
+    return true;
+}
+
+void ThreadPool::execute(Task& task) {
+    TaskGroup& group = *task.group;
+    try {
+        task.fn();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(group.errorMutex);
+        if (!group.error) group.error = std::current_exception();
+    }
+    // The group may be destroyed as soon as its count drops to zero; touch only the pool after it
+    if (group.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_all();
+    }
+}
+
+void ThreadPool::run(unsigned index) {
+    tPool = this;
+    tIndex = index;
+    while (true) {
+        if (tryRunOne(index)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+        if (stopping && queued.load(std::memory_order_acquire) == 0) return;
+    }
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+    unsigned self = tPool == this ? tIndex : 0;
+    while (group.pending.load(std::memory_order_acquire) != 0) {
+        if (tryRunOne(self)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&] {
+            return group.pending.load(std::memory_order_acquire) == 0 ||
+                   queued.load(std::memory_order_acquire) > 0;
+        });
+    }
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(group.errorMutex);
+        std::swap(error, group.error);
+    }
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,125 @@
+/**
+    Trace.cpp implements the per-thread buffers of TraceRecorder and
+    the trace-event JSON writer. A thread finds its buffer through a
+    thread-local cache tagged with the recorder's generation, so a
+    recorder created at the address of an earlier one never picks up a
+    stale buffer.
+*/
+
+#include "Trace.h"
+
+#include <cstdio>
+
+namespace {
+
+std::atomic<uint64_t> gGeneration{0};
+
+struct BufferCache {
+    uint64_t generation = 0;
+    void* buffer = nullptr;
+};
+thread_local BufferCache tCache;
+thread_local std::string_view tFunction;
+
+void writeEscaped(std::ostream& os, std::string_view s) {
+    for (char c : s) {
+        switch (c) {
+            case '"':  os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            case '\t': os << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    os << buf;
+                } else {
+                    os << c;
+                }
+        }
+    }
+}
+
+/* Trace timestamps are microseconds; keep nanosecond resolution as the fraction */
+void writeMicros(std::ostream& os, uint64_t nanos) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%llu.%03u", static_cast<unsigned long long>(nanos / 1000),
+                  static_cast<unsigned>(nanos % 1000));
+    os << buf;
+}
+
+}   // namespace
+
+TraceRecorder::TraceRecorder()
+    : generation(gGeneration.fetch_add(1, std::memory_order_relaxed) + 1),
+      origin(std::chrono::steady_clock::now()) {}
+
+TraceRecorder::~TraceRecorder() {
+    ThreadBuffer* buffer = head.load(std::memory_order_acquire);
+    while (buffer) {
+        ThreadBuffer* next = buffer->next;
+        delete buffer;
+        buffer = next;
+    }
+}
+
+uint64_t TraceRecorder::now() const {
+    return static_cast<uint64_t>(std::chrono::nanoseconds(std::chrono::steady_clock::now() - origin).count());
+}
+
+TraceRecorder::ThreadBuffer& TraceRecorder::local() {
+    if (tCache.generation == generation) return *static_cast<ThreadBuffer*>(tCache.buffer);
+
+    auto* buffer = new ThreadBuffer{.tid = nextTid.fetch_add(1, std::memory_order_relaxed),
+                                    .events = {},
+                                    .next = head.load(std::memory_order_relaxed)};
+    buffer->events.reserve(256);
+    while (!head.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed)) {}
+    tCache = {generation, buffer};
+    return *buffer;
+}
+
+void TraceRecorder::complete(const char* name, std::string_view function, uint64_t start, uint64_t end,
+                             int64_t round) {
+    local().events.push_back(Event{name, std::string(function), start, end - start, round});
+}
+
+size_t TraceRecorder::numEvents() const {
+    size_t n = 0;
+    for (ThreadBuffer* b = head.load(std::memory_order_acquire); b; b = b->next)
+        n += b->events.size();
+    return n;
+}
+
+void TraceRecorder::writeJSON(std::ostream& os) const {
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+       << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"ion\"}}";
+
+    for (ThreadBuffer* b = head.load(std::memory_order_acquire); b; b = b->next) {
+        os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid
+           << ",\"args\":{\"name\":\"worker " << b->tid << "\"}}";
+        for (const Event& e : b->events) {
+            os << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"ion\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+               << ",\"ts\":";
+            writeMicros(os, e.start);
+            os << ",\"dur\":";
+            writeMicros(os, e.duration);
+            os << ",\"args\":{\"function\":\"";
+            writeEscaped(os, e.function);
+            os << '"';
+            if (e.round >= 0) os << ",\"round\":" << e.round;
+            os << "}}";
+        }
+    }
+    os << "\n]}\n";
+}
+
+namespace trace {
+
+std::string_view currentFunction() { return tFunction; }
+
+FunctionScope::FunctionScope(std::string_view function) : previous(tFunction) { tFunction = function; }
+
+FunctionScope::~FunctionScope() { tFunction = previous; }
+
+}   // namespace trace
@@ -0,0 +1,381 @@
+/**
+    Verifier.cpp: the dataflow behind verifyAllocation. Within a block
+    the state is dense, indexed both ways: by location, the origins whose
+    value it holds, and by origin, the locations holding it, so a def
+    drops a stale value in time proportional to its copies. Between
+    blocks it is a sorted list of (location, origin) pairs, which makes
+    the meet at a merge an intersection of sorted lists.
+*/
+
+#include "Verifier.h"
+#include "RegisterPressure.h"
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// A value sitting in a location; a block state lists them sorted, and a location with none holds no live value
+using Pair = std::pair<int, int>;
+using BlockState = std::vector<Pair>;
+
+class Verifier {
+public:
+    Verifier(const Function& fn, const Allocation& alloc, const TargetDesc& target, size_t maxErrors)
+        : fn(fn), alloc(alloc), target(target), maxErrors(maxErrors) {
+        int maxSlot = -1;
+        for (const auto& block : fn.blocks) {
+            for (const auto& instr : block->instructions) {
+                if (instr.spill) maxSlot = std::max(maxSlot, slotOf(instr));
+            }
+        }
+        numRegLocations = static_cast<int>(kMaxRegClasses * kMaxRegsPerClass);
+        int numLocations = numRegLocations + maxSlot + 1;
+        holds.resize(numLocations);
+        listed.assign(numLocations, 0);
+        size_t numOrigins = alloc.reg.size();
+        for (int o : alloc.origin) numOrigins = std::max(numOrigins, static_cast<size_t>(o) + 1);
+        at.resize(numOrigins);
+    }
+
+    std::vector<std::string> run();
+
+private:
+    static int slotOf(const Instruction& instr) {
+        return std::get<int>(instr.op == OpCode::LOAD ? instr.operands[0] : instr.operands[1]);
+    }
+    int origin(int v) const { return v < static_cast<int>(alloc.origin.size()) ? alloc.origin[v] : v; }
+    int regOf(int v) const { return v < static_cast<int>(alloc.reg.size()) ? alloc.reg[v] : -1; }
+    int location(int v) const {
+        return static_cast<int>(target.classes[alloc.regClass[v]].bank * kMaxRegsPerClass) + regOf(v);
+    }
+
+    void load(const BlockState& state);
+    // Copies the dense state into state, leaving it in place for a successor to carry on from
+    void save(BlockState& state);
+    void reset();
+    void write(int loc);
+    void add(int loc, int o);
+    void invalidate(int o);
+    void copy(int dst, int src);
+    bool holdsValue(int loc, int o) const {
+        return std::find(holds[loc].begin(), holds[loc].end(), o) != holds[loc].end();
+    }
+    /* Whether some path from the entry reaches instruction index of block b without defining origin o */
+    bool mayBeUndefined(int o, int b, size_t index);
+
+    /* Runs block b's instructions on the dense state, describing any bad use in errors */
+    void transfer(int b, std::vector<std::string>& errors);
+    void check(int b, size_t index, int v, int loc, std::vector<std::string>& errors);
+    std::string locationName(int loc) const;
+
+    const Function& fn;
+    const Allocation& alloc;
+    const TargetDesc& target;
+    size_t maxErrors;
+    int numRegLocations = 0;
+
+    std::unordered_map<const BasicBlock*, int> position;
+
+    std::vector<std::vector<int>> holds;    // location -> origins whose current value it holds
+    std::vector<uint8_t> listed;            // location -> in touched
+    std::vector<int> touched;               // locations that may hold a value, for save and reset
+    size_t loaded = 0;                      // touched[0, loaded) came from load, in order
+    std::vector<std::vector<int>> at;       // origin -> locations holding its current value
+
+    // Built on the first bad read, which a valid allocation only has for values undefined on some path
+    std::vector<std::vector<int>> defBlocks;                    // origin -> blocks defining it
+    std::unordered_map<int, std::vector<uint8_t>> undefinedIn;  // origin -> block -> may be undefined on entry
+};
+
+void Verifier::load(const BlockState& state) {
+    for (auto [loc, o] : state) add(loc, o);
+    loaded = touched.size();
+}
+
+void Verifier::save(BlockState& state) {
+    // Locations come in sorted from load; only those first written in the block need placing
+    std::sort(touched.begin() + static_cast<std::ptrdiff_t>(loaded), touched.end());
+    std::inplace_merge(touched.begin(), touched.begin() + static_cast<std::ptrdiff_t>(loaded), touched.end());
+    loaded = touched.size();
+    state.clear();
+    for (int loc : touched) {
+        std::vector<int>& h = holds[loc];
+        std::sort(h.begin(), h.end());
+        for (int o : h) state.push_back({loc, o});
+    }
+}
+
+void Verifier::reset() {
+    for (int loc : touched) {
+        for (int o : holds[loc]) at[o].clear();
+        holds[loc].clear();
+        listed[loc] = 0;
+    }
+    touched.clear();
+    loaded = 0;
+}
+
+void Verifier::write(int loc) {
+    for (int o : holds[loc]) std::erase(at[o], loc);
+    holds[loc].clear();
+}
+
+void Verifier::add(int loc, int o) {
+    if (!listed[loc]) {
+        listed[loc] = 1;
+        touched.push_back(loc);
+    }
+    holds[loc].push_back(o);
+    at[o].push_back(loc);
+}
+
+void Verifier::invalidate(int o) {
+    for (int loc : at[o]) std::erase(holds[loc], o);
+    at[o].clear();
+}
+
+void Verifier::copy(int dst, int src) {
+    if (dst == src) return;
+    write(dst);
+    for (int o : holds[src]) add(dst, o);
+}
+
+bool Verifier::mayBeUndefined(int o, int b, size_t index) {
+    if (defBlocks.empty()) {
+        defBlocks.resize(at.size());
+        for (size_t p = 0; p < fn.blocks.size(); ++p) {
+            for (const auto& instr : fn.blocks[p]->instructions) {
+                if (!instr.def.has_value() || instr.spill) continue;
+                std::vector<int>& blocks = defBlocks[origin(instr.def->id)];
+                if (blocks.empty() || blocks.back() != static_cast<int>(p)) blocks.push_back(static_cast<int>(p));
+            }
+        }
+    }
+
+    auto [it, inserted] = undefinedIn.try_emplace(o);
+    std::vector<uint8_t>& undefined = it->second;
+    if (inserted) {
+        // Forward from the entry, stopping at the blocks that define o
+        std::vector<uint8_t> defines(fn.blocks.size(), 0);
+        for (int p : defBlocks[o]) defines[p] = 1;
+        undefined.assign(fn.blocks.size(), 0);
+        std::vector<int> pending;
+        if (!fn.blocks.empty()) {
+            undefined[0] = 1;
+            pending.push_back(0);
+        }
+        while (!pending.empty()) {
+            int p = pending.back();
+            pending.pop_back();
+            if (defines[p]) continue;
+            for (const BasicBlock* s : fn.blocks[p]->successors) {
+                int t = position.at(s);
+                if (!undefined[t]) {
+                    undefined[t] = 1;
+                    pending.push_back(t);
+                }
+            }
+        }
+    }
+    if (!undefined[b]) return false;
+    const auto& code = fn.blocks[b]->instructions;
+    return std::none_of(code.begin(), code.begin() + static_cast<std::ptrdiff_t>(index), [&](const Instruction& instr) {
+        return instr.def.has_value() && !instr.spill && origin(instr.def->id) == o;
+    });
+}
+
+std::string Verifier::locationName(int loc) const {
+    if (loc >= numRegLocations) return "slot " + std::to_string(loc - numRegLocations);
+    unsigned bank = static_cast<unsigned>(loc) / kMaxRegsPerClass;
+    unsigned reg = static_cast<unsigned>(loc) % kMaxRegsPerClass;
+    for (unsigned c = 0; c < target.numClasses; ++c) {
+        if (target.classes[c].bank != bank) continue;
+        std::string_view alias = target.aliasOf(c, reg);
+        if (!alias.empty()) return std::string(alias);
+        return std::string(target.classes[c].prefix) + std::to_string(reg);
+    }
+    return "bank " + std::to_string(bank) + " register " + std::to_string(reg);
+}
+
+void Verifier::check(int b, size_t index, int v, int loc, std::vector<std::string>& errors) {
+    int o = origin(v);
+    if (errors.size() >= maxErrors || holdsValue(loc, o) || mayBeUndefined(o, b, index)) return;
+    std::string message = fn.name + ": " + fn.blocks[b]->label + "[" + std::to_string(index) + "]: %" +
+                          std::to_string(v);
+    if (o != v) message += " (of %" + std::to_string(o) + ")";
+    message += " reads " + locationName(loc) + ", which holds ";
+    if (holds[loc].empty()) {
+        message += "no live value";
+    } else {
+        for (size_t i = 0; i < holds[loc].size(); ++i)
+            message += (i == 0 ? "%" : ", %") + std::to_string(holds[loc][i]);
+    }
+    errors.push_back(std::move(message));
+}
+
+void Verifier::transfer(int b, std::vector<std::string>& errors) {
+    const BasicBlock& block = *fn.blocks[b];
+    for (size_t i = 0; i < block.instructions.size(); ++i) {
+        const Instruction& instr = block.instructions[i];
+        for (const auto& use : instr.operands) {
+            auto* reg = std::get_if<VReg>(&use);
+            if (!reg) continue;
+            if (regOf(reg->id) < 0) {
+                if (errors.size() < maxErrors)
+                    errors.push_back(fn.name + ": " + block.label + "[" + std::to_string(i) + "]: %" +
+                                      std::to_string(reg->id) + " has no register");
+                continue;
+            }
+            check(b, i, reg->id, location(reg->id), errors);
+        }
+
+        if (instr.spill && instr.op == OpCode::STORE) {
+            auto* src = std::get_if<VReg>(&instr.operands[0]);
+            if (src && regOf(src->id) >= 0) copy(numRegLocations + slotOf(instr), location(src->id));
+            continue;
+        }
+        if (!instr.def.has_value() || regOf(instr.def->id) < 0) continue;
+
+        int d = instr.def->id;
+        int o = origin(d);
+        int loc = location(d);
+        if (instr.spill) {
+            // A reload hands on whatever the slot holds; after a bad one, reported above, the register is
+            // taken to hold the value so that its uses are not reported again
+            int slot = numRegLocations + slotOf(instr);
+            check(b, i, d, slot, errors);
+            copy(loc, slot);
+            if (!holdsValue(loc, o)) add(loc, o);
+            continue;
+        }
+        auto* src = instr.op == OpCode::MOV ? std::get_if<VReg>(&instr.operands[0]) : nullptr;
+        if (src && regOf(src->id) >= 0) {
+            // d takes s's value: it stays current wherever s's value is, and if d already had it nothing changes
+            int from = location(src->id);
+            if (holdsValue(from, o)) {
+                copy(loc, from);
+                continue;
+            }
+            invalidate(o);
+            copy(loc, from);
+            add(loc, o);
+            continue;
+        }
+        invalidate(o);
+        write(loc);
+        add(loc, o);
+    }
+}
+
+/* The values both states have in the same location */
+BlockState meet(const BlockState& a, const BlockState& b) {
+    BlockState result;
+    result.reserve(std::min(a.size(), b.size()));
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+std::vector<std::string> Verifier::run() {
+    int N = static_cast<int>(fn.blocks.size());
+    for (int b = 0; b < N; ++b)
+        position[fn.blocks[b].get()] = b;
+    std::vector<std::vector<int>> preds(N);
+    for (int b = 0; b < N; ++b) {
+        for (const BasicBlock* s : fn.blocks[b]->successors) preds[position.at(s)].push_back(b);
+    }
+
+    // Blocks not reachable from the entry never run
+    std::vector<uint8_t> reachable(N, 0);
+    std::vector<int> pending;
+    if (N > 0) {
+        reachable[0] = 1;
+        pending.push_back(0);
+    }
+    while (!pending.empty()) {
+        int b = pending.back();
+        pending.pop_back();
+        for (const BasicBlock* s : fn.blocks[b]->successors) {
+            int t = position.at(s);
+            if (!reachable[t]) {
+                reachable[t] = 1;
+                pending.push_back(t);
+            }
+        }
+    }
+    std::vector<int> order;
+    for (int b : reversePostorder(fn)) {
+        if (reachable[b]) order.push_back(b);
+    }
+
+    std::vector<BlockState> out(N);
+    std::vector<uint8_t> visited(N, 0);
+    std::vector<uint8_t> dirty(N, 0);
+    if (N > 0) dirty[0] = 1;
+    BlockState merged;
+    auto inState = [&](int b) -> const BlockState& {
+        const BlockState* in = nullptr;
+        for (int p : preds[b]) {
+            if (!visited[p]) continue;
+            if (!in) {
+                in = &out[p];
+            } else {
+                merged = meet(*in, out[p]);
+                in = &merged;
+            }
+        }
+        if (!in) {
+            merged.clear();
+            in = &merged;
+        }
+        return *in;
+    };
+
+    // A block's last visit starts from its final in-state, since any change to that would visit it again,
+    // so the errors kept from each block's last visit are those of the fixed point
+    std::vector<std::vector<std::string>> blockErrors(N);
+    BlockState state;
+    int current = -1;       // block whose out-state the dense state holds
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int b : order) {
+            if (!dirty[b]) continue;
+            dirty[b] = 0;
+            // Down a chain the dense state is already the in-state
+            int single = -1;
+            for (int p : preds[b]) {
+                if (visited[p]) single = single == -1 ? p : -2;
+            }
+            if (single < 0 || single != current) {
+                reset();
+                load(inState(b));
+            }
+            blockErrors[b].clear();
+            transfer(b, blockErrors[b]);
+            save(state);
+            current = b;
+            if (visited[b] && state == out[b]) continue;
+            visited[b] = 1;
+            out[b].swap(state);
+            for (const BasicBlock* s : fn.blocks[b]->successors) dirty[position.at(s)] = 1;
+            changed = true;
+        }
+    }
+
+    std::vector<std::string> errors;
+    for (int b : order) {
+        for (auto& e : blockErrors[b]) {
+            if (errors.size() < maxErrors) errors.push_back(std::move(e));
+        }
+    }
+    return errors;
+}
+
+}   // namespace
+
+std::vector<std::string> verifyAllocation(const Function& fn, const Allocation& alloc, const TargetDesc& target,
+                                          size_t maxErrors) {
+    return Verifier(fn, alloc, target, maxErrors).run();
+}
@@ -0,0 +1,183 @@
+/**
+    Visualize.cpp writes the Graphviz dumps. Node labels are assembled
+    in one reused string per node and escaped on the way out; \l ends
+    each label line so instruction listings stay left-aligned.
+*/
+
+#include "Visualize.h"
+
+#include <charconv>
+#include <set>
+#include <string>
+
+namespace {
+
+// Graphviz X11 colour names that stay readable with black text
+constexpr const char* kPalette[] = {
+    "lightblue", "palegreen", "lightsalmon", "khaki", "plum", "lightcyan", "peachpuff", "thistle",
+    "lightpink", "aquamarine", "wheat", "lightsteelblue", "darkseagreen1", "lavender", "moccasin", "honeydew",
+};
+
+void appendInt(std::string& s, long long v) {
+    char buf[24];
+    s.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+}
+
+void appendReg(std::string& s, int v, const DotOptions& opts) {
+    int reg = opts.allocation && v < static_cast<int>(opts.allocation->reg.size()) ? opts.allocation->reg[v] : -1;
+    if (reg < 0 || !opts.target) {
+        s += '%';
+        appendInt(s, v);
+        return;
+    }
+    unsigned cls = opts.allocation->regClass[v];
+    std::string_view alias = opts.target->aliasOf(cls, static_cast<unsigned>(reg));
+    if (!alias.empty()) {
+        s.append(alias);
+        return;
+    }
+    s.append(opts.target->classes[cls].prefix);
+    appendInt(s, reg);
+}
+
+void appendInstruction(std::string& s, const Instruction& instr, const DotOptions& opts) {
+    s += "    ";
+    s.append(mnemonic(instr.op));
+    bool first = true;
+    auto separator = [&] {
+        s.append(first ? " " : ", ");
+        first = false;
+    };
+    if (instr.def.has_value()) {
+        separator();
+        appendReg(s, instr.def->id, opts);
+    }
+    for (const auto& operand : instr.operands) {
+        if (auto* reg = std::get_if<VReg>(&operand)) {
+            separator();
+            appendReg(s, reg->id, opts);
+        } else if (auto* imm = std::get_if<int>(&operand)) {
+            separator();
+            if (instr.spill) s.append("[slot");
+            appendInt(s, *imm);
+            if (instr.spill) s += ']';
+        }
+    }
+    for (const auto& label : instr.labels) {
+        if (!label.has_value()) continue;
+        separator();
+        s.append(*label);
+    }
+    s.append("\\l");
+}
+
+void appendSet(std::string& s, std::string_view name, const std::pmr::map<int, std::pmr::set<int>>& sets, int block,
+               const DotOptions& opts) {
+    s.append(name);
+    s += ':';
+    auto it = sets.find(block);
+    if (it != sets.end()) {
+        for (int v : it->second) {
+            s += ' ';
+            appendReg(s, v, opts);
+        }
+    }
+    s.append("\\l");
+}
+
+/* Writes s as a quoted DOT string; label escapes (\l) are already in place */
+void writeQuoted(std::ostream& os, const std::string& s) {
+    os << '"';
+    size_t from = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] != '"') continue;
+        os.write(s.data() + from, static_cast<std::streamsize>(i - from));
+        os << "\\\"";
+        from = i + 1;
+    }
+    os.write(s.data() + from, static_cast<std::streamsize>(s.size() - from));
+    os << '"';
+}
+
+void writeGraph(std::ostream& os, std::string_view name, const InterferenceGraph& graph, const DotOptions& opts) {
+    const Allocation* alloc = opts.target ? opts.allocation : nullptr;
+    os << "graph " << name << " {\n";
+    os << "    node [shape=circle, fontname=monospace" << (alloc ? ", style=filled" : "") << "];\n\n";
+
+    std::string label;
+    for (int v = 0; v < graph.numNodes(); ++v) {
+        if (!graph.isNode(v)) continue;
+        label.clear();
+        label += '%';
+        appendInt(label, v);
+        os << "    v" << v << " [label=";
+        int reg = alloc && v < static_cast<int>(alloc->reg.size()) ? alloc->reg[v] : -1;
+        if (reg >= 0) {
+            label.append("\\n");
+            appendReg(label, v, opts);
+            writeQuoted(os, label);
+            os << ", fillcolor=" << kPalette[static_cast<size_t>(reg) % std::size(kPalette)];
+        } else {
+            writeQuoted(os, label);
+            if (alloc) os << ", fillcolor=white, style=dashed";
+        }
+        os << "];\n";
+    }
+    os << '\n';
+
+    // Adjacency lists are symmetric; emit each edge from its lower end
+    for (int v = 0; v < graph.numNodes(); ++v) {
+        if (!graph.isNode(v)) continue;
+        for (int n : graph.neighbours(v)) {
+            if (n > v) os << "    v" << v << " -- v" << n << ";\n";
+        }
+    }
+    os << "}\n";
+}
+
+}   // namespace
+
+void writeCFGDot(std::ostream& os, const Function& fn, const DotOptions& opts) {
+    os << "digraph CFG {\n";
+    os << "    node [shape=box, fontname=monospace];\n\n";
+
+    std::string label;
+    for (const auto& block : fn.blocks) {
+        label.clear();
+        label.append(block->label);
+        if (opts.instructions || opts.liveness) {
+            label.append(":\\l");
+            if (opts.liveness) appendSet(label, "in", opts.liveness->liveinSet, block->id, opts);
+            if (opts.instructions) {
+                for (const Instruction& instr : block->instructions)
+                    appendInstruction(label, instr, opts);
+            }
+            if (opts.liveness) appendSet(label, "out", opts.liveness->liveoutSet, block->id, opts);
+        }
+        os << "    b" << block->id << " [label=";
+        writeQuoted(os, label);
+        os << "];\n";
+
+        for (const BasicBlock* succ : block->successors)
+            os << "    b" << block->id << " -> b" << succ->id << ";\n";
+    }
+    os << "}\n";
+}
+
+void writeInterferenceDot(std::ostream& os, const InterferenceGraph& graph, const DotOptions& opts) {
+    writeGraph(os, "Interference", graph, opts);
+}
+
+void writeColoringDot(std::ostream& os, Function& fn, const Allocation& alloc, const TargetDesc& target) {
+    LivenessResult lr = LivenessAnalysis().analyse(fn);
+    std::vector<unsigned> classBank(target.numClasses);
+    for (unsigned c = 0; c < target.numClasses; ++c)
+        classBank[c] = target.classes[c].bank;
+
+    DotOptions opts{.allocation = &alloc, .target = &target};
+    for (unsigned bank = 0; bank < target.numBanks(); ++bank) {
+        if (target.bankRegs(bank) == 0) continue;
+        InterferenceGraph graph = buildInterferenceGraph(fn, lr, alloc.regClass, classBank, bank);
+        writeGraph(os, "bank" + std::to_string(bank), graph, opts);
+    }
+}
@@ -0,0 +1,215 @@
+/**
+    Writer.cpp implements the text and binary emitters. Both walk the
+    blocks in order and write straight into the output buffer; the only
+    formatting helpers are std::to_chars for integers and a lookup of
+    the register name (alias or prefix + index) from the target.
+*/
+
+#include "Writer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Longest text an integer can take, sign included
+constexpr size_t kMaxIntChars = 20;
+
+/* A copy the coalescer made redundant: both sides got the same register */
+bool isRemovedCopy(const Instruction& instr, const Allocation& alloc, const TargetDesc& target) {
+    if (instr.op != OpCode::MOV || !instr.def.has_value()) return false;
+    const VReg* src = std::get_if<VReg>(&instr.operands[0]);
+    if (!src) return false;
+    int d = instr.def->id;
+    int s = src->id;
+    return alloc.reg[d] >= 0 && alloc.reg[d] == alloc.reg[s] &&
+           target.classes[alloc.regClass[d]].bank == target.classes[alloc.regClass[s]].bank;
+}
+
+}   // namespace
+
+Writer::Writer(std::FILE* out, Format format, size_t bufferSize)
+    : file(out), format(format), buffer(std::max(bufferSize, size_t{256})),
+      cur(buffer.data()), end(buffer.data() + buffer.size()) {}
+
+Writer::Writer(std::string& out, Format format, size_t bufferSize)
+    : str(&out), format(format), buffer(std::max(bufferSize, size_t{256})),
+      cur(buffer.data()), end(buffer.data() + buffer.size()) {}
+
+Writer::~Writer() {
+    // Callers that need to see write errors call flush() themselves
+    try {
+        flush();
+    } catch (const std::exception&) {
+    }
+}
+
+void Writer::flush() {
+    size_t n = static_cast<size_t>(cur - buffer.data());
+    if (n == 0) return;
+    if (file) {
+        if (std::fwrite(buffer.data(), 1, n, file) != n)
+            throw std::runtime_error("failed to write output");
+    } else {
+        str->append(buffer.data(), n);
+    }
+    cur = buffer.data();
+}
+
+void Writer::ensure(size_t n) {
+    if (static_cast<size_t>(end - cur) < n) flush();
+}
+
+void Writer::put(std::string_view s) {
+    if (s.size() > buffer.size()) {
+        // Too big to stage; hand it straight to the sink
+        flush();
+        if (!file) str->append(s);
+        else if (std::fwrite(s.data(), 1, s.size(), file) != s.size())
+            throw std::runtime_error("failed to write output");
+        return;
+    }
+    ensure(s.size());
+    std::memcpy(cur, s.data(), s.size());
+    cur += s.size();
+}
+
+void Writer::putInt(int64_t v) {
+    ensure(kMaxIntChars);
+    cur = std::to_chars(cur, end, v).ptr;
+}
+
+void Writer::putU32(uint32_t v) {
+    ensure(4);
+    for (int i = 0; i < 4; ++i)
+        *cur++ = static_cast<char>(v >> (8 * i) & 0xff);
+}
+
+void Writer::write(const Function& fn) {
+    if (format == Format::Text) writeText(fn, nullptr, nullptr);
+    else writeBinary(fn, nullptr, nullptr);
+}
+
+void Writer::write(const Function& fn, const Allocation& alloc, const TargetDesc& target) {
+    if (format == Format::Text) writeText(fn, &alloc, &target);
+    else writeBinary(fn, &alloc, &target);
+}
+
+void Writer::writeText(const Function& fn, const Allocation* alloc, const TargetDesc* target) {
+    auto putReg = [&](VReg v) {
+        int reg = alloc ? alloc->reg[v.id] : -1;
+        if (reg < 0) {
+            put('%');
+            putInt(v.id);
+            return;
+        }
+        unsigned cls = alloc->regClass[v.id];
+        std::string_view alias = target->aliasOf(cls, reg);
+        if (!alias.empty()) {
+            put(alias);
+            return;
+        }
+        put(target->classes[cls].prefix);
+        putInt(reg);
+    };
+
+    for (const auto& block : fn.blocks) {
+        put(block->label);
+        put(":\n");
+
+        for (const Instruction& instr : block->instructions) {
+            if (alloc && isRemovedCopy(instr, *alloc, *target)) continue;
+
+            put("    ");
+            put(mnemonic(instr.op));
+            bool first = true;
+            auto separator = [&] {
+                if (first) put(' ');
+                else put(", ");
+                first = false;
+            };
+
+            if (instr.def.has_value()) {
+                separator();
+                putReg(*instr.def);
+            }
+            for (const auto& operand : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&operand)) {
+                    separator();
+                    putReg(*reg);
+                } else if (auto* imm = std::get_if<int>(&operand)) {
+                    separator();
+                    if (instr.spill) put("[slot");
+                    putInt(*imm);
+                    if (instr.spill) put(']');
+                }
+            }
+            for (const auto& label : instr.labels) {
+                if (!label.has_value()) continue;
+                separator();
+                put(*label);
+            }
+            put('\n');
+        }
+        put('\n');
+    }
+}
+
+void Writer::writeBinary(const Function& fn, const Allocation* alloc, const TargetDesc* target) {
+    auto putOperand = [&](BinaryOperand kind, int32_t value) {
+        putU8(static_cast<uint8_t>(kind));
+        putU32(static_cast<uint32_t>(value));
+    };
+    auto putReg = [&](VReg v) {
+        int reg = alloc ? alloc->reg[v.id] : -1;
+        if (reg < 0) putOperand(BinaryOperand::VReg, v.id);
+        else putOperand(BinaryOperand::PhysReg, alloc->regClass[v.id] << 8 | reg);
+    };
+
+    put(std::string_view(kBinaryMagic, sizeof(kBinaryMagic)));
+    putU8(kBinaryVersion);
+    putU32(static_cast<uint32_t>(fn.blocks.size()));
+
+    for (const auto& block : fn.blocks) {
+        putU32(static_cast<uint32_t>(block->label.size()));
+        put(block->label);
+
+        uint32_t numInstrs = 0;
+        for (const Instruction& instr : block->instructions)
+            numInstrs += !(alloc && isRemovedCopy(instr, *alloc, *target));
+        putU32(numInstrs);
+
+        for (const Instruction& instr : block->instructions) {
+            if (alloc && isRemovedCopy(instr, *alloc, *target)) continue;
+
+            putU8(static_cast<uint8_t>(instr.op));
+            putU8(static_cast<uint8_t>(instr.def.has_value() | instr.spill << 1));
+            if (instr.def.has_value()) putReg(*instr.def);
+
+            uint8_t numUses = 0;
+            for (const auto& operand : instr.operands)
+                numUses += !std::holds_alternative<std::monostate>(operand);
+            putU8(numUses);
+            for (const auto& operand : instr.operands) {
+                if (auto* reg = std::get_if<VReg>(&operand))
+                    putReg(*reg);
+                else if (auto* imm = std::get_if<int>(&operand))
+                    putOperand(instr.spill ? BinaryOperand::SpillSlot : BinaryOperand::Immediate, *imm);
+            }
+
+            uint8_t numTargets = 0;
+            for (const auto& label : instr.labels)
+                numTargets += label.has_value();
+            putU8(numTargets);
+            for (const auto& label : instr.labels) {
+                if (!label.has_value()) continue;
+                auto it = fn.labelToBlock.find(*label);
+                if (it == fn.labelToBlock.end())
+                    throw std::runtime_error("branch to unknown label " + *label);
+                putU32(static_cast<uint32_t>(it->second->id));
+            }
+        }
+    }
+}
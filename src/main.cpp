@@ -1,18 +1,274 @@
+#include "ion/Batch.h"
+#include "ion/Cache.h"
 #include "ion/CFG.h"
+#include "ion/Liveness.h"
+#include "ion/Pipeline.h"
 #include "ion/Reader.h"
-#include "ion/IR.h"
+#include "ion/Server.h"
+#include "ion/Stats.h"
+#include "ion/Target.h"
+#include "ion/ThreadPool.h"
+#include "ion/Trace.h"
+#include "ion/Visualize.h"
+#include "ion/Writer.h"
 
+#include <charconv>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+void writeFile(const std::string& path, const std::string& data, Writer::Format format) {
+    std::FILE* out = std::fopen(path.c_str(), format == Writer::Format::Binary ? "wb" : "w");
+    if (!out) throw std::runtime_error("could not open " + path);
+    size_t written = std::fwrite(data.data(), 1, data.size(), out);
+    std::fclose(out);
+    if (written != data.size()) throw std::runtime_error("failed to write " + path);
+}
+
+void writeStdout(const std::string& data) {
+    if (std::fwrite(data.data(), 1, data.size(), stdout) != data.size())
+        throw std::runtime_error("failed to write output");
+}
+
+/**
+    Where a batch writes the output for input under -o dir: at input's
+    own relative path, so files of the same name in different
+    directories stay apart. An absolute path or one that leaves the
+    current directory keeps only its file name.
+*/
+std::filesystem::path batchOutputPath(const std::string& dir, const std::string& input) {
+    std::filesystem::path path = std::filesystem::path(input).lexically_normal();
+    bool escapes = path.is_absolute() || (!path.empty() && *path.begin() == "..");
+    return (std::filesystem::path(dir) / (escapes ? path.filename() : path)).lexically_normal();
+}
+
+/* A byte count with an optional K, M or G suffix */
+bool parseSize(std::string_view text, uint64_t& bytes) {
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), bytes);
+    if (ec != std::errc{}) return false;
+    std::string_view suffix(end, static_cast<size_t>(text.data() + text.size() - end));
+    unsigned shift = suffix.empty() ? 0 : suffix == "K" ? 10 : suffix == "M" ? 20 : suffix == "G" ? 30 : 64;
+    if (shift == 64 || bytes > (~uint64_t{0} >> shift)) return false;
+    bytes <<= shift;
+    return true;
+}
+
+Server* runningServer = nullptr;
+
+extern "C" void stopServer(int) {
+    if (runningServer) runningServer->stop();
+}
+
+}   // namespace
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << "<path-to-file.ion>\n";
+    std::vector<std::string> inputFiles;
+    std::string manifestFile;
+    std::string socketPath;
+    std::string cacheDir;
+    uint64_t cacheSize = kDefaultCacheSize;
+    std::string outputFile;
+    std::string_view targetName = "risc16";
+    Writer::Format format = Writer::Format::Text;
+    bool cleanup = false;
+    bool speculativeSpills = false;
+    bool verify = true;
+    bool execute = false;
+    unsigned jobs = 0;
+    enum class StatsFormat { Off, Text, JSON } statsFormat = StatsFormat::Off;
+    std::string statsFile;
+    std::string traceFile;
+    std::string cfgDotFile;
+    std::string coloringDotFile;
+    bool dotInstructions = false;
+    bool dotLiveness = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--target" && i + 1 < argc) targetName = argv[++i];
+        else if (arg == "-o" && i + 1 < argc) outputFile = argv[++i];
+        else if (arg == "--binary") format = Writer::Format::Binary;
+        else if (arg == "--cleanup") cleanup = true;
+        else if (arg == "--speculative-spills") speculativeSpills = true;
+        else if (arg == "--no-verify") verify = false;
+        else if (arg == "--execute") execute = true;
+        else if (arg == "--manifest" && i + 1 < argc) manifestFile = argv[++i];
+        else if (arg == "--serve" && i + 1 < argc) socketPath = argv[++i];
+        else if (arg == "--cache-dir" && i + 1 < argc) cacheDir = argv[++i];
+        else if (arg == "--cache-size" && i + 1 < argc) {
+            std::string_view n = argv[++i];
+            if (!parseSize(n, cacheSize)) {
+                std::cerr << "[ERROR] invalid cache size: " << n << "\n";
+                return 1;
+            }
+        }
+        else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            std::string_view n = argv[++i];
+            if (std::from_chars(n.data(), n.data() + n.size(), jobs).ec != std::errc{}) {
+                std::cerr << "[ERROR] invalid worker count: " << n << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--stats" || arg == "--stats=text") statsFormat = StatsFormat::Text;
+        else if (arg == "--stats=json") statsFormat = StatsFormat::JSON;
+        else if (arg == "--stats-file" && i + 1 < argc) statsFile = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc) traceFile = argv[++i];
+        else if (arg == "--dot-cfg" && i + 1 < argc) cfgDotFile = argv[++i];
+        else if (arg == "--dot-interference" && i + 1 < argc) coloringDotFile = argv[++i];
+        else if (arg == "--dot-instructions") dotInstructions = true;
+        else if (arg == "--dot-liveness") dotLiveness = true;
+        else inputFiles.emplace_back(arg);
+    }
+
+    if (inputFiles.empty() && manifestFile.empty() && socketPath.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--target <preset|config-file>] [-o <output>] [--binary] [--cleanup] [--speculative-spills]"
+                  << " [--no-verify] [--execute]"
+                  << " [--stats[=text|json]] [--stats-file <file>]"
+                  << " [--trace <trace.json>] [--dot-cfg <file>] [--dot-interference <file>]"
+                  << " [--dot-instructions] [--dot-liveness] [--cache-dir <dir>] [--cache-size <bytes>[K|M|G]]"
+                  << " <path-to-file.ion>\n"
+                  << "       " << argv[0]
+                  << " [options] [-j <workers>] [--manifest <file>] [-o <output-dir>] <file.ion>...\n"
+                  << "       " << argv[0] << " [--target <preset|config-file>] [--cleanup] [-j <workers>]"
+                  << " --serve <socket>\n";
         return 1;
     }
 
-    std::string inputFile = argv[1];
-    
-    Reader reader;
-    Function cfg = reader.BuildCFG(inputFile);
-    return 0;
+    // A preset name, otherwise a target config file
+    std::unique_ptr<TargetConfig> config;
+    const TargetDesc* target = findTarget(targetName);
+    Stats stats;
+    if (statsFormat != StatsFormat::Off) stats::enable(&stats);
+    TraceRecorder tracer;
+    if (!traceFile.empty()) trace::enable(&tracer);
+    int status = 0;
+    try {
+        if (!target) {
+            config = loadTarget(std::string(targetName));
+            target = &config->desc;
+        }
+        if (!manifestFile.empty()) {
+            std::vector<std::string> listed = readManifest(manifestFile);
+            inputFiles.insert(inputFiles.end(), listed.begin(), listed.end());
+        }
+
+        std::unique_ptr<ResultCache> cache;
+        if (!cacheDir.empty()) cache = std::make_unique<ResultCache>(cacheDir, cacheSize);
+        PipelineOptions opts{.target = target, .format = format, .cleanup = cleanup,
+                             .speculativeSpills = speculativeSpills, .verify = verify,
+                             .execute = execute, .cache = cache.get()};
+        bool batch = inputFiles.size() > 1 || !manifestFile.empty();
+
+        if (!socketPath.empty()) {
+            if (!inputFiles.empty() || !manifestFile.empty())
+                throw std::invalid_argument("--serve takes no input files");
+            Server server(socketPath, opts, jobs);
+            runningServer = &server;
+            std::signal(SIGINT, stopServer);
+            std::signal(SIGTERM, stopServer);
+#ifdef SIGPIPE
+            std::signal(SIGPIPE, SIG_IGN);
+#endif
+            std::cerr << "[INFO] Serving on " << server.path() << "\n";
+            server.run();
+            runningServer = nullptr;
+        } else if (!batch) {
+            if (!cfgDotFile.empty()) {
+                opts.beforeAllocation = [&](Function& fn) {
+                    std::ofstream dot(cfgDotFile);
+                    if (!dot.is_open()) throw std::runtime_error("could not open " + cfgDotFile);
+                    LivenessResult lr;
+                    if (dotLiveness) lr = LivenessAnalysis().analyse(fn);
+                    writeCFGDot(dot, fn, {.instructions = dotInstructions, .liveness = dotLiveness ? &lr : nullptr});
+                };
+            }
+            if (!coloringDotFile.empty()) {
+                opts.afterAllocation = [&](Function& fn, const Allocation& alloc) {
+                    std::ofstream dot(coloringDotFile);
+                    if (!dot.is_open()) throw std::runtime_error("could not open " + coloringDotFile);
+                    writeColoringDot(dot, fn, alloc, *target);
+                };
+            }
+
+            // Only a very large function is worth starting workers for, unless they have spill metrics to try
+            std::optional<ThreadPool> pool;
+            std::error_code ec;
+            if (speculativeSpills || (std::filesystem::file_size(inputFiles[0], ec) >= kParallelParseThreshold && !ec))
+                opts.pool = &pool.emplace(jobs);
+
+            PipelineResult result = runPipeline(inputFiles[0], opts);
+            std::cerr << result.log;
+            if (outputFile.empty()) writeStdout(result.output);
+            else writeFile(outputFile, result.output, format);
+        } else {
+            if (!cfgDotFile.empty() || !coloringDotFile.empty())
+                throw std::invalid_argument("--dot-cfg and --dot-interference take a single input file");
+
+            // With -o, each file's output goes under <dir>; otherwise all of it goes to stdout in input order
+            if (!outputFile.empty()) {
+                std::unordered_map<std::string, const std::string*> writer;
+                for (const std::string& file : inputFiles) {
+                    std::filesystem::path out = batchOutputPath(outputFile, file);
+                    auto [it, added] = writer.emplace(out.string(), &file);
+                    if (!added)
+                        throw std::invalid_argument(*it->second + " and " + file + " would both be written to " +
+                                                    out.string());
+                    std::filesystem::create_directories(out.parent_path());
+                }
+            }
+            ThreadPool pool(jobs);
+            opts.pool = &pool;
+            BatchSummary summary = runBatch(inputFiles, opts, pool, [&](BatchItem& item) {
+                if (!item.error.empty()) {
+                    std::cerr << "[ERROR] " << item.file << ": " << item.error << "\n";
+                    return;
+                }
+                std::cerr << item.result.log;
+                if (outputFile.empty()) {
+                    writeStdout(item.result.output);
+                } else {
+                    writeFile(batchOutputPath(outputFile, item.file).string(), item.result.output, format);
+                }
+            });
+            std::fflush(stdout);
+            std::cerr << "[INFO] Allocated " << summary.files - summary.failed << " of " << summary.files
+                      << " functions in " << summary.seconds << " s on " << pool.size() << " workers ("
+                      << summary.functionsPerSecond() << " functions/sec)\n";
+            if (summary.failed > 0) status = 1;
+        }
+
+        if (cache) cache->trim();
+
+        if (!traceFile.empty()) {
+            trace::enable(nullptr);
+            std::ofstream file(traceFile);
+            if (!file.is_open()) throw std::runtime_error("could not open " + traceFile);
+            tracer.writeJSON(file);
+        }
+        if (statsFormat != StatsFormat::Off) {
+            stats::enable(nullptr);
+            std::ofstream file;
+            if (!statsFile.empty()) {
+                file.open(statsFile);
+                if (!file.is_open()) throw std::runtime_error("could not open " + statsFile);
+            }
+            std::ostream& os = statsFile.empty() ? std::cerr : file;
+            if (statsFormat == StatsFormat::JSON) stats.writeJSON(os);
+            else stats.writeText(os);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[ERROR] " << e.what() << "\n";
+        return 1;
+    }
+    return status;
 }
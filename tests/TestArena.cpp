@@ -0,0 +1,99 @@
+#include "ion/Arena.h"
+#include "ion/InterferenceGraph.h"
+#include "ion/Liveness.h"
+#include "ion/Pipeline.h"
+#include "ion/Reader.h"
+#include "ion/Target.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+
+namespace {
+
+/* Forwards to the heap and counts the calls */
+struct CountingResource final : std::pmr::memory_resource {
+    size_t allocations = 0;
+    void* do_allocate(size_t n, size_t alignment) override {
+        ++allocations;
+        return std::pmr::new_delete_resource()->allocate(n, alignment);
+    }
+    void do_deallocate(void* p, size_t n, size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(p, n, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+}   // namespace
+
+TEST(ArenaTest, GrowsToHighWaterMarkAndKeepsIt) {
+    FunctionArena arena(1024);
+    for (int i = 0; i < 100; ++i) {
+        void* p = arena.allocate(256, 8);
+        ASSERT_NE(p, nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 8, 0u);
+    }
+    EXPECT_GT(arena.overflow(), 0u);
+
+    arena.release();
+    EXPECT_GE(arena.capacity(), 100u * 256);
+    EXPECT_EQ(arena.overflow(), 0u);
+
+    // The same demand now fits in the retained buffer
+    for (int i = 0; i < 100; ++i) EXPECT_NE(arena.allocate(256, 8), nullptr);
+    EXPECT_EQ(arena.overflow(), 0u);
+    size_t capacity = arena.capacity();
+    arena.release();
+    EXPECT_EQ(arena.capacity(), capacity);
+}
+
+TEST(ArenaTest, FunctionAndAnalysesUseTheFunctionsResource) {
+    CountingResource counting;
+    Function fn = Reader(&counting).BuildCFGFromSource(generatedIR(1, 400), "f");
+    size_t afterRead = counting.allocations;
+    EXPECT_GT(afterRead, 0u);
+    EXPECT_EQ(fn.resource(), &counting);
+    EXPECT_EQ(fn.blocks[0]->instructions.get_allocator().resource(), &counting);
+
+    LivenessResult lr = LivenessAnalysis().analyse(fn);
+    size_t afterLiveness = counting.allocations;
+    EXPECT_GT(afterLiveness, afterRead);
+    EXPECT_EQ(lr.liveoutSet.get_allocator().resource(), &counting);
+
+    std::vector<uint8_t> regClass(1000, 0);
+    InterferenceGraph graph = buildInterferenceGraph(fn, lr, regClass, {0}, 0, &counting);
+    EXPECT_GT(counting.allocations, afterLiveness);
+}
+
+TEST(ArenaTest, OutputMatchesHeapAllocation) {
+    for (uint64_t seed = 1; seed <= 4; ++seed) {
+        std::string source = generatedIR(seed, 400);
+        Function onHeap = Reader().BuildCFGFromSource(source, "f");
+        std::string expected = runPipeline(onHeap, {.target = &targets::Tiny}).output;
+
+        ArenaScope scope;
+        Function inArena = Reader(scope.resource()).BuildCFGFromSource(source, "f");
+        EXPECT_EQ(runPipeline(inArena, {.target = &targets::Tiny}).output, expected);
+    }
+}
+
+TEST(ArenaTest, WarmArenaServesRepeatFunctionsWithoutOverflow) {
+    std::thread worker([] {
+        FunctionArena& arena = FunctionArena::forThisThread();
+        std::string source = generatedIR(9, 2000);
+        for (int pass = 0; pass < 2; ++pass) {
+            size_t overflow;
+            {
+                ArenaScope scope;
+                Function fn = Reader(scope.resource()).BuildCFGFromSource(source, "f");
+                runPipeline(fn, {.target = &targets::RISC16});
+                overflow = arena.overflow();
+            }
+            if (pass == 1) EXPECT_EQ(overflow, 0u);
+        }
+    });
+    worker.join();
+}
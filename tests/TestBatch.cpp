@@ -0,0 +1,168 @@
+#include "ion/Batch.h"
+#include "ion/Cache.h"
+#include "ion/Pipeline.h"
+#include "ion/Target.h"
+#include "ion/ThreadPool.h"
+#include "utils/h/IRGenerator.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace {
+
+std::vector<std::string> generatedFiles(size_t n) {
+    std::vector<std::string> files;
+    for (size_t i = 0; i < n; ++i) {
+        std::string path = (std::filesystem::temp_directory_path() /
+                            ("ion_batch_" + std::to_string(i) + ".ion")).string();
+        std::ofstream(path) << generatedIR(i + 1, 50 + 40 * (i % 5));
+        files.push_back(path);
+    }
+    return files;
+}
+
+std::string runAll(const std::vector<std::string>& files, unsigned workers, BatchSummary& summary,
+                   std::vector<std::string>* errors = nullptr) {
+    PipelineOptions opts{.target = &targets::Tiny};
+    ThreadPool pool(workers);
+    std::string out;
+    summary = runBatch(files, opts, pool, [&](BatchItem& item) {
+        if (!item.error.empty()) {
+            if (errors) errors->push_back(item.file);
+            return;
+        }
+        out += item.result.output;
+    });
+    return out;
+}
+
+TEST(BatchTest, OutputMatchesSequentialOrder) {
+    std::vector<std::string> files = generatedFiles(12);
+    std::string expected;
+    for (const auto& f : files)
+        expected += runPipeline(f, {.target = &targets::Tiny}).output;
+
+    for (unsigned workers : {1u, 3u, 8u}) {
+        SCOPED_TRACE(workers);
+        BatchSummary summary;
+        EXPECT_EQ(runAll(files, workers, summary), expected);
+        EXPECT_EQ(summary.files, files.size());
+        EXPECT_EQ(summary.failed, 0u);
+    }
+}
+
+TEST(BatchTest, ErrorsReportedPerFile) {
+    std::vector<std::string> files = generatedFiles(3);
+    files.insert(files.begin() + 1, "does/not/exist.ion");
+
+    BatchSummary summary;
+    std::vector<std::string> errors;
+    std::string out = runAll(files, 2, summary, &errors);
+    EXPECT_EQ(summary.failed, 1u);
+    ASSERT_EQ(errors.size(), 1u);
+    EXPECT_EQ(errors[0], "does/not/exist.ion");
+    EXPECT_FALSE(out.empty());
+}
+
+/* Loop programs under enough pressure to take the graph path, whose speculative colouring waits on the pool */
+std::vector<std::string> pressureFiles(size_t n) {
+    std::vector<std::string> files;
+    for (size_t i = 0; i < n; ++i) {
+        GeneratorOptions opts;
+        opts.seed = 100 + i;
+        opts.instructions = 200;
+        opts.loopDepth = 2;
+        opts.pressure = 12;
+        std::string path = (std::filesystem::temp_directory_path() /
+                            ("ion_batch_pressure_" + std::to_string(i) + ".ion")).string();
+        generateIRFile(opts, path);
+        files.push_back(path);
+    }
+    return files;
+}
+
+TEST(BatchTest, CacheHitsMatchUncachedOutput) {
+    std::vector<std::string> files = pressureFiles(24);
+    std::vector<std::string> expected;
+    for (const auto& f : files)
+        expected.push_back(runPipeline(f, {.target = &targets::Tiny, .speculativeSpills = true}).output);
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "ion_batch_cache";
+    std::filesystem::remove_all(dir);
+    ResultCache cache(dir.string());
+    ThreadPool pool(4);
+    PipelineOptions opts{.target = &targets::Tiny, .speculativeSpills = true, .cache = &cache, .pool = &pool};
+    for (bool hits : {false, true}) {
+        SCOPED_TRACE(hits ? "hits" : "misses");
+        size_t i = 0;
+        runBatch(files, opts, pool, [&](BatchItem& item) {
+            EXPECT_EQ(item.error, "");
+            EXPECT_EQ(item.result.cached, hits) << item.file;
+            EXPECT_EQ(item.result.output, expected[i]) << item.file;
+            ++i;
+        });
+        EXPECT_EQ(i, files.size());
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(BatchTest, CacheKeySurvivesNestedPipeline) {
+    std::vector<std::string> files = pressureFiles(2);
+    std::vector<std::string> expected;
+    for (const auto& f : files)
+        expected.push_back(runPipeline(f, {.target = &targets::Tiny, .speculativeSpills = true}).output);
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "ion_batch_nested";
+    std::filesystem::remove_all(dir);
+    ResultCache cache(dir.string());
+    ThreadPool pool(2);
+    PipelineOptions opts{.target = &targets::Tiny, .speculativeSpills = true, .cache = &cache, .pool = &pool};
+
+    // With both workers held, the first file's colouring waits on this thread, which runs the queued
+    // second file in the meantime, as a worker of a batch would
+    ThreadPool::TaskGroup held;
+    std::atomic<unsigned> holding{0};
+    std::atomic<bool> release{false};
+    for (unsigned w = 0; w < pool.size(); ++w) {
+        pool.submit(held, [&] {
+            holding.fetch_add(1);
+            while (!release.load()) std::this_thread::yield();
+        });
+    }
+    while (holding.load() < pool.size()) std::this_thread::yield();
+
+    ThreadPool::TaskGroup nested;
+    PipelineResult second;
+    pool.submit(nested, [&] { second = runPipeline(files[1], opts); });
+    PipelineResult first = runPipeline(files[0], opts);
+    pool.wait(nested);
+    release.store(true);
+    pool.wait(held);
+    EXPECT_FALSE(first.cached);
+    EXPECT_FALSE(second.cached);
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        SCOPED_TRACE(files[i]);
+        PipelineResult hit = runPipeline(files[i], opts);
+        EXPECT_TRUE(hit.cached);
+        EXPECT_EQ(hit.output, expected[i]);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(BatchTest, ManifestSkipsCommentsAndBlanks) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "ion_manifest.txt";
+    std::ofstream(path) << "# inputs\n  a.ion  \n\nb.ion\r\n";
+    std::vector<std::string> files = readManifest(path.string());
+    ASSERT_EQ(files.size(), 2u);
+    EXPECT_EQ(files[0], "a.ion");
+    EXPECT_EQ(files[1], "b.ion");
+}
+
+}   // namespace
@@ -0,0 +1,139 @@
+#include "ion/Cache.h"
+#include "ion/Pipeline.h"
+#include "ion/Reader.h"
+#include "ion/Target.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+Function parse(const std::string& source, const std::string& name = "f") {
+    return Reader().BuildCFGFromSource(source, name);
+}
+
+class CacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir = fs::temp_directory_path() /
+              ("ion_cache_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+        fs::remove_all(dir);
+    }
+    void TearDown() override { fs::remove_all(dir); }
+
+    std::vector<fs::path> files() const {
+        std::vector<fs::path> out;
+        for (const auto& e : fs::directory_iterator(dir)) out.push_back(e.path());
+        return out;
+    }
+
+    fs::path dir;
+};
+
+}   // namespace
+
+TEST_F(CacheTest, HitSkipsPipelineWithSameOutput) {
+    ResultCache cache(dir.string());
+    std::string source = generatedIR(1, 80);
+    PipelineOptions opts{.target = &targets::Tiny, .cache = &cache};
+
+    Function first = parse(source);
+    PipelineResult miss = runPipeline(first, opts);
+    EXPECT_FALSE(miss.cached);
+
+    Function second = parse(source);
+    PipelineResult hit = runPipeline(second, opts);
+    EXPECT_TRUE(hit.cached);
+    EXPECT_EQ(hit.output, miss.output);
+
+    Function fresh = parse(source);
+    EXPECT_EQ(hit.output, runPipeline(fresh, {.target = &targets::Tiny}).output);
+}
+
+TEST_F(CacheTest, KeyIgnoresFormattingAndName) {
+    std::string source = generatedIR(2, 80);
+    std::string spaced;
+    for (char c : source) {
+        spaced += c;
+        if (c == '\n') spaced += "\n";
+    }
+    EXPECT_EQ(ResultCache::key(parse(source, "a"), targets::Tiny, Writer::Format::Text, false),
+              ResultCache::key(parse(spaced, "b"), targets::Tiny, Writer::Format::Text, false));
+}
+
+TEST_F(CacheTest, KeyDependsOnEverythingThatShapesTheOutput) {
+    Function fn = parse(generatedIR(3, 80));
+    std::string base = ResultCache::key(fn, targets::Tiny, Writer::Format::Text, false);
+    EXPECT_NE(base, ResultCache::key(fn, targets::RISC16, Writer::Format::Text, false));
+    EXPECT_NE(base, ResultCache::key(fn, targets::Tiny, Writer::Format::Binary, false));
+    EXPECT_NE(base, ResultCache::key(fn, targets::Tiny, Writer::Format::Text, true));
+    EXPECT_NE(base, ResultCache::key(parse(generatedIR(4, 80)), targets::Tiny, Writer::Format::Text, false));
+}
+
+TEST_F(CacheTest, CorruptEntryIsAMiss) {
+    ResultCache cache(dir.string());
+    cache.store("key", "output");
+    std::string out;
+    ASSERT_TRUE(cache.lookup("key", out));
+    EXPECT_EQ(out, "output");
+    EXPECT_FALSE(cache.lookup("other key", out));
+
+    ASSERT_EQ(files().size(), 1u);
+    fs::resize_file(files()[0], fs::file_size(files()[0]) - 2);
+    EXPECT_FALSE(cache.lookup("key", out));
+}
+
+TEST_F(CacheTest, TrimEvictsLeastRecentlyUsed) {
+    ResultCache cache(dir.string(), 10000);
+    std::string payload(1000, 'x');
+    auto base = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    for (int i = 0; i < 8; ++i) {
+        std::vector<fs::path> before = files();
+        cache.store("key" + std::to_string(i), payload);
+        // Spread the modification times so the order does not hinge on the filesystem's resolution
+        for (const auto& f : files())
+            if (std::find(before.begin(), before.end(), f) == before.end())
+                fs::last_write_time(f, base + std::chrono::minutes(i));
+    }
+    std::string out;
+    ASSERT_TRUE(cache.lookup("key0", out));     // now the most recently used
+    for (int i = 8; i < 14; ++i) cache.store("key" + std::to_string(i), payload);
+    cache.trim();
+
+    uint64_t total = 0;
+    for (const auto& f : files()) total += fs::file_size(f);
+    EXPECT_LE(total, 10000u);
+    EXPECT_TRUE(cache.lookup("key0", out));
+    EXPECT_FALSE(cache.lookup("key1", out));
+    EXPECT_TRUE(cache.lookup("key13", out));
+}
+
+TEST_F(CacheTest, ConcurrentWritersNeverExposePartialEntries) {
+    // Two caches on one directory stand in for two processes
+    ResultCache a(dir.string());
+    ResultCache b(dir.string());
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t] {
+            ResultCache& cache = t % 2 ? a : b;
+            std::string out;
+            for (int i = 0; i < 200; ++i) {
+                std::string key = "key" + std::to_string(i % 10);
+                std::string value(1000 + (i % 10) * 100, static_cast<char>('a' + i % 10));
+                if (cache.lookup(key, out) && out != value) ++wrong;
+                cache.store(key, value);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(wrong.load(), 0);
+    EXPECT_EQ(files().size(), 10u);   // no temporary files left behind
+}
@@ -0,0 +1,179 @@
+#include "ion/CFG.h"
+#include "ion/Cleanup.h"
+#include "ion/Reader.h"
+#include "ion/Writer.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::string text(const Function& fn) {
+    std::string out;
+    Writer writer(out);
+    writer.write(fn);
+    writer.flush();
+    return out;
+}
+
+TEST(CleanupTest, SamplePrograms_OnlyUnreadValuesRemoved) {
+    // SimpleLoop has nothing to clean up
+    Reader reader;
+    Function loop = reader.BuildCFG("docs/iON_IR/SimpleLoop.ion");
+    CleanupStats stats = cleanupFunction(loop);
+    EXPECT_EQ(stats.deadInstructions, 0u);
+    EXPECT_EQ(stats.propagatedUses, 0u);
+    EXPECT_EQ(text(loop),
+        "INIT_BLOCK:\n"
+        "    MOV %1, 0\n"
+        "    JMP main_block\n"
+        "\n"
+        "main_block:\n"
+        "    BEQ %1, 40, BLOCK_C, BLOCK_A\n"
+        "\n"
+        "BLOCK_A:\n"
+        "    ADD %1, %1, 1\n"
+        "    JMP main_block\n"
+        "\n"
+        "BLOCK_C:\n"
+        "    RET\n"
+        "\n");
+
+    // NestedLoop's %3 is never read
+    Function nested = reader.BuildCFG("docs/iON_IR/NestedLoop.ion");
+    stats = cleanupFunction(nested);
+    EXPECT_EQ(stats.deadInstructions, 1u);
+    EXPECT_EQ(stats.propagatedUses, 0u);
+    EXPECT_EQ(stats.vregsBefore, 3u);
+    EXPECT_EQ(stats.vregsAfter, 2u);
+    EXPECT_EQ(maxVRegID(nested), 2);
+    EXPECT_EQ(text(nested),
+        "INIT_BLOCK:\n"
+        "    MOV %1, 0\n"
+        "    MOV %2, 0\n"
+        "    JMP OUTER_BLOCK\n"
+        "\n"
+        "OUTER_BLOCK:\n"
+        "    BEQ %1, 10, INNER_BLOCK, OUTER_BODY\n"
+        "\n"
+        "OUTER_BODY:\n"
+        "    ADD %1, %1, 1\n"
+        "    JMP OUTER_BLOCK\n"
+        "\n"
+        "INNER_BLOCK:\n"
+        "    BEQ %2, 5, RET_BLOCK, INNER_BODY\n"
+        "\n"
+        "INNER_BODY:\n"
+        "    ADD %2, %2, 1\n"
+        "    JMP INNER_BLOCK\n"
+        "\n"
+        "RET_BLOCK:\n"
+        "    RET\n"
+        "\n");
+}
+
+TEST(CleanupTest, DeadChainRemoved) {
+    Function fn = readIR("ion_dce.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    ADD %2, %1, 1\n"
+        "    MUL %3, %2, %2\n"
+        "    MOV %4, 7\n"
+        "    JMP EXIT\n"
+        "EXIT:\n"
+        "    BEQ %4, 7, ENTRY, ENTRY\n");
+    CleanupStats stats = cleanupFunction(fn);
+
+    // %3 is dead, which kills %2 and then %1
+    EXPECT_EQ(stats.deadInstructions, 3u);
+    ASSERT_EQ(fn.blocks[0]->instructions.size(), 2u);
+    EXPECT_EQ(fn.blocks[0]->instructions[0].def->id, 4);
+    EXPECT_EQ(stats.vregsAfter, 1u);
+}
+
+TEST(CleanupTest, KeptBranchesKeepTheirLabels) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/SimpleLoop.ion");
+    cleanupFunction(fn);
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.op == OpCode::JMP || instr.op == OpCode::BEQ)
+                EXPECT_FALSE(instr.labels[0].value_or("").empty()) << block->label;
+        }
+    }
+}
+
+TEST(CleanupTest, CopyChainPropagatedAcrossBlocks) {
+    Function fn = readIR("ion_copyprop.ion",
+        "ENTRY:\n"
+        "    ADD %1, %9, 1\n"
+        "    MOV %2, %1\n"
+        "    MOV %3, %2\n"
+        "    JMP NEXT\n"
+        "NEXT:\n"
+        "    ADD %4, %3, %3\n"
+        "    BEQ %4, 0, EXIT, EXIT\n"
+        "EXIT:\n"
+        "    RET\n");
+    CleanupStats stats = cleanupFunction(fn);
+
+    const Instruction& add = fn.labelToBlock["NEXT"]->instructions[0];
+    EXPECT_EQ(std::get<VReg>(add.operands[0]).id, 1);
+    EXPECT_EQ(std::get<VReg>(add.operands[1]).id, 1);
+    // Both copies are dead once their uses read %1
+    EXPECT_EQ(fn.blocks[0]->instructions.size(), 2u);
+    EXPECT_EQ(stats.vregsBefore, 5u);
+    EXPECT_EQ(stats.vregsAfter, 3u);
+}
+
+TEST(CleanupTest, KilledCopyNotPropagated) {
+    Function fn = readIR("ion_copykill.ion",
+        "ENTRY:\n"
+        "    MOV %1, 0\n"
+        "    MOV %2, %1\n"
+        "    JMP LOOP\n"
+        "LOOP:\n"
+        "    ADD %1, %1, 1\n"
+        "    BEQ %2, 3, EXIT, LOOP\n"
+        "EXIT:\n"
+        "    RET\n");
+    cleanupFunction(fn);
+
+    // %1 is redefined in the loop, so %2 must keep its own value
+    const Instruction& beq = fn.labelToBlock["LOOP"]->instructions.back();
+    EXPECT_EQ(std::get<VReg>(beq.operands[0]).id, 2);
+}
+
+TEST(CleanupTest, BlockLocalCopiesStayInTheirBlock) {
+    Function fn = readIR("ion_copylocal.ion",
+        "ENTRY:\n"
+        "    ADD %1, %9, 1\n"
+        "    MOV %2, %1\n"
+        "    ADD %3, %2, %2\n"
+        "    MOV %4, %1\n"
+        "    ADD %1, %9, 2\n"
+        "    JMP LOOP\n"
+        "LOOP:\n"
+        "    ADD %5, %4, %6\n"
+        "    MOV %6, %3\n"
+        "    ADD %7, %6, %5\n"
+        "    BEQ %7, %1, EXIT, LOOP\n"
+        "EXIT:\n"
+        "    RET\n");
+    CleanupStats stats = cleanupFunction(fn);
+    EXPECT_EQ(stats.propagatedUses, 3u);
+
+    // %2 is only read in ENTRY, after the copy
+    const Instruction& add = fn.labelToBlock["ENTRY"]->instructions[1];
+    EXPECT_EQ(std::get<VReg>(add.operands[0]).id, 1);
+    EXPECT_EQ(std::get<VReg>(add.operands[1]).id, 1);
+    // %1 is redefined before ENTRY ends, so LOOP keeps %4; %6 is read around the back edge
+    // before the copy that makes it
+    const auto& loop = fn.labelToBlock["LOOP"]->instructions;
+    EXPECT_EQ(std::get<VReg>(loop[0].operands[0]).id, 4);
+    EXPECT_EQ(std::get<VReg>(loop[0].operands[1]).id, 6);
+    EXPECT_EQ(std::get<VReg>(loop[2].operands[0]).id, 3);
+}
+
+}
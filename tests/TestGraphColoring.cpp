@@ -0,0 +1,140 @@
+#include "ion/InterferenceGraph.h"
+#include "ion/GraphColoring.h"
+#include "ion/ThreadPool.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+namespace {
+
+/* Ring of n nodes plus a chord, coloured with every node a candidate */
+InterferenceGraph ring(int n) {
+    InterferenceGraph g(n);
+    for (int i = 0; i < n; ++i) {
+        g.addNode(i);
+        g.addEdge(i, (i + 1) % n);
+    }
+    g.addEdge(0, n / 2);
+    g.finalise();
+    return g;
+}
+
+void expectProperColoring(const InterferenceGraph& g, const ColoringResult& r) {
+    for (int n : g.nodes()) {
+        if (r.color[n] < 0) continue;
+        for (int m : g.neighbours(n))
+            EXPECT_NE(r.color[n], r.color[m]) << n << " and " << m;
+    }
+}
+
+TEST(GraphColoringTest, KernelsAgree) {
+    InterferenceGraph g = ring(9);
+    std::vector<int> stack = g.nodes();
+
+    ColoringResult r16, r32, r64;
+    selectColors<16>(g, stack, 0x7, 0x0, r16);
+    selectColors<32>(g, stack, 0x7, 0x0, r32);
+    selectColors<64>(g, stack, 0x7, 0x0, r64);
+
+    EXPECT_TRUE(r16.spilled.empty());
+    EXPECT_EQ(r16.color, r32.color);
+    EXPECT_EQ(r16.color, r64.color);
+    expectProperColoring(g, r16);
+}
+
+TEST(GraphColoringTest, HighRegistersUseWideKernel) {
+    InterferenceGraph g = ring(6);
+    std::vector<float> cost(6, 1.0f);
+    // Only registers 40..42 may be used, so the 64-bit kernel must be chosen
+    ColoringResult r = colorGraph(g, uint64_t{0x7} << 40, 0, cost);
+
+    ASSERT_TRUE(r.spilled.empty());
+    for (int n : g.nodes()) {
+        EXPECT_GE(r.color[n], 40);
+        EXPECT_LE(r.color[n], 42);
+    }
+    expectProperColoring(g, r);
+}
+
+TEST(GraphColoringTest, PreferredRegistersFirst) {
+    InterferenceGraph g = ring(4);
+    ColoringResult r;
+    selectColors<16>(g, g.nodes(), 0xff, 0xf0, r);
+    for (int n : g.nodes())
+        EXPECT_GE(r.color[n], 4);
+}
+
+TEST(GraphColoringTest, SpillsWhenUncolourable) {
+    // K4 cannot be coloured with 3 registers
+    InterferenceGraph g(4);
+    for (int i = 0; i < 4; ++i) {
+        g.addNode(i);
+        for (int j = 0; j < i; ++j) g.addEdge(i, j);
+    }
+    g.finalise();
+    std::vector<float> cost{4.0f, 1.0f, 3.0f, 2.0f};
+
+    ColoringResult r = colorGraph(g, 0x7, 0, cost);
+    ASSERT_EQ(r.spilled.size(), 1u);
+    EXPECT_EQ(r.spilled[0], 1);
+    expectProperColoring(g, r);
+}
+
+TEST(GraphColoringTest, DegreeSquaredFavoursHubs) {
+    // Two K4s sharing node 0, which costs 2.5 where the others cost 1; with 3 registers each K4 must lose a node
+    InterferenceGraph g(7);
+    for (int i = 0; i < 7; ++i) g.addNode(i);
+    for (int base : {0, 3}) {
+        std::vector<int> clique{0, base + 1, base + 2, base + 3};
+        for (size_t i = 0; i < clique.size(); ++i)
+            for (size_t j = 0; j < i; ++j) g.addEdge(clique[i], clique[j]);
+    }
+    g.finalise();
+    std::vector<float> cost{2.5f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+
+    // cost/degree: 2.5/7 > 1/4, so a node of each K4 goes
+    ColoringResult byDegree = colorGraph(g, 0x7, 0, cost);
+    EXPECT_EQ(byDegree.spilled.size(), 2u);
+    EXPECT_EQ(std::count(byDegree.spilled.begin(), byDegree.spilled.end(), 0), 0);
+    expectProperColoring(g, byDegree);
+
+    // cost/degree^2: 2.5/49 < 1/16, so the shared node goes and both K4s are relieved at once
+    ColoringResult bySquare = colorGraph(g, 0x7, 0, cost, nullptr, SpillDivisor::DegreeSquared);
+    EXPECT_EQ(bySquare.spilled, std::vector<int>{0});
+    expectProperColoring(g, bySquare);
+}
+
+TEST(GraphColoringTest, ComponentsColouredInParallelMatchSequential) {
+    // 1000 disjoint groups: a 5-ring in most, a K4 (which must spill with 3 registers) in every tenth
+    const int groups = 1000;
+    InterferenceGraph g(groups * 5);
+    std::vector<float> cost(groups * 5);
+    for (int c = 0; c < groups; ++c) {
+        int base = c * 5;
+        for (int i = 0; i < 5; ++i) {
+            g.addNode(base + i);
+            cost[base + i] = static_cast<float>((base + i) % 7 + 1);
+        }
+        if (c % 10 == 0) {
+            for (int i = 0; i < 4; ++i)
+                for (int j = 0; j < i; ++j) g.addEdge(base + i, base + j);
+        } else {
+            for (int i = 0; i < 5; ++i) g.addEdge(base + i, base + (i + 1) % 5);
+        }
+    }
+    g.finalise();
+    ASSERT_GE(g.nodes().size(), kParallelColoringThreshold);
+
+    ColoringResult sequential = colorGraph(g, 0x7, 0, cost);
+    ThreadPool pool(4);
+    ColoringResult parallel = colorGraph(g, 0x7, 0, cost, &pool);
+
+    EXPECT_EQ(sequential.color, parallel.color);
+    EXPECT_EQ(sequential.spilled, parallel.spilled);
+    EXPECT_EQ(sequential.spilled.size(), static_cast<size_t>(groups / 10));
+    EXPECT_TRUE(std::is_sorted(parallel.spilled.begin(), parallel.spilled.end()));
+    expectProperColoring(g, parallel);
+}
+
+}
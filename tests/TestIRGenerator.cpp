@@ -0,0 +1,54 @@
+#include "ion/CFG.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Target.h"
+#include "utils/h/IRGenerator.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+TEST(IRGeneratorTest, SameSeed_SameProgram) {
+    GeneratorOptions opts;
+    opts.instructions = 500;
+    EXPECT_EQ(generateIR(opts), generateIR(opts));
+
+    GeneratorOptions other = opts;
+    other.seed = 2;
+    EXPECT_NE(generateIR(opts), generateIR(other));
+}
+
+TEST(IRGeneratorTest, ProgramParsesAndAllocates) {
+    GeneratorOptions opts;
+    opts.seed = 7;
+    opts.instructions = 2000;
+    opts.loopDepth = 3;
+    Function fn = readIR("ion_generated.ion", generateIR(opts));
+
+    size_t instructions = 0;
+    bool backEdge = false;
+    for (const auto& block : fn.blocks) {
+        instructions += block->instructions.size();
+        for (const BasicBlock* succ : block->successors)
+            backEdge |= succ->id <= block->id;
+    }
+    EXPECT_GT(instructions, opts.instructions / 2);
+    EXPECT_LT(instructions, opts.instructions * 2);
+    EXPECT_TRUE(backEdge);
+    EXPECT_EQ(fn.blocks.back()->successors.size(), 0u);
+
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    EXPECT_GE(alloc.rounds, 1u);
+}
+
+TEST(IRGeneratorTest, ExplicitBlockCount) {
+    GeneratorOptions opts;
+    opts.instructions = 100;
+    opts.blocks = 12;
+    opts.loopDepth = 0;
+    Function fn = readIR("ion_generated_blocks.ion", generateIR(opts));
+    EXPECT_EQ(fn.blocks.size(), 12u);
+}
+
+}   // namespace
@@ -0,0 +1,191 @@
+#include "ion/CFG.h"
+#include "ion/Interpreter.h"
+#include "ion/Peephole.h"
+#include "ion/Pipeline.h"
+#include "ion/Reader.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Target.h"
+#include "utils/h/IRGenerator.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+namespace {
+
+// Spills with two registers; LOOP is a merge, so the graph allocator handles it
+const char* kPressure =
+    "ENTRY:\n"
+    "    MOV %1, 1\n"
+    "    MOV %2, 2\n"
+    "    MOV %3, 3\n"
+    "    MOV %7, 0\n"
+    "    JMP LOOP\n"
+    "LOOP:\n"
+    "    ADD %4, %1, %2\n"
+    "    ADD %5, %4, %3\n"
+    "    ADD %6, %5, %1\n"
+    "    ADD %7, %7, 1\n"
+    "    BEQ %7, 10, EXIT, LOOP\n"
+    "EXIT:\n"
+    "    ADD %8, %6, %7\n"
+    "    RET\n";
+
+/* Allocates fn for target, runs the peephole pass and returns the run of the result */
+Execution allocateAndRun(Function& fn, const TargetDesc& target, bool speculative = false) {
+    RegisterAllocator allocator(target);
+    allocator.speculativeSpills(speculative);
+    Allocation alloc = allocator.allocate(fn);
+    runPeephole(fn, alloc, target);
+    return interpret(fn, alloc, target);
+}
+
+}   // namespace
+
+TEST(InterpreterTest, CountsLoopIterations) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/SimpleLoop.ion");
+    Execution run = interpret(fn);
+    ASSERT_TRUE(run.completed);
+    // MOV and JMP, 41 BEQs, 40 trips round ADD and JMP, and the RET
+    EXPECT_EQ(run.stats.instructions, 2u + 41u + 80u + 1u);
+    EXPECT_EQ(run.stats.memoryOps, 0u);
+    EXPECT_EQ(run.stats.spillOps(), 0u);
+}
+
+TEST(InterpreterTest, MemoryAndBranches) {
+    auto program = [](int stored) {
+        return readIR("ion_interpret_memory.ion",
+            "ENTRY:\n"
+            "    MOV %1, 100\n"
+            "    MOV %2, " + std::to_string(stored) + "\n"
+            "    STORE %2, %1\n"
+            "    LOAD %3, %1\n"
+            "    ADD %4, %3, 1\n"
+            "    BEQ %4, 8, YES, NO\n"
+            "YES:\n"
+            "    RET\n"
+            "NO:\n"
+            "    MOV %5, 1\n"
+            "    RET\n");
+    };
+    Function taken = program(7);
+    Execution a = interpret(taken);
+    ASSERT_TRUE(a.completed);
+    EXPECT_EQ(a.stats.memoryOps, 2u);
+    EXPECT_EQ(a.stats.instructions, 7u);
+
+    Function notTaken = program(6);
+    Execution b = interpret(notTaken);
+    EXPECT_EQ(b.stats.instructions, 8u);
+    EXPECT_FALSE(sameBehaviour(a, b));
+    EXPECT_TRUE(sameBehaviour(a, interpret(taken)));
+}
+
+TEST(InterpreterTest, AllocatedSamplePrograms_SameBehaviour) {
+    for (const char* file : {"docs/iON_IR/StraightLineDAG.ion", "docs/iON_IR/SimpleLoop.ion",
+                             "docs/iON_IR/NestedLoop.ion", "docs/iON_IR/Diamond.ion"}) {
+        SCOPED_TRACE(file);
+        Reader reader;
+        Function fn = reader.BuildCFG(file);
+        Execution input = interpret(fn);
+        Execution allocated = allocateAndRun(fn, targets::RISC16);
+        EXPECT_TRUE(sameBehaviour(input, allocated));
+        EXPECT_EQ(allocated.stats.spillOps(), 0u);
+    }
+}
+
+TEST(InterpreterTest, SpillCode_CountedAndSameBehaviour) {
+    Function fn = readIR("ion_interpret_pressure.ion", kPressure);
+    Execution input = interpret(fn);
+    ASSERT_TRUE(input.completed);
+
+    auto cfg = parseTarget("class gpr r 2\n");
+    Execution allocated = allocateAndRun(fn, cfg->desc);
+    EXPECT_TRUE(sameBehaviour(input, allocated));
+    EXPECT_GT(allocated.stats.spillLoads, 0u);
+    EXPECT_GT(allocated.stats.spillStores, 0u);
+    EXPECT_EQ(allocated.stats.instructions - allocated.stats.spillOps() - allocated.stats.copies,
+              input.stats.instructions - input.stats.copies);
+}
+
+TEST(InterpreterTest, GeneratedPrograms_SameBehaviour) {
+    for (unsigned seed : {1u, 2u, 3u}) {
+        SCOPED_TRACE(seed);
+        GeneratorOptions opts;
+        opts.seed = seed;
+        opts.instructions = 2000;
+        opts.loopDepth = 3;
+        opts.pressure = 24;
+        std::string source = generateIR(opts);
+        for (bool speculative : {false, true}) {
+            Function fn = readIR("ion_interpret_generated.ion", source);
+            Execution input = interpret(fn);
+            ASSERT_TRUE(input.completed);
+            Execution allocated = allocateAndRun(fn, targets::RISC16, speculative);
+            EXPECT_TRUE(sameBehaviour(input, allocated));
+            EXPECT_GT(allocated.stats.spillOps(), 0u);
+        }
+    }
+}
+
+TEST(InterpreterTest, SharedRegister_BehavesDifferently) {
+    Function fn = readIR("ion_interpret_shared.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    ADD %3, %1, %2\n"
+        "    RET\n");
+    Execution input = interpret(fn);
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    alloc.reg[2] = alloc.reg[1];
+    EXPECT_FALSE(sameBehaviour(input, interpret(fn, alloc, targets::RISC16)));
+}
+
+TEST(InterpreterTest, InstructionLimit_StopsEndlessLoop) {
+    Function fn = readIR("ion_interpret_endless.ion",
+        "ENTRY:\n"
+        "    MOV %1, 0\n"
+        "    JMP LOOP\n"
+        "LOOP:\n"
+        "    ADD %1, %1, 1\n"
+        "    JMP LOOP\n");
+    Execution run = interpret(fn, 1000);
+    EXPECT_FALSE(run.completed);
+    EXPECT_GT(run.stats.instructions, 1000u);
+    EXPECT_LE(run.stats.instructions, 1002u);
+    EXPECT_FALSE(sameBehaviour(run, run));
+}
+
+TEST(InterpreterTest, FallingOffBlock_Throws) {
+    Function fn = readIR("ion_interpret_fall.ion",
+        "ENTRY:\n"
+        "    MOV %1, 0\n");
+    EXPECT_THROW(interpret(fn), std::runtime_error);
+}
+
+TEST(InterpreterTest, Pipeline_ComparesRuns) {
+    Function fn = readIR("ion_interpret_pipeline.ion", kPressure);
+    auto cfg = parseTarget("class gpr r 2\n");
+    PipelineOptions opts{.target = &cfg->desc, .execute = true};
+    PipelineResult result = runPipeline(fn, opts);
+    EXPECT_NE(result.log.find("[INFO] Executed "), std::string::npos) << result.log;
+
+    // Without the verifier, a lost spill store is caught by its effect on the values computed
+    Function broken = readIR("ion_interpret_pipeline.ion", kPressure);
+    opts.verify = false;
+    opts.afterAllocation = [](Function& f, const Allocation&) {
+        for (auto& block : f.blocks) {
+            auto& code = block->instructions;
+            for (auto it = code.begin(); it != code.end(); ++it) {
+                if (it->spill && it->op == OpCode::STORE) {
+                    code.erase(it);
+                    return;
+                }
+            }
+        }
+    };
+    EXPECT_THROW(runPipeline(broken, opts), std::runtime_error);
+}
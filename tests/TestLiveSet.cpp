@@ -0,0 +1,140 @@
+#include "ion/LiveSet.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+std::vector<uint32_t> members(const LiveSet& s) {
+    std::vector<uint32_t> out;
+    s.forEach([&](uint32_t v) { out.push_back(v); });
+    return out;
+}
+
+std::vector<uint32_t> members(const std::set<uint32_t>& s) {
+    return {s.begin(), s.end()};
+}
+
+/* A random subset of [0, universe): a few names, one cluster or about half of everything */
+std::set<uint32_t> randomSubset(std::mt19937& rng, size_t universe) {
+    std::set<uint32_t> s;
+    std::uniform_int_distribution<uint32_t> name(0, static_cast<uint32_t>(universe - 1));
+    switch (rng() % 3) {
+    case 0:
+        for (int i = rng() % 8; i > 0; --i) s.insert(name(rng));
+        break;
+    case 1: {
+        uint32_t start = name(rng);
+        for (uint32_t v = start; v < universe && v < start + 200; ++v) {
+            if (rng() % 2) s.insert(v);
+        }
+        break;
+    }
+    default:
+        for (uint32_t v = 0; v < universe; ++v) {
+            if (rng() % 2) s.insert(v);
+        }
+        break;
+    }
+    return s;
+}
+
+LiveSet make(const std::set<uint32_t>& s, size_t universe) {
+    LiveSet set(universe);
+    std::vector<uint32_t> sorted(s.begin(), s.end());
+    set.assignSorted(sorted);
+    return set;
+}
+
+}   // namespace
+
+TEST(LiveSetTest, FormFollowsContents) {
+    LiveSet set(1024);
+    EXPECT_TRUE(set.empty());
+    EXPECT_EQ(set.kind(), LiveSet::Kind::Sparse);
+
+    std::vector<uint32_t> few{3, 500, 1000};
+    set.assignSorted(few);
+    EXPECT_EQ(set.kind(), LiveSet::Kind::Sparse);
+
+    std::vector<uint32_t> cluster;
+    for (uint32_t v = 128; v < 192; ++v) cluster.push_back(v);
+    set.assignSorted(cluster);
+    EXPECT_EQ(set.kind(), LiveSet::Kind::Chunked);
+
+    std::vector<uint32_t> all;
+    for (uint32_t v = 0; v < 1024; v += 2) all.push_back(v);
+    set.assignSorted(all);
+    EXPECT_EQ(set.kind(), LiveSet::Kind::Dense);
+    EXPECT_EQ(set.count(), 512u);
+
+    // Removing most of a dense set brings it back to a small form
+    LiveSet most(1024);
+    std::vector<uint32_t> allButOne(all.begin() + 1, all.end());
+    most.assignSorted(allButOne);
+    set -= most;
+    EXPECT_EQ(set.kind(), LiveSet::Kind::Sparse);
+    EXPECT_EQ(members(set), std::vector<uint32_t>{0});
+
+    set.clear();
+    EXPECT_TRUE(set.empty());
+}
+
+TEST(LiveSetTest, SmallUniversesAreDense) {
+    LiveSet set(64 * LiveSet::kDenseWords);
+    EXPECT_EQ(set.kind(), LiveSet::Kind::Dense);
+    std::vector<uint32_t> one{7};
+    set.assignSorted(one);
+    EXPECT_EQ(set.kind(), LiveSet::Kind::Dense);
+    EXPECT_TRUE(set.test(7));
+    EXPECT_FALSE(set.test(8));
+}
+
+TEST(LiveSetTest, MatchesSetAcrossForms) {
+    std::mt19937 rng(42);
+    for (size_t universe : {100u, 1000u, 5000u}) {
+        for (int round = 0; round < 200; ++round) {
+            std::set<uint32_t> a = randomSubset(rng, universe), b = randomSubset(rng, universe);
+            LiveSet x = make(a, universe), y = make(b, universe);
+            ASSERT_EQ(members(x), members(a));
+            ASSERT_EQ(x.count(), a.size());
+
+            LiveSet u(universe);
+            u = x;
+            u |= y;
+            std::set<uint32_t> expectUnion = a;
+            expectUnion.insert(b.begin(), b.end());
+            ASSERT_EQ(members(u), members(expectUnion));
+            // Equal contents reached by different routes compare equal
+            ASSERT_TRUE(u == make(expectUnion, universe));
+
+            LiveSet d(universe);
+            d = x;
+            d -= y;
+            std::set<uint32_t> expectDifference;
+            for (uint32_t v : a) {
+                if (!b.count(v)) expectDifference.insert(v);
+            }
+            ASSERT_EQ(members(d), members(expectDifference));
+            ASSERT_TRUE(d == make(expectDifference, universe));
+            for (uint32_t v = 0; v < universe; v += 37) ASSERT_EQ(d.test(v), expectDifference.count(v) == 1);
+
+            LiveSet n(universe);
+            n = x;
+            n &= y;
+            std::set<uint32_t> expectIntersection;
+            for (uint32_t v : a) {
+                if (b.count(v)) expectIntersection.insert(v);
+            }
+            ASSERT_EQ(members(n), members(expectIntersection));
+            ASSERT_TRUE(n == make(expectIntersection, universe));
+
+            x.swap(y);
+            ASSERT_EQ(members(x), members(b));
+            ASSERT_EQ(members(y), members(a));
+        }
+    }
+}
@@ -2,6 +2,9 @@
 #include "ion/Liveness.h"
 #include "ion/CFG.h"
 #include "ion/Reader.h"
+#include "ion/Stats.h"
+#include "ion/ThreadPool.h"
+#include "utils/h/IRGenerator.h"
 
 #include "utils/OutputStreamHandling.h"
 
@@ -52,8 +55,8 @@ TEST_F(LivenessAnalysisTest, GatherInitialInfo_SimpleLoop) {
         + UEVar = {}
         + VarKill = {%1}
      */
-    boost::dynamic_bitset<> VarKill_INIT_BLOCK = li.VarKill[0];
-    boost::dynamic_bitset<> UEVar_INIT_BLOCK = li.UEVar[0];
+    const LiveBits& VarKill_INIT_BLOCK = li.VarKill[0];
+    const LiveBits& UEVar_INIT_BLOCK = li.UEVar[0];
     ASSERT_TRUE(VarKill_INIT_BLOCK[1]);
     ASSERT_FALSE(UEVar_INIT_BLOCK[1]);
 
@@ -61,8 +64,8 @@ TEST_F(LivenessAnalysisTest, GatherInitialInfo_SimpleLoop) {
         + UEVar = {%1}
         + VarKill = {}
      */
-    boost::dynamic_bitset<> UEVar_main_block  = li.UEVar[1];
-    boost::dynamic_bitset<> VarKill_main_block  = li.VarKill[1];
+    const LiveBits& UEVar_main_block  = li.UEVar[1];
+    const LiveBits& VarKill_main_block  = li.VarKill[1];
     ASSERT_TRUE(UEVar_main_block[1]);
     ASSERT_FALSE(VarKill_main_block[1]);
 
@@ -70,8 +73,8 @@ TEST_F(LivenessAnalysisTest, GatherInitialInfo_SimpleLoop) {
         + UEVar = {%1}
         + VarKill = {%1}
      */
-    boost::dynamic_bitset<> VarKill_BLOCK_A = li.VarKill[2];
-    boost::dynamic_bitset<> UEVar_BLOCK_A  = li.UEVar[2];
+    const LiveBits& VarKill_BLOCK_A = li.VarKill[2];
+    const LiveBits& UEVar_BLOCK_A  = li.UEVar[2];
     ASSERT_TRUE(VarKill_BLOCK_A[1]);
     ASSERT_TRUE(UEVar_BLOCK_A[1]);
     ASSERT_FALSE(VarKill_BLOCK_A[0]);
@@ -106,8 +109,8 @@ TEST_F(LivenessAnalysisTest, Analyse_SimpleLoop) {
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {}
     */
 
-    std::set<int> LiveOut_INIT_BLOCK = lr.liveoutSet[0];
-    std::set<int> LiveIn_INIT_BLOCK = lr.liveinSet[0];
+    const auto& LiveOut_INIT_BLOCK = lr.liveoutSet[0];
+    const auto& LiveIn_INIT_BLOCK = lr.liveinSet[0];
     ASSERT_TRUE(LiveOut_INIT_BLOCK.count(1));
     ASSERT_FALSE(LiveIn_INIT_BLOCK.count(1));
 
@@ -118,8 +121,8 @@ TEST_F(LivenessAnalysisTest, Analyse_SimpleLoop) {
         + LiveOut ∩ ¬VarKill = {%1}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {%1}
     */
-    std::set<int> LiveOut_main_block = lr.liveoutSet[1];
-    std::set<int> LiveIn_main_block = lr.liveinSet[1];
+    const auto& LiveOut_main_block = lr.liveoutSet[1];
+    const auto& LiveIn_main_block = lr.liveinSet[1];
     ASSERT_TRUE(LiveOut_main_block.count(1));
     ASSERT_TRUE(LiveIn_main_block.count(1));
     ASSERT_FALSE(LiveOut_main_block.count(2));
@@ -132,8 +135,8 @@ TEST_F(LivenessAnalysisTest, Analyse_SimpleLoop) {
         + LiveOut ∩ ¬VarKill = {}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {%1}
     */
-    std::set<int> LiveOut_BLOCK_A = lr.liveoutSet[2];
-    std::set<int> LiveIn_BLOCK_A = lr.liveinSet[2];
+    const auto& LiveOut_BLOCK_A = lr.liveoutSet[2];
+    const auto& LiveIn_BLOCK_A = lr.liveinSet[2];
     ASSERT_TRUE(LiveOut_BLOCK_A.count(1));
     ASSERT_TRUE(LiveIn_BLOCK_A.count(1));
     ASSERT_FALSE(LiveOut_BLOCK_A.count(0));
@@ -159,8 +162,8 @@ TEST_F(LivenessAnalysisTest, Analyse_NestedLoop) {
         + LiveOut ∩ ¬VarKill = {}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {}
     */
-    std::set<int> LiveOut_INIT_BLOCK = lr.liveoutSet[0];
-    std::set<int> LiveIn_INIT_BLOCK = lr.liveinSet[0];
+    const auto& LiveOut_INIT_BLOCK = lr.liveoutSet[0];
+    const auto& LiveIn_INIT_BLOCK = lr.liveinSet[0];
     ASSERT_TRUE(LiveOut_INIT_BLOCK.count(1));
     ASSERT_TRUE(LiveOut_INIT_BLOCK.count(2));
     ASSERT_FALSE(LiveIn_INIT_BLOCK.count(1));
@@ -173,8 +176,8 @@ TEST_F(LivenessAnalysisTest, Analyse_NestedLoop) {
         + LiveOut ∩ ¬VarKill = {%1, %2}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {%1, %2}
     */
-    std::set<int> LiveOut_OUTER_BLOCK = lr.liveoutSet[1];
-    std::set<int> LiveIn_OUTER_BLOCK = lr.liveinSet[1];
+    const auto& LiveOut_OUTER_BLOCK = lr.liveoutSet[1];
+    const auto& LiveIn_OUTER_BLOCK = lr.liveinSet[1];
     ASSERT_TRUE(LiveOut_OUTER_BLOCK.count(1));
     ASSERT_TRUE(LiveOut_OUTER_BLOCK.count(2));
     ASSERT_TRUE(LiveIn_OUTER_BLOCK.count(1));
@@ -189,8 +192,8 @@ TEST_F(LivenessAnalysisTest, Analyse_NestedLoop) {
         + LiveOut ∩ ¬VarKill = {%2}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {%1, %2}
     */
-    std::set<int> LiveOut_OUTER_BODY = lr.liveoutSet[2];
-    std::set<int> LiveIn_OUTER_BODY = lr.liveinSet[2];
+    const auto& LiveOut_OUTER_BODY = lr.liveoutSet[2];
+    const auto& LiveIn_OUTER_BODY = lr.liveinSet[2];
     ASSERT_TRUE(LiveOut_OUTER_BODY.count(1));
     ASSERT_TRUE(LiveOut_OUTER_BODY.count(2));
     ASSERT_FALSE(LiveIn_OUTER_BODY.count(0));
@@ -203,8 +206,8 @@ TEST_F(LivenessAnalysisTest, Analyse_NestedLoop) {
         + LiveOut ∩ ¬VarKill = {%1, %2}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {%1, %2}
     */
-    std::set<int> LiveOut_INNER_BLOCK = lr.liveoutSet[2];
-    std::set<int> LiveIn_INNER_BLOCK = lr.liveinSet[2];
+    const auto& LiveOut_INNER_BLOCK = lr.liveoutSet[2];
+    const auto& LiveIn_INNER_BLOCK = lr.liveinSet[2];
     ASSERT_TRUE(LiveOut_INNER_BLOCK.count(1));
     ASSERT_TRUE(LiveOut_INNER_BLOCK.count(2));
     ASSERT_TRUE(LiveIn_INNER_BLOCK.count(1));
@@ -219,8 +222,8 @@ TEST_F(LivenessAnalysisTest, Analyse_NestedLoop) {
         + LiveOut ∩ ¬VarKill = {%1}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {%1, %2}
     */
-    std::set<int> LiveOut_INNER_BODY = lr.liveoutSet[2];
-    std::set<int> LiveIn_INNER_BODY = lr.liveinSet[2];
+    const auto& LiveOut_INNER_BODY = lr.liveoutSet[2];
+    const auto& LiveIn_INNER_BODY = lr.liveinSet[2];
     ASSERT_TRUE(LiveOut_INNER_BODY.count(1));
     ASSERT_TRUE(LiveOut_INNER_BODY.count(2));
     ASSERT_TRUE(LiveIn_INNER_BODY.count(1));
@@ -235,8 +238,8 @@ TEST_F(LivenessAnalysisTest, Analyse_NestedLoop) {
         + LiveOut ∩ ¬VarKill = {}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {%1, %2}
     */
-    std::set<int> LiveOut_RET_BLOCK = lr.liveoutSet[2];
-    std::set<int> LiveIn_RET_BLOCK = lr.liveinSet[2];
+    const auto& LiveOut_RET_BLOCK = lr.liveoutSet[2];
+    const auto& LiveIn_RET_BLOCK = lr.liveinSet[2];
     ASSERT_TRUE(LiveOut_RET_BLOCK.count(1));
     ASSERT_TRUE(LiveOut_RET_BLOCK.count(2));
     ASSERT_TRUE(LiveIn_RET_BLOCK.count(1));
@@ -255,8 +258,8 @@ TEST_F(LivenessAnalysisTest, Analyse_Diamond) {
         + LiveOut ∩ ¬VarKill = {}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {}
     */
-    std::set<int> LiveOut_INNIT_BLOCK = lr.liveoutSet[0];
-    std::set<int> LiveIn_INNIT_BLOCK = lr.liveinSet[0];
+    const auto& LiveOut_INNIT_BLOCK = lr.liveoutSet[0];
+    const auto& LiveIn_INNIT_BLOCK = lr.liveinSet[0];
     ASSERT_TRUE(LiveOut_INNIT_BLOCK.count(1));
     ASSERT_FALSE(LiveOut_INNIT_BLOCK.count(0));
     
@@ -267,7 +270,7 @@ TEST_F(LivenessAnalysisTest, Analyse_Diamond) {
         + LiveOut ∩ ¬VarKill = {}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {%1}
     */
-    std::set<int> LiveIn_MAIN_BLOCK = lr.liveinSet[1];
+    const auto& LiveIn_MAIN_BLOCK = lr.liveinSet[1];
     ASSERT_TRUE(LiveIn_MAIN_BLOCK.count(1));
 
     /** COND_1
@@ -277,8 +280,8 @@ TEST_F(LivenessAnalysisTest, Analyse_Diamond) {
         + LiveOut ∩ ¬VarKill = {}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {}
     */
-    std::set<int> LiveOut_COND1 = lr.liveoutSet[2];
-    std::set<int> LiveIn_COND1 = lr.liveinSet[2];
+    const auto& LiveOut_COND1 = lr.liveoutSet[2];
+    const auto& LiveIn_COND1 = lr.liveinSet[2];
     ASSERT_FALSE(LiveOut_COND1.count(1));
     ASSERT_FALSE(LiveIn_COND1.count(1));
 
@@ -289,8 +292,8 @@ TEST_F(LivenessAnalysisTest, Analyse_Diamond) {
         + LiveOut ∩ ¬VarKill = {}
         + UEVar ∪ (LiveOut ∩ ¬VarKill) = LiveIn = {}
     */
-    std::set<int> LiveOut_COND2 = lr.liveoutSet[3];
-    std::set<int> LiveIn_COND2 = lr.liveinSet[3];
+    const auto& LiveOut_COND2 = lr.liveoutSet[3];
+    const auto& LiveIn_COND2 = lr.liveinSet[3];
     ASSERT_FALSE(LiveOut_COND2.count(1));
     ASSERT_FALSE(LiveIn_COND2.count(1));
 
@@ -304,6 +307,65 @@ TEST_F(LivenessAnalysisTest, Analyse_Diamond) {
     */
 }
 
+TEST(SlicedLivenessTest, SlicesMatchTheSequentialSolve) {
+    GeneratorOptions opts;
+    opts.seed = 5;
+    opts.instructions = 6000;
+    opts.vregs = 600;
+    opts.pressure = 300;
+    Reader reader;
+    Function fn = reader.BuildCFGFromSource(generateIR(opts), "f");
+
+    Stats s;
+    stats::enable(&s);
+    LivenessResult sequential = LivenessAnalysis().analyse(fn);
+    stats::enable(nullptr);
+    // Enough words for each of the four workers to get a slice
+    ASSERT_GT(s.count(Counter::GlobalNames), 3u * 64);
+
+    ThreadPool pool(4);
+    LivenessAnalysis sliced;
+    sliced.parallelSolve(&pool, 0);
+    LivenessResult parallel = sliced.analyse(fn);
+    EXPECT_EQ(parallel.liveoutSet, sequential.liveoutSet);
+    EXPECT_EQ(parallel.liveinSet, sequential.liveinSet);
+}
+
+TEST(SlicedLivenessTest, BlockLocalNamesStayOutOfTheSets) {
+    Reader reader;
+    Function fn = reader.BuildCFGFromSource(
+        "A:\n    MOV %1, 1\n    MOV %2, 2\n    ADD %3, %2, %2\n    JMP B\n"
+        "B:\n    ADD %4, %1, %1\n    MOV %2, %4\n    RET\n", "f");
+    LivenessResult lr = LivenessAnalysis().analyse(fn);
+    EXPECT_EQ(lr.liveoutSet[0], std::pmr::set<int>({1}));
+    EXPECT_EQ(lr.liveinSet[1], std::pmr::set<int>({1}));
+    EXPECT_TRUE(lr.liveinSet[0].empty());
+    EXPECT_TRUE(lr.liveoutSet[1].empty());
+}
+
+TEST(SlicedLivenessTest, AcyclicBlocksAreVisitedOnce) {
+    // A -> B -> C in a line, then a loop C -> D -> C
+    Reader reader;
+    Function fn = reader.BuildCFGFromSource(
+        "A:\n    MOV %1, 1\n    MOV %2, 2\n    JMP B\n"
+        "B:\n    ADD %3, %1, %2\n    JMP C\n"
+        "C:\n    ADD %3, %3, %1\n    JMP D\n"
+        "D:\n    BEQ %3, %2, C, E\n"
+        "E:\n    RET\n", "f");
+    Stats s;
+    stats::enable(&s);
+    LivenessResult lr = LivenessAnalysis().analyse(fn);
+    stats::enable(nullptr);
+
+    // A, B and E once each; C and D until the loop settles: %2 and %1 each take a pass to go
+    // round it, and a last pass finds nothing changed
+    EXPECT_EQ(s.count(Counter::LivenessIterations), 3u);
+    EXPECT_EQ(s.count(Counter::LivenessVisits), 3u + 2 * 3);
+    EXPECT_EQ(lr.liveinSet[2], std::pmr::set<int>({1, 2, 3}));
+    EXPECT_EQ(lr.liveoutSet[3], std::pmr::set<int>({1, 2, 3}));
+    EXPECT_EQ(lr.liveoutSet[1], std::pmr::set<int>({1, 2, 3}));
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     auto& listeners = ::testing::UnitTest::GetInstance()->listeners();
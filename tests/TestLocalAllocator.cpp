@@ -0,0 +1,131 @@
+#include "ion/CFG.h"
+#include "ion/InterferenceGraph.h"
+#include "ion/Liveness.h"
+#include "ion/LocalAllocator.h"
+#include "ion/Reader.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Stats.h"
+#include "ion/Target.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/* No two VRs that interfere in the allocated function share a register */
+void expectNoInterference(Function& fn, const Allocation& alloc, const TargetDesc& target) {
+    LivenessAnalysis la;
+    LivenessResult lr = la.analyse(fn);
+    std::vector<unsigned> classBank;
+    for (unsigned c = 0; c < target.numClasses; ++c)
+        classBank.push_back(target.classes[c].bank);
+
+    for (unsigned bank = 0; bank < target.numBanks(); ++bank) {
+        InterferenceGraph g = buildInterferenceGraph(fn, lr, alloc.regClass, classBank, bank);
+        for (int n : g.nodes()) {
+            ASSERT_GE(alloc.reg[n], 0) << "%" << n << " has no register";
+            for (int m : g.neighbours(n))
+                EXPECT_NE(alloc.reg[n], alloc.reg[m]) << "%" << n << " and %" << m;
+        }
+    }
+}
+
+std::vector<const Instruction*> spillCode(const Function& fn, OpCode op) {
+    std::vector<const Instruction*> found;
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions) {
+            if (instr.spill && instr.op == op) found.push_back(&instr);
+        }
+    }
+    return found;
+}
+
+}   // namespace
+
+TEST(LocalAllocatorTest, SelectedOnlyWithoutMerges) {
+    Reader reader;
+    EXPECT_TRUE(hasNoMerges(reader.BuildCFG("docs/iON_IR/StraightLineDAG.ion")));
+    for (const char* file : {"docs/iON_IR/SimpleLoop.ion", "docs/iON_IR/NestedLoop.ion", "docs/iON_IR/Diamond.ion"}) {
+        SCOPED_TRACE(file);
+        EXPECT_FALSE(hasNoMerges(reader.BuildCFG(file)));
+    }
+}
+
+TEST(LocalAllocatorTest, SkipsGlobalAnalysis) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/StraightLineDAG.ion");
+    Stats s;
+    stats::enable(&s);
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    stats::enable(nullptr);
+
+    EXPECT_EQ(s.calls(Phase::LocalAllocation), 1u);
+    EXPECT_EQ(s.calls(Phase::Liveness), 0u);
+    EXPECT_EQ(s.calls(Phase::InterferenceGraph), 0u);
+    EXPECT_EQ(alloc.rounds, 1u);
+    EXPECT_EQ(alloc.spilledVRegs, 0u);
+    expectNoInterference(fn, alloc, targets::RISC16);
+}
+
+TEST(LocalAllocatorTest, SpillsFarthestNextUse) {
+    Function fn = readIR("ion_local_spill.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    MOV %3, 3\n"
+        "    ADD %4, %2, %3\n"
+        "    ADD %5, %4, %1\n"
+        "    RET\n");
+    auto cfg = parseTarget("class gpr r 2\n");
+    Allocation alloc = RegisterAllocator(cfg->desc).allocate(fn);
+
+    // %1 is next used after %2, so it is the one stored to make room for %3
+    auto stores = spillCode(fn, OpCode::STORE);
+    auto loads = spillCode(fn, OpCode::LOAD);
+    ASSERT_EQ(stores.size(), 1u);
+    ASSERT_EQ(loads.size(), 1u);
+    EXPECT_EQ(alloc.origin[std::get<VReg>(stores[0]->operands[0]).id], 1);
+    EXPECT_EQ(alloc.origin[loads[0]->def->id], 1);
+    EXPECT_EQ(alloc.spilledVRegs, 1u);
+    EXPECT_EQ(alloc.numSpillSlots, 1);
+    EXPECT_EQ(alloc.rounds, 1u);
+    expectNoInterference(fn, alloc, cfg->desc);
+}
+
+TEST(LocalAllocatorTest, BranchesStartFromTheSameRegisters) {
+    // %1 is spilled only on the THEN side; ELSE must still find it in its register
+    Function fn = readIR("ion_local_branch.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    BEQ %2, 2, THEN, ELSE\n"
+        "THEN:\n"
+        "    MOV %3, 3\n"
+        "    MOV %4, 4\n"
+        "    ADD %5, %3, %4\n"
+        "    ADD %6, %5, %1\n"
+        "    RET\n"
+        "ELSE:\n"
+        "    ADD %7, %1, %2\n"
+        "    RET\n");
+    auto cfg = parseTarget("class gpr r 2\n");
+    Allocation alloc = RegisterAllocator(cfg->desc).allocate(fn);
+
+    BasicBlock* elseBlock = fn.labelToBlock.at("ELSE");
+    for (const auto& instr : elseBlock->instructions)
+        EXPECT_FALSE(instr.spill);
+    EXPECT_FALSE(spillCode(fn, OpCode::STORE).empty());
+    expectNoInterference(fn, alloc, cfg->desc);
+}
+
+TEST(LocalAllocatorTest, TooFewRegistersThrows) {
+    Function fn = readIR("ion_local_tight.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    ADD %3, %1, %2\n"
+        "    RET\n");
+    auto cfg = parseTarget("class gpr r 1\n");
+    EXPECT_THROW(RegisterAllocator(cfg->desc).allocate(fn), std::runtime_error);
+}
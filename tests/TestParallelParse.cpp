@@ -0,0 +1,88 @@
+#include "ion/Reader.h"
+#include "ion/ThreadPool.h"
+#include "ion/Writer.h"
+#include "utils/h/IRGenerator.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::string bigSource() {
+    GeneratorOptions opts;
+    opts.seed = 11;
+    opts.instructions = 40000;
+    opts.blocks = 2000;
+    std::string source = generateIR(opts);
+    // Something before the first label, which both parses skip
+    return "   \n" + source;
+}
+
+std::string dump(const Function& fn) {
+    std::string out;
+    Writer writer(out);
+    writer.write(fn);
+    writer.flush();
+    for (const auto& block : fn.blocks) {
+        out += std::to_string(block->id) + ":";
+        for (const BasicBlock* s : block->successors) out += " s" + std::to_string(s->id);
+        for (const BasicBlock* p : block->predecessors) out += " p" + std::to_string(p->id);
+        out += "\n";
+    }
+    return out;
+}
+
+/* Parses in chunks however small the input */
+Function parseParallel(std::string_view source, ThreadPool& pool) {
+    Reader reader;
+    reader.parallelParse(&pool, 0);
+    return reader.BuildCFGFromSource(source, "f");
+}
+
+}   // namespace
+
+TEST(ParallelParseTest, MatchesSequentialParse) {
+    std::string source = bigSource();
+    ASSERT_GT(source.size(), 3 * (256u << 10));   // several chunks
+    Function sequential = Reader().BuildCFGFromSource(source, "f");
+
+    for (unsigned workers : {1u, 3u, 8u}) {
+        SCOPED_TRACE(workers);
+        ThreadPool pool(workers);
+        Function parallel = parseParallel(source, pool);
+        ASSERT_EQ(parallel.blocks.size(), sequential.blocks.size());
+        EXPECT_EQ(parallel.labelToBlock.size(), sequential.labelToBlock.size());
+        EXPECT_EQ(dump(parallel), dump(sequential));
+    }
+}
+
+TEST(ParallelParseTest, ReportsTheFirstErrorInFileOrder) {
+    std::string source = bigSource();
+    // Two bad instructions far apart, so they land in different chunks
+    source.insert(source.find('\n', source.size() / 4) + 1, "    FROB %1\n");
+    source.insert(source.find('\n', source.size() * 3 / 4) + 1, "    ZAP %1\n");
+
+    std::string expected;
+    try {
+        Reader().BuildCFGFromSource(source, "f");
+    } catch (const std::exception& e) {
+        expected = e.what();
+    }
+    ASSERT_FALSE(expected.empty());
+
+    ThreadPool pool(4);
+    try {
+        parseParallel(source, pool);
+        FAIL() << "expected a parse error";
+    } catch (const std::exception& e) {
+        EXPECT_EQ(std::string(e.what()), expected);
+    }
+}
+
+TEST(ParallelParseTest, SmallInputsStaySequential) {
+    ThreadPool pool(4);
+    Reader reader;
+    reader.parallelParse(&pool);
+    GeneratorOptions opts;
+    Function fn = reader.BuildCFGFromSource(generateIR(opts), "f");
+    EXPECT_FALSE(fn.blocks.empty());
+}
@@ -0,0 +1,169 @@
+#include "ion/Reader.h"
+#include "ion/Writer.h"
+#include "utils/h/Parser.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace {
+
+std::string write(const Function& fn) {
+    std::string out;
+    Writer writer(out);
+    writer.write(fn);
+    writer.flush();
+    return out;
+}
+
+Function read(std::string_view source) {
+    Reader reader;
+    return reader.BuildCFGFromSource(source, "f");
+}
+
+}   // namespace
+
+TEST(ParserTest, EveryMnemonicTheWriterPrintsIsParsed) {
+    for (size_t i = 0; i < mnemonics::kOpCodes; ++i) {
+        auto op = static_cast<OpCode>(i);
+        const mnemonics::Entry* entry = mnemonics::lookup(mnemonic(op));
+        ASSERT_NE(entry, nullptr) << mnemonic(op);
+        EXPECT_EQ(entry->op, op);
+    }
+    for (std::string_view bogus : {"LOADI", "NZ", "DIV", "BNE", "ADDX", "A", "beq"})
+        EXPECT_EQ(mnemonics::lookup(bogus), nullptr) << bogus;
+}
+
+TEST(ParserTest, LoadStoreAndSingleRegisterBranchesRoundTrip) {
+    const std::string source =
+        "ENTRY:\n"
+        "    LOAD %1, 100\n"
+        "    STORE %1, 104\n"
+        "    BZ %1, A, B\n"
+        "\n"
+        "A:\n"
+        "    BNZ %1, B, ENTRY\n"
+        "\n"
+        "B:\n"
+        "    RET\n"
+        "\n";
+    Function fn = read(source);
+    EXPECT_EQ(write(fn), source);
+
+    const auto& entry = fn.blocks[0]->instructions;
+    EXPECT_EQ(entry[0].op, OpCode::LOAD);
+    EXPECT_EQ(entry[0].def->id, 1);
+    EXPECT_EQ(std::get<int>(entry[0].operands[0]), 100);
+    EXPECT_EQ(entry[1].op, OpCode::STORE);
+    EXPECT_FALSE(entry[1].def.has_value());
+    EXPECT_EQ(std::get<VReg>(entry[1].operands[0]).id, 1);
+    EXPECT_EQ(std::get<int>(entry[1].operands[1]), 104);
+
+    // Both targets of BZ/BNZ are successors
+    ASSERT_EQ(fn.blocks[0]->successors.size(), 2u);
+    EXPECT_EQ(fn.blocks[0]->successors[1]->label, "B");
+    ASSERT_EQ(fn.blocks[1]->successors.size(), 2u);
+    EXPECT_EQ(fn.blocks[1]->successors[1]->label, "ENTRY");
+    EXPECT_EQ(fn.blocks[0]->predecessors.size(), 1u);
+}
+
+TEST(ParserTest, RejectsUnknownAndIncompleteInstructions) {
+    EXPECT_THROW(read("L:\n    LOADI %1, 4\n"), std::invalid_argument);
+    EXPECT_THROW(read("L:\n    ADD %1, %2\n"), std::invalid_argument);
+    EXPECT_THROW(read("L:\n    BEQ %1, %2, L\n"), std::invalid_argument);
+    EXPECT_THROW(read("L:\n    JMP NOWHERE\n"), std::invalid_argument);
+}
+
+TEST(ParserTest, SpillSlotsRoundTrip) {
+    // What the Writer prints for a function that has been spilled but not yet given registers
+    const std::string source =
+        "ENTRY:\n"
+        "    MOV %1, 7\n"
+        "    STORE %1, [slot0]\n"
+        "    LOAD %2, [slot0]\n"
+        "    STORE %2, 12\n"
+        "    RET\n"
+        "\n";
+    Function fn = read(source);
+    EXPECT_EQ(write(fn), source);
+
+    const auto& code = fn.blocks[0]->instructions;
+    EXPECT_TRUE(code[1].spill);
+    EXPECT_EQ(std::get<VReg>(code[1].operands[0]).id, 1);
+    EXPECT_EQ(std::get<int>(code[1].operands[1]), 0);
+    EXPECT_TRUE(code[2].spill);
+    EXPECT_EQ(code[2].def->id, 2);
+    EXPECT_EQ(std::get<int>(code[2].operands[0]), 0);
+    EXPECT_FALSE(code[3].spill);
+}
+
+TEST(ParserTest, RejectsMisplacedSpillSlots) {
+    EXPECT_THROW(read("L:\n    MOV %1, [slot0]\n"), std::invalid_argument);
+    EXPECT_THROW(read("L:\n    ADD %1, %2, [slot0]\n"), std::invalid_argument);
+    EXPECT_THROW(read("L:\n    STORE [slot0], [slot1]\n"), std::invalid_argument);
+    EXPECT_THROW(read("L:\n    LOAD %1, [slot]\n"), std::invalid_argument);
+    EXPECT_THROW(read("L:\n    LOAD %1, [slot-1]\n"), std::invalid_argument);
+    EXPECT_THROW(read("L:\n    LOAD %1, [stack2]\n"), std::invalid_argument);
+}
+
+TEST(ParserTest, RejectsBadVirtualRegisters) {
+    for (const char* line : {"    MOV %-1, 3", "    ADD %1, %-5, 2", "    MOV %abc, 1", "    ADD %1, %abc, 2",
+                             "    MOV %, 1", "    MOV %1x, 1", "    MOV %2147483648, 1", "    MOV 4, 1"}) {
+        SCOPED_TRACE(line);
+        std::optional<ParsedInstr> parsed = InstrParser().parse(line);
+        ASSERT_TRUE(parsed.has_value());
+        EXPECT_EQ(parsed->form, ParsedInstr::Malformed);
+        EXPECT_THROW(read(std::string("B0:\n") + line + "\n    RET\n"), std::invalid_argument);
+    }
+    std::optional<ParsedInstr> largest = InstrParser().parse("MOV %2147483647, %0");
+    ASSERT_TRUE(largest.has_value());
+    EXPECT_EQ(largest->form, ParsedInstr::Copy);
+    EXPECT_EQ(largest->def->id, 2147483647);
+}
+
+TEST(ParserTest, VectorisedTokenizerAgreesWithScalar) {
+    std::mt19937 rng(7);
+    const std::string_view alphabet = " ,\t%AZ09-_:";
+    for (int trial = 0; trial < 20000; ++trial) {
+        std::string line(rng() % 80, ' ');
+        for (char& c : line) c = alphabet[rng() % alphabet.size()];
+
+        InstrParser::Tokens simd, scalar;
+        int n = InstrParser::tokenize(line, simd);
+        ASSERT_EQ(n, InstrParser::tokenizeScalar(line, scalar)) << '"' << line << '"';
+        for (int t = 0; t < n; ++t) {
+            ASSERT_EQ(simd[t], scalar[t]) << '"' << line << '"';
+            // The same characters of the line, not a copy
+            ASSERT_EQ(simd[t].data(), scalar[t].data());
+        }
+    }
+}
+
+TEST(ParserTest, WholeTextParseMatchesLineByLine) {
+    std::mt19937 rng(3);
+    const std::vector<std::string> pieces = {"ADD", "MOV", "BEQ", "BZ", "RET", "JMP", "LOAD", "STORE", "FROB",
+                                             "%12", "-7", "[slot3]", "[slot", "L1:", "L:", ":", ",", " ", "\t", "  ", "\n", "\n", "\n"};
+    for (int trial = 0; trial < 500; ++trial) {
+        std::string text;
+        while (text.size() < 300) text += pieces[rng() % pieces.size()] + (rng() % 2 ? " " : ", ");
+        text.resize(rng() % text.size());
+
+        auto same = [](const ParsedInstr& a, const ParsedInstr& b) {
+            return a.form == b.form && a.opcode == b.opcode && a.label == b.label && a.def == b.def &&
+                   a.uses == b.uses && a.targets == b.targets && a.spill == b.spill && (a.form == ParsedInstr::LabelDef || a.op == b.op);
+        };
+        std::vector<ParsedInstr> expected;
+        InstrParser parser;
+        for (size_t pos = 0; pos <= text.size();) {
+            size_t eol = std::min(text.find('\n', pos), text.size());
+            if (auto parsed = parser.parse(std::string_view(text).substr(pos, eol - pos))) expected.push_back(*parsed);
+            pos = eol + 1;
+        }
+        size_t i = 0;
+        parser.parseText(text, [&](const ParsedInstr& parsed) {
+            ASSERT_LT(i, expected.size());
+            EXPECT_TRUE(same(parsed, expected[i++])) << '"' << text << '"';
+        });
+        EXPECT_EQ(i, expected.size());
+    }
+}
@@ -0,0 +1,117 @@
+#include "ion/CFG.h"
+#include "ion/Reader.h"
+#include "ion/Peephole.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Target.h"
+#include "ion/Writer.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+
+namespace {
+
+Instruction mov(int d, int s) {
+    return Instruction{.op = OpCode::MOV, .def = VReg{d}, .operands = {VReg{s}, std::monostate{}}};
+}
+Instruction add(int d, int a, int b) {
+    return Instruction{.op = OpCode::ADD, .def = VReg{d}, .operands = {VReg{a}, VReg{b}}};
+}
+Instruction reload(int d, int slot) {
+    return Instruction{.op = OpCode::LOAD, .def = VReg{d}, .operands = {slot, std::monostate{}}, .spill = true};
+}
+Instruction store(int s, int slot) {
+    return Instruction{.op = OpCode::STORE, .operands = {VReg{s}, slot}, .spill = true};
+}
+
+/* One block; VR i is given register regs[i] */
+struct Fixture {
+    Function fn;
+    Allocation alloc;
+
+    Fixture(std::vector<Instruction> code, std::vector<int> regs, int slots) {
+        auto block = std::make_unique<BasicBlock>();
+        block->id = 0;
+        block->label = "ENTRY";
+        block->instructions.assign(code.begin(), code.end());
+        block->instructions.push_back(Instruction{.op = OpCode::RET});
+        fn.blocks.push_back(std::move(block));
+
+        alloc.reg = std::move(regs);
+        alloc.regClass.assign(alloc.reg.size(), 0);
+        for (size_t v = 0; v < alloc.reg.size(); ++v) alloc.origin.push_back(static_cast<int>(v));
+        alloc.numSpillSlots = slots;
+    }
+
+    std::pmr::vector<Instruction>& code() { return fn.blocks[0]->instructions; }
+
+    std::string written() {
+        std::string out;
+        Writer writer(out);
+        writer.write(fn, alloc, targets::RISC16);
+        writer.flush();
+        return out;
+    }
+};
+
+TEST(PeepholeTest, SelfMoveLeftForWriter) {
+    Fixture f({mov(1, 2), add(3, 1, 1)}, {-1, 4, 4, 5}, 0);
+    PeepholeStats stats = runPeephole(f.fn, f.alloc, targets::RISC16);
+
+    EXPECT_EQ(stats.selfMoves, 1u);
+    EXPECT_EQ(stats.instructionsRemoved(), 1u);
+    ASSERT_EQ(f.code().size(), 3u);
+    EXPECT_EQ(f.code()[0].op, OpCode::MOV);
+
+    std::string text = f.written();
+    EXPECT_EQ(text.find("MOV"), std::string::npos) << text;
+    EXPECT_NE(text.find("ADD"), std::string::npos) << text;
+}
+
+TEST(PeepholeTest, ReloadForwarded) {
+    // %1 in r1 is spilled to slot 0; %2 reloads into r1, %3 into r2
+    Fixture f({add(1, 4, 4), store(1, 0), reload(2, 0), reload(3, 0), add(5, 2, 3)},
+              {-1, 1, 1, 2, 3, 4}, 1);
+    PeepholeStats stats = runPeephole(f.fn, f.alloc, targets::RISC16);
+
+    EXPECT_EQ(stats.reloadsRemoved, 1u);
+    EXPECT_EQ(stats.reloadsToCopies, 1u);
+    // No reload of slot 0 is left, so the store is dead as well
+    EXPECT_EQ(stats.deadStores, 1u);
+    EXPECT_EQ(stats.memoryOpsRemoved(), 3u);
+
+    ASSERT_EQ(f.code().size(), 4u);
+    EXPECT_EQ(f.code()[1].op, OpCode::MOV);
+    EXPECT_EQ(std::get<VReg>(f.code()[1].operands[0]).id, 1);
+}
+
+TEST(PeepholeTest, ClobberedRegisterIsReloaded) {
+    Fixture f({store(1, 0), add(2, 4, 4), reload(3, 0), add(5, 3, 2)},
+              {-1, 1, 1, 2, 3, 4}, 1);
+    PeepholeStats stats = runPeephole(f.fn, f.alloc, targets::RISC16);
+
+    // %2 overwrote r1, so the reload must stay and so must the store
+    EXPECT_EQ(stats.memoryOpsRemoved(), 0u);
+    EXPECT_EQ(f.code().size(), 5u);
+}
+
+TEST(PeepholeTest, OverwrittenStoreIsDead) {
+    Fixture f({store(1, 0), add(2, 4, 4), store(2, 0), reload(3, 0), add(5, 3, 3)},
+              {-1, 1, 2, 3, 4, 5}, 1);
+    PeepholeStats stats = runPeephole(f.fn, f.alloc, targets::RISC16);
+
+    // The first store is overwritten, the second is only read by a forwarded reload
+    EXPECT_EQ(stats.deadStores, 2u);
+    EXPECT_EQ(stats.reloadsToCopies, 1u);
+    EXPECT_EQ(f.code()[0].op, OpCode::ADD);
+}
+
+TEST(PeepholeTest, CleanAllocationUntouched) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/NestedLoop.ion");
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    PeepholeStats stats = runPeephole(fn, alloc, targets::RISC16);
+    EXPECT_EQ(stats.instructionsRemoved(), 0u);
+    EXPECT_EQ(stats.memoryOpsRemoved(), 0u);
+}
+
+}
@@ -0,0 +1,250 @@
+#include "ion/CFG.h"
+#include "ion/Reader.h"
+#include "ion/Liveness.h"
+#include "ion/InterferenceGraph.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/RegisterPressure.h"
+#include "ion/SpillHeuristic.h"
+#include "ion/Stats.h"
+#include "ion/Target.h"
+#include "ion/ThreadPool.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/*
+    Re-derives interference on the allocated function and checks that
+    no two interfering VRs share a register, and that no VR was given a
+    reserved register.
+**/
+void expectValidAllocation(Function& fn, const Allocation& alloc, const TargetDesc& target) {
+    LivenessAnalysis la;
+    LivenessResult lr = la.analyse(fn);
+    std::vector<unsigned> classBank;
+    for (unsigned c = 0; c < target.numClasses; ++c)
+        classBank.push_back(target.classes[c].bank);
+
+    for (unsigned bank = 0; bank < target.numBanks(); ++bank) {
+        InterferenceGraph g = buildInterferenceGraph(fn, lr, alloc.regClass, classBank, bank);
+        for (int n : g.nodes()) {
+            ASSERT_GE(alloc.reg[n], 0) << "%" << n << " has no register";
+            EXPECT_TRUE(target.allocatable(bank) >> alloc.reg[n] & 1) << "%" << n;
+            for (int m : g.neighbours(n))
+                EXPECT_NE(alloc.reg[n], alloc.reg[m]) << "%" << n << " and %" << m;
+        }
+    }
+}
+
+/* Spill instructions, each weighted by 10^depth of its loop nest */
+float weightedSpillCode(const Function& fn) {
+    std::vector<float> weight = blockWeights(loopDepths(fn));
+    float total = 0.0f;
+    for (size_t b = 0; b < fn.blocks.size(); ++b) {
+        for (const auto& instr : fn.blocks[b]->instructions)
+            total += instr.spill ? weight[b] : 0.0f;
+    }
+    return total;
+}
+
+TEST(RegisterAllocatorTest, SamplePrograms_NoSpills) {
+    for (const char* file : {"docs/iON_IR/StraightLineDAG.ion", "docs/iON_IR/SimpleLoop.ion",
+                             "docs/iON_IR/NestedLoop.ion", "docs/iON_IR/Diamond.ion"}) {
+        SCOPED_TRACE(file);
+        Reader reader;
+        Function fn = reader.BuildCFG(file);
+        RegisterAllocator allocator(targets::RISC16);
+        Allocation alloc = allocator.allocate(fn);
+
+        EXPECT_EQ(alloc.spilledVRegs, 0u);
+        EXPECT_EQ(alloc.rounds, 1u);
+        expectValidAllocation(fn, alloc, targets::RISC16);
+    }
+}
+
+TEST(RegisterAllocatorTest, PrefersCallerSaved) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/NestedLoop.ion");
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    for (int v : {1, 2, 3})
+        EXPECT_TRUE(targets::RISC16.classes[0].callerSaved >> alloc.reg[v] & 1) << "%" << v;
+}
+
+TEST(RegisterAllocatorTest, CoalescesCopies) {
+    Function fn = readIR("ion_coalesce.ion",
+        "ENTRY:\n"
+        "    MOV %1, 7\n"
+        "    MOV %2, %1\n"
+        "    ADD %3, %2, 1\n"
+        "    RET\n");
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    EXPECT_EQ(alloc.coalescedCopies, 1u);
+    EXPECT_EQ(alloc.reg[1], alloc.reg[2]);
+}
+
+TEST(RegisterAllocatorTest, HighPressure_Spills) {
+    // The loop makes LOOP a merge, so the graph allocator handles it
+    Function fn = readIR("ion_pressure.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    MOV %3, 3\n"
+        "    JMP LOOP\n"
+        "LOOP:\n"
+        "    ADD %4, %1, %2\n"
+        "    ADD %5, %4, %3\n"
+        "    ADD %6, %5, %1\n"
+        "    BEQ %6, 0, EXIT, LOOP\n"
+        "EXIT:\n"
+        "    RET\n");
+    auto cfg = parseTarget("class gpr r 2\n");
+    Allocation alloc = RegisterAllocator(cfg->desc).allocate(fn);
+
+    EXPECT_GT(alloc.spilledVRegs, 0u);
+    EXPECT_GT(alloc.numSpillSlots, 0);
+    EXPECT_GT(alloc.rounds, 1u);
+
+    size_t spillOps = 0;
+    for (const auto& block : fn.blocks) {
+        for (const auto& instr : block->instructions)
+            spillOps += instr.spill;
+    }
+    EXPECT_GT(spillOps, 0u);
+    expectValidAllocation(fn, alloc, cfg->desc);
+}
+
+TEST(RegisterAllocatorTest, IndependentBanks) {
+    Function fn = readIR("ion_banks.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %10001, 2\n"
+        "    ADD %2, %1, 1\n"
+        "    ADD %10002, %10001, %10001\n"
+        "    BEQ %2, 5, ENTRY, EXIT\n"
+        "EXIT:\n"
+        "    RET\n");
+    Allocation alloc = RegisterAllocator(targets::X86_64).allocate(fn);
+
+    EXPECT_EQ(alloc.regClass[1], 0);
+    EXPECT_EQ(alloc.regClass[10001], 1);
+    expectValidAllocation(fn, alloc, targets::X86_64);
+}
+
+
+TEST(RegisterAllocatorTest, PressurePerBlock) {
+    Function fn = readIR("ion_pressure_blocks.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    MOV %3, 3\n"
+        "    ADD %4, %1, %2\n"
+        "    JMP EXIT\n"
+        "EXIT:\n"
+        "    ADD %5, %4, %3\n"
+        "    RET\n");
+    LivenessAnalysis la;
+    LivenessResult lr = la.analyse(fn);
+    std::vector<uint8_t> regClass(6, 0);
+    RegisterPressure pressure = computePressure(fn, lr, regClass, {0}, 0);
+
+    ASSERT_EQ(pressure.block.size(), 2u);
+    EXPECT_EQ(pressure.block[0], 3u);      // %1, %2 and %3 before the first ADD
+    EXPECT_EQ(pressure.block[1], 2u);
+    EXPECT_EQ(pressure.max, 3u);
+
+    std::vector<unsigned> excess = excessBlocks(fn, lr, pressure, 2, regClass, {0}, 0);
+    EXPECT_EQ(excess[3], 1u);
+    EXPECT_EQ(excess[5], 0u);
+}
+
+TEST(RegisterAllocatorTest, LowPressure_SkipsGraph) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/NestedLoop.ion");
+    Stats s;
+    stats::enable(&s);
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    stats::enable(nullptr);
+
+    EXPECT_EQ(s.count(Counter::FastPathBanks), 1u);
+    EXPECT_EQ(s.calls(Phase::InterferenceGraph), 0u);
+    EXPECT_EQ(s.calls(Phase::Coloring), 0u);
+    expectValidAllocation(fn, alloc, targets::RISC16);
+}
+
+TEST(RegisterAllocatorTest, HighPressure_UsesGraph) {
+    Function fn = readIR("ion_pressure_graph.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    MOV %3, 3\n"
+        "    JMP LOOP\n"
+        "LOOP:\n"
+        "    ADD %4, %1, %2\n"
+        "    ADD %5, %4, %3\n"
+        "    BEQ %5, 0, EXIT, LOOP\n"
+        "EXIT:\n"
+        "    RET\n");
+    auto cfg = parseTarget("class gpr r 2\n");
+    Stats s;
+    stats::enable(&s);
+    Allocation alloc = RegisterAllocator(cfg->desc).allocate(fn);
+    stats::enable(nullptr);
+
+    // The first round is over k and goes through the graph; once spilled, the rest fit
+    EXPECT_GE(s.calls(Phase::Coloring), 1u);
+    EXPECT_EQ(s.calls(Phase::Coloring) + s.count(Counter::FastPathBanks), alloc.rounds);
+    expectValidAllocation(fn, alloc, cfg->desc);
+}
+
+TEST(RegisterAllocatorTest, SpeculativeSpills_KeepCheapest) {
+    // %1 is used often outside the loop and once in it, %2 and %3 only in it
+    const char* source =
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    MOV %3, 3\n"
+        "    ADD %7, %1, %1\n"
+        "    ADD %7, %7, %1\n"
+        "    ADD %7, %7, %1\n"
+        "    JMP LOOP\n"
+        "LOOP:\n"
+        "    ADD %4, %2, %3\n"
+        "    ADD %5, %4, %1\n"
+        "    BEQ %5, 0, EXIT, LOOP\n"
+        "EXIT:\n"
+        "    ADD %6, %7, %1\n"
+        "    RET\n";
+    auto cfg = parseTarget("class gpr r 3\n");
+
+    Function plain = readIR("ion_speculative_plain.ion", source);
+    RegisterAllocator(cfg->desc).allocate(plain);
+
+    Function fn = readIR("ion_speculative.ion", source);
+    RegisterAllocator allocator(cfg->desc);
+    allocator.speculativeSpills(true);
+    Stats s;
+    stats::enable(&s);
+    Allocation alloc = allocator.allocate(fn);
+    stats::enable(nullptr);
+
+    unsigned contested = 0;
+    for (size_t h = 0; h < kNumSpillHeuristics; ++h) {
+        contested += alloc.spillWins[h];
+        EXPECT_EQ(s.count(static_cast<Counter>(static_cast<size_t>(Counter::SpillWinsCostDegree) + h)),
+                  alloc.spillWins[h]);
+    }
+    EXPECT_GE(contested, 1u);
+    EXPECT_LT(weightedSpillCode(fn), weightedSpillCode(plain));
+    expectValidAllocation(fn, alloc, cfg->desc);
+
+    // The metrics run as tasks on a pool, with the same outcome
+    Function pooled = readIR("ion_speculative_pooled.ion", source);
+    ThreadPool pool(4);
+    allocator.parallelColoring(&pool);
+    Allocation pooledAlloc = allocator.allocate(pooled);
+    EXPECT_EQ(pooledAlloc.reg, alloc.reg);
+    EXPECT_EQ(pooledAlloc.spillWins, alloc.spillWins);
+}
+}
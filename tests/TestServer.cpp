@@ -0,0 +1,200 @@
+#include "ion/Pipeline.h"
+#include "ion/Reader.h"
+#include "ion/Server.h"
+#include "ion/Target.h"
+#include "ion/Writer.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+std::string expectedOutput(const std::string& source, Writer::Format format) {
+    Function fn = Reader().BuildCFGFromSource(source, "request");
+    return runPipeline(fn, {.target = &targets::Tiny, .format = format}).output;
+}
+
+std::string binaryRequest(const std::string& source) {
+    Function fn = Reader().BuildCFGFromSource(source, "request");
+    std::string out;
+    Writer writer(out, Writer::Format::Binary);
+    writer.write(fn);
+    writer.flush();
+    return out;
+}
+
+/* A binary request whose %5 is rewritten to %-5, which no text the Writer prints can express */
+std::string negativeVRegRequest() {
+    std::string data = binaryRequest("B0:\n    MOV %5, 3\n    ADD %1, %5, 2\n    RET\n");
+    const std::string vr5("\x01\x05\x00\x00\x00", 5);
+    for (size_t pos = data.find(vr5); pos != std::string::npos; pos = data.find(vr5, pos + 1))
+        data.replace(pos + 1, 4, "\xfb\xff\xff\xff");
+    return data;
+}
+
+class Client {
+public:
+    explicit Client(const std::string& path) {
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        // The server may still be binding
+        for (int attempt = 0; attempt < 200; ++attempt) {
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        ADD_FAILURE() << "could not connect to " << path;
+    }
+    ~Client() { ::close(fd); }
+
+    void send(const std::string& payload) {
+        std::string frame(4, '\0');
+        for (int i = 0; i < 4; ++i) frame[i] = static_cast<char>(payload.size() >> (8 * i) & 0xff);
+        frame += payload;
+        ASSERT_EQ(::write(fd, frame.data(), frame.size()), static_cast<ssize_t>(frame.size()));
+    }
+
+    std::pair<int, std::string> receive() {
+        unsigned char header[4];
+        readExact(reinterpret_cast<char*>(header), 4);
+        uint32_t length = header[0] | header[1] << 8 | header[2] << 16 | static_cast<uint32_t>(header[3]) << 24;
+        std::string body(length, '\0');
+        readExact(body.data(), length);
+        return {static_cast<uint8_t>(body[0]), body.substr(1)};
+    }
+
+private:
+    void readExact(char* data, size_t n) {
+        while (n > 0) {
+            ssize_t got = ::read(fd, data, n);
+            ASSERT_GT(got, 0);
+            data += got;
+            n -= static_cast<size_t>(got);
+        }
+    }
+
+    int fd = -1;
+};
+
+class ServerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = (std::filesystem::temp_directory_path() /
+                ("ion_server_" + std::to_string(::getpid()) + ".sock")).string();
+        server = std::make_unique<Server>(path, PipelineOptions{.target = &targets::Tiny}, 3);
+        thread = std::thread([this] { server->run(); });
+    }
+    void TearDown() override {
+        server->stop();
+        thread.join();
+        server.reset();
+        EXPECT_FALSE(std::filesystem::exists(path));
+    }
+
+    std::string path;
+    std::unique_ptr<Server> server;
+    std::thread thread;
+};
+
+}   // namespace
+
+TEST(ReaderSourceTest, BinaryRoundTrip) {
+    std::string source = generatedIR(7, 80);
+    Function fromText = Reader().BuildCFGFromSource(source, "f");
+    Function fromBinary = Reader().BuildCFGFromBinary(binaryRequest(source), "f");
+    ASSERT_EQ(fromBinary.blocks.size(), fromText.blocks.size());
+    EXPECT_EQ(expectedOutput(source, Writer::Format::Text),
+              [&] { return runPipeline(fromBinary, {.target = &targets::Tiny}).output; }());
+}
+
+TEST(ReaderSourceTest, RejectsMalformedBinary) {
+    std::string data = binaryRequest(generatedIR(3, 80));
+    EXPECT_THROW(Reader().BuildCFGFromBinary(data.substr(0, data.size() / 2), "f"), std::runtime_error);
+    data[4] = 99;
+    EXPECT_THROW(Reader().BuildCFGFromBinary(data, "f"), std::runtime_error);
+}
+
+TEST(ReaderSourceTest, RejectsNegativeVRegInBinary) {
+    std::string data = negativeVRegRequest();
+    try {
+        Reader().BuildCFGFromBinary(data, "f");
+        ADD_FAILURE() << "negative VR accepted";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ(e.what(), "negative virtual register in binary IR");
+    }
+}
+
+TEST_F(ServerTest, PipelinedRequestsAnsweredInOrder) {
+    Client client(path);
+    std::vector<std::string> sources;
+    for (uint64_t seed = 1; seed <= 12; ++seed) {
+        sources.push_back(generatedIR(seed, 60 + 20 * (seed % 4)));
+        client.send(seed % 3 == 0 ? binaryRequest(sources.back()) : sources.back());
+    }
+    for (size_t i = 0; i < sources.size(); ++i) {
+        SCOPED_TRACE(i);
+        auto [status, payload] = client.receive();
+        EXPECT_EQ(status, 0);
+        Writer::Format format = (i + 1) % 3 == 0 ? Writer::Format::Binary : Writer::Format::Text;
+        EXPECT_EQ(payload, expectedOutput(sources[i], format));
+    }
+}
+
+TEST_F(ServerTest, BadRequestGetsErrorAndConnectionSurvives) {
+    Client client(path);
+    client.send("IONB\x01garbage");
+    client.send(generatedIR(5, 80));
+    auto [status, message] = client.receive();
+    EXPECT_EQ(status, 1);
+    EXPECT_FALSE(message.empty());
+    auto [okStatus, payload] = client.receive();
+    EXPECT_EQ(okStatus, 0);
+    EXPECT_EQ(payload, expectedOutput(generatedIR(5, 80), Writer::Format::Text));
+}
+
+TEST_F(ServerTest, NegativeVRegGetsErrorAndServerKeepsServing) {
+    {
+        Client client(path);
+        client.send(negativeVRegRequest());
+        client.send(generatedIR(6, 80));
+        auto [status, message] = client.receive();
+        EXPECT_EQ(status, 1);
+        EXPECT_EQ(message, "negative virtual register in binary IR");
+        auto [okStatus, payload] = client.receive();
+        EXPECT_EQ(okStatus, 0);
+        EXPECT_EQ(payload, expectedOutput(generatedIR(6, 80), Writer::Format::Text));
+    }
+    Client other(path);
+    other.send(generatedIR(7, 80));
+    auto [status, payload] = other.receive();
+    EXPECT_EQ(status, 0);
+    EXPECT_EQ(payload, expectedOutput(generatedIR(7, 80), Writer::Format::Text));
+}
+
+TEST_F(ServerTest, ConcurrentClients) {
+    std::vector<std::thread> clients;
+    std::atomic<int> mismatches{0};
+    for (int c = 0; c < 4; ++c) {
+        clients.emplace_back([&, c] {
+            Client client(path);
+            for (int r = 0; r < 5; ++r) client.send(generatedIR(10 * c + r, 80));
+            for (int r = 0; r < 5; ++r) {
+                auto [status, payload] = client.receive();
+                if (status != 0 || payload != expectedOutput(generatedIR(10 * c + r, 80), Writer::Format::Text))
+                    ++mismatches;
+            }
+        });
+    }
+    for (auto& t : clients) t.join();
+    EXPECT_EQ(mismatches.load(), 0);
+}
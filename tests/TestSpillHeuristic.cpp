@@ -0,0 +1,86 @@
+#include "ion/CFG.h"
+#include "ion/Liveness.h"
+#include "ion/Reader.h"
+#include "ion/SpillHeuristic.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+Function nestedLoops() {
+    return readIR("ion_nested_loops.ion",
+        "ENTRY:\n"
+        "    MOV %1, 0\n"
+        "    MOV %2, 0\n"
+        "    JMP OUTER\n"
+        "OUTER:\n"
+        "    ADD %1, %1, 1\n"
+        "    JMP INNER\n"
+        "INNER:\n"
+        "    ADD %2, %2, 1\n"
+        "    BEQ %2, 5, LATCH, INNER\n"
+        "LATCH:\n"
+        "    BEQ %1, 10, EXIT, OUTER\n"
+        "EXIT:\n"
+        "    RET\n");
+}
+
+std::vector<std::string> labels(const Function& fn) {
+    std::vector<std::string> result;
+    for (const auto& block : fn.blocks) result.push_back(block->label);
+    return result;
+}
+
+}   // namespace
+
+TEST(SpillHeuristicTest, LoopDepthsOfNestedLoops) {
+    Function fn = nestedLoops();
+    ASSERT_EQ(labels(fn), (std::vector<std::string>{"ENTRY", "OUTER", "INNER", "LATCH", "EXIT"}));
+    EXPECT_EQ(loopDepths(fn), (std::vector<unsigned>{0, 1, 2, 1, 0}));
+}
+
+TEST(SpillHeuristicTest, LoopDepthsOfSiblingLoops) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/NestedLoop.ion");
+    std::vector<unsigned> depth = loopDepths(fn);
+    std::vector<std::string> label = labels(fn);
+    ASSERT_EQ(depth.size(), label.size());
+    for (size_t b = 0; b < depth.size(); ++b) {
+        bool inLoop = label[b] == "OUTER_BLOCK" || label[b] == "OUTER_BODY" ||
+                      label[b] == "INNER_BLOCK" || label[b] == "INNER_BODY";
+        EXPECT_EQ(depth[b], inLoop ? 1u : 0u) << label[b];
+    }
+}
+
+TEST(SpillHeuristicTest, OccurrencesWeightedByLoopDepth) {
+    Function fn = nestedLoops();
+    std::vector<float> weight = blockWeights(loopDepths(fn));
+    EXPECT_EQ(weight, (std::vector<float>{1.0f, 10.0f, 100.0f, 10.0f, 1.0f}));
+
+    std::vector<float> cost = weightedOccurrences(fn, weight, 3);
+    EXPECT_FLOAT_EQ(cost[1], 1.0f + 2 * 10.0f + 10.0f);    // MOV, ADD in OUTER, BEQ in LATCH
+    EXPECT_FLOAT_EQ(cost[2], 1.0f + 3 * 100.0f);           // MOV, ADD and BEQ in INNER
+}
+
+TEST(SpillHeuristicTest, LiveAreaSpansBlocks) {
+    Function fn = readIR("ion_live_area.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    JMP EXIT\n"
+        "EXIT:\n"
+        "    ADD %3, %1, %2\n"
+        "    RET\n");
+    LivenessAnalysis la;
+    LivenessResult lr = la.analyse(fn);
+
+    std::vector<float> area = liveArea(fn, lr, {1.0f, 1.0f}, 4);
+    EXPECT_FLOAT_EQ(area[1], 4.0f);     // from its MOV to the ADD
+    EXPECT_FLOAT_EQ(area[2], 3.0f);
+    EXPECT_FLOAT_EQ(area[3], 1.0f);     // a def nothing reads
+
+    std::vector<float> weighted = liveArea(fn, lr, {1.0f, 10.0f}, 4);
+    EXPECT_FLOAT_EQ(weighted[1], 3.0f + 10.0f);
+}
@@ -0,0 +1,78 @@
+#include "ion/CFG.h"
+#include "ion/Reader.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Stats.h"
+#include "ion/Target.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+namespace {
+
+/* Enables s for the lifetime of the guard */
+struct StatsScope {
+    explicit StatsScope(Stats& s) { stats::enable(&s); }
+    ~StatsScope() { stats::enable(nullptr); }
+};
+
+Allocation allocateSample(const TargetDesc& target) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/NestedLoop.ion");
+    return RegisterAllocator(target).allocate(fn);
+}
+
+TEST(StatsTest, Disabled_NothingRecorded) {
+    Stats s;
+    allocateSample(targets::RISC16);
+    EXPECT_EQ(s.calls(Phase::Liveness), 0u);
+    EXPECT_EQ(s.count(Counter::Instructions), 0u);
+}
+
+TEST(StatsTest, PipelineCounters) {
+    Stats s;
+    Allocation alloc;
+    {
+        StatsScope scope(s);
+        alloc = allocateSample(targets::Tiny);
+    }
+
+    EXPECT_EQ(s.calls(Phase::FindLeaders), 1u);
+    EXPECT_EQ(s.calls(Phase::BuildGraph), 1u);
+    EXPECT_EQ(s.calls(Phase::Liveness), alloc.rounds);
+    EXPECT_EQ(s.calls(Phase::UseDef), alloc.rounds);
+    EXPECT_EQ(s.calls(Phase::Pressure), alloc.rounds);
+    // A round's bank is coloured either through its graph or on the fast path
+    EXPECT_EQ(s.calls(Phase::Coloring) + s.count(Counter::FastPathBanks), alloc.rounds);
+    EXPECT_EQ(s.count(Counter::AllocationRounds), alloc.rounds);
+    EXPECT_EQ(s.count(Counter::SpilledVRegs), alloc.spilledVRegs);
+    EXPECT_EQ(s.calls(Phase::SpillCode), alloc.rounds - 1);
+    EXPECT_GE(s.count(Counter::LivenessIterations), alloc.rounds * 2u);
+    EXPECT_GT(s.count(Counter::Blocks), 0u);
+    if (s.calls(Phase::Coloring) > 0)
+        EXPECT_GT(s.count(Counter::InterferenceEdges), 0u);
+    if (alloc.spilledVRegs > 0)
+        EXPECT_GT(s.count(Counter::SpillInstructions), 0u);
+    EXPECT_GT(s.peakMemory(), 0u);
+}
+
+TEST(StatsTest, ReportFormats) {
+    Stats s;
+    s.record(Phase::Coloring, 2'500'000, 7);
+    s.add(Counter::InterferenceEdges, 42);
+
+    std::ostringstream text;
+    s.writeText(text);
+    EXPECT_NE(text.str().find("Coloring"), std::string::npos);
+    EXPECT_NE(text.str().find("2.500"), std::string::npos);
+    EXPECT_EQ(text.str().find("Liveness"), std::string::npos);
+
+    std::ostringstream json;
+    s.writeJSON(json);
+    EXPECT_NE(json.str().find("\"Coloring\": {\"calls\": 1, \"ns\": 2500000, \"allocations\": 7}"),
+              std::string::npos);
+    EXPECT_NE(json.str().find("\"interference_edges\": 42"), std::string::npos);
+    EXPECT_EQ(json.str().front(), '{');
+}
+
+}   // namespace
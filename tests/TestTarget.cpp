@@ -0,0 +1,60 @@
+#include "ion/Target.h"
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+namespace {
+
+// Presets are usable in constant expressions
+static_assert(targets::RISC32.maxRegs() == 32);
+static_assert(targets::X86_64.classOf(10000) == 1);
+static_assert(targets::X86_64.classOf(42) == 0);
+static_assert(RegMask<targets::RISC16>{}.size() == 16);
+
+TEST(TargetTest, FindPreset) {
+    ASSERT_NE(findTarget("risc16"), nullptr);
+    EXPECT_EQ(findTarget("risc16")->classes[0].numRegs, 16u);
+    EXPECT_EQ(findTarget("x86-64"), &targets::X86_64);
+    EXPECT_EQ(findTarget("no-such-target"), nullptr);
+}
+
+TEST(TargetTest, Allocatable_ExcludesReserved) {
+    EXPECT_EQ(targets::RISC16.allocatable(0), 0x7fffu);
+    EXPECT_EQ(targets::Tiny.allocatable(0), 0xfu);
+    EXPECT_EQ(targets::X86_64.numBanks(), 2u);
+}
+
+TEST(TargetTest, ParseConfig) {
+    auto cfg = parseTarget(
+        "# two banks\n"
+        "target toy\n"
+        "class gpr r 8 caller 0-3,7 reserved 7\n"
+        "class fpr f 4 bank 1\n"
+        "alias sp gpr 7\n"
+        "vregs fpr 100-199\n");
+    const TargetDesc& t = cfg->desc;
+
+    EXPECT_EQ(t.name, "toy");
+    ASSERT_EQ(t.numClasses, 2u);
+    EXPECT_EQ(t.classes[0].prefix, "r");
+    EXPECT_EQ(t.classes[0].callerSaved, 0x8fu);
+    EXPECT_EQ(t.allocatable(0), 0x7fu);
+    EXPECT_EQ(t.classes[1].bank, 1u);
+    EXPECT_EQ(t.aliasOf(0, 7), "sp");
+    EXPECT_EQ(t.classOf(150), 1);
+    EXPECT_EQ(t.classOf(200), 0);
+}
+
+TEST(TargetTest, ParseConfig_Errors) {
+    EXPECT_THROW(parseTarget("target empty\n"), std::runtime_error);
+    EXPECT_THROW(parseTarget("class gpr r 65\n"), std::runtime_error);
+    EXPECT_THROW(parseTarget("class gpr r 4\nalias sp fpr 1\n"), std::runtime_error);
+    EXPECT_THROW(parseTarget("class gpr r 4\nclass gpr32 w 8\n"), std::runtime_error);
+    EXPECT_THROW(parseTarget("class gpr r 2 reserved 0-1\n"), std::runtime_error);
+    EXPECT_THROW(parseTarget("register gpr\n"), std::runtime_error);
+    EXPECT_THROW(parseTarget("class gpr r 4\nvregs gpr 0-2147483648\n"), std::runtime_error);
+    EXPECT_THROW(parseTarget("class gpr r 4\nvregs gpr 4294967295\n"), std::runtime_error);
+    EXPECT_NO_THROW(parseTarget("class gpr r 4\nvregs gpr 0-2147483647\n"));
+}
+
+}
@@ -0,0 +1,61 @@
+#include "ion/ThreadPool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+TEST(ThreadPoolTest, RunsEveryTask) {
+    ThreadPool pool(4);
+    std::vector<int> hit(1000, 0);
+    pool.parallelFor(hit.size(), [&](size_t i) { hit[i] += 1; });
+    for (int h : hit) EXPECT_EQ(h, 1);
+}
+
+TEST(ThreadPoolTest, NestedGroupsDoNotDeadlock) {
+    // One worker: the outer task must run its own subtasks while it waits
+    ThreadPool pool(1);
+    std::atomic<int> sum{0};
+    pool.parallelFor(4, [&](size_t) {
+        pool.parallelFor(8, [&](size_t j) { sum += static_cast<int>(j); });
+    });
+    EXPECT_EQ(sum.load(), 4 * 28);
+}
+
+TEST(ThreadPoolTest, IdleWorkersSteal) {
+    ThreadPool pool(4);
+    std::mutex mutex;
+    std::set<std::thread::id> ran;
+    std::atomic<int> started{0};
+    // Submitted from one task, so all land in one deque; the others must steal to finish
+    pool.parallelFor(1, [&](size_t) {
+        pool.parallelFor(4, [&](size_t) {
+            ++started;
+            while (started.load() < 4) std::this_thread::yield();
+            std::lock_guard<std::mutex> lock(mutex);
+            ran.insert(std::this_thread::get_id());
+        });
+    });
+    EXPECT_GE(ran.size(), 4u);
+}
+
+TEST(ThreadPoolTest, ExceptionRethrownByWait) {
+    ThreadPool pool(2);
+    ThreadPool::TaskGroup group;
+    std::atomic<int> finished{0};
+    for (int i = 0; i < 10; ++i) {
+        pool.submit(group, [&, i] {
+            if (i == 3) throw std::runtime_error("task 3");
+            ++finished;
+        });
+    }
+    EXPECT_THROW(pool.wait(group), std::runtime_error);
+    EXPECT_EQ(finished.load(), 9);
+}
+
+}   // namespace
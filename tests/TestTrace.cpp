@@ -0,0 +1,118 @@
+#include "ion/CFG.h"
+#include "ion/Reader.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Target.h"
+#include "ion/Trace.h"
+#include "utils/h/IRGenerator.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+namespace {
+
+struct TraceScope {
+    explicit TraceScope(TraceRecorder& r) { trace::enable(&r); }
+    ~TraceScope() { trace::enable(nullptr); }
+};
+
+size_t occurrences(const std::string& s, const std::string& needle) {
+    size_t n = 0;
+    for (size_t pos = s.find(needle); pos != std::string::npos; pos = s.find(needle, pos + 1)) ++n;
+    return n;
+}
+
+TEST(TraceTest, Disabled_NothingRecorded) {
+    TraceRecorder recorder;
+    { trace::Span span("Idle"); }
+    EXPECT_EQ(recorder.numEvents(), 0u);
+}
+
+TEST(TraceTest, PipelineSpans) {
+    TraceRecorder recorder;
+    Allocation alloc;
+    {
+        TraceScope scope(recorder);
+        Reader reader;
+        Function fn = reader.BuildCFG("docs/iON_IR/NestedLoop.ion");
+        alloc = RegisterAllocator(targets::Tiny).allocate(fn);
+    }
+    std::ostringstream os;
+    recorder.writeJSON(os);
+    std::string json = os.str();
+
+    for (const char* name : {"FindLeaders", "BuildGraph", "computeUseDef", "Liveness", "Pressure",
+                             "Allocate"}) {
+        SCOPED_TRACE(name);
+        EXPECT_NE(json.find(std::string("\"name\":\"") + name + "\""), std::string::npos);
+    }
+    EXPECT_EQ(occurrences(json, "\"name\":\"Round\""), alloc.rounds);
+    EXPECT_NE(json.find("\"round\":1}"), std::string::npos);
+    EXPECT_NE(json.find("\"function\":\"NestedLoop\""), std::string::npos);
+    EXPECT_EQ(json.find("\"function\":\"\""), std::string::npos);
+    EXPECT_EQ(json.rfind("]}\n"), json.size() - 3);
+}
+
+TEST(TraceTest, HighPressure_GraphSpans) {
+    // Loops keep the local allocator out, and this many values exceed Tiny's registers
+    GeneratorOptions gen;
+    gen.seed = 5;
+    gen.instructions = 400;
+    gen.loopDepth = 2;
+    gen.pressure = 16;
+    TraceRecorder recorder;
+    Allocation alloc;
+    {
+        TraceScope scope(recorder);
+        Reader reader;
+        Function fn = reader.BuildCFGFromSource(generateIR(gen), "Pressure");
+        alloc = RegisterAllocator(targets::Tiny).allocate(fn);
+    }
+    ASSERT_GT(alloc.spilledVRegs, 0u);
+    std::ostringstream os;
+    recorder.writeJSON(os);
+    std::string json = os.str();
+
+    for (const char* name : {"Liveness", "Pressure", "InterferenceGraph", "Coloring", "SpillCode", "Allocate"}) {
+        SCOPED_TRACE(name);
+        EXPECT_NE(json.find(std::string("\"name\":\"") + name + "\""), std::string::npos);
+    }
+    EXPECT_EQ(occurrences(json, "\"name\":\"Round\""), alloc.rounds);
+}
+
+TEST(TraceTest, ThreadsGetOwnTracks) {
+    TraceRecorder recorder;
+    {
+        TraceScope scope(recorder);
+        trace::FunctionScope fn("f");
+        { trace::Span span("Main"); }
+        std::thread worker([] {
+            trace::FunctionScope fn("g");
+            trace::Span span("Worker");
+        });
+        worker.join();
+    }
+    EXPECT_EQ(recorder.numEvents(), 2u);
+
+    std::ostringstream os;
+    recorder.writeJSON(os);
+    std::string json = os.str();
+    EXPECT_EQ(occurrences(json, "\"thread_name\""), 2u);
+    EXPECT_NE(json.find("\"name\":\"Worker\",\"cat\":\"ion\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(json.find("\"function\":\"g\""), std::string::npos);
+}
+
+TEST(TraceTest, FunctionNamesEscaped) {
+    TraceRecorder recorder;
+    {
+        TraceScope scope(recorder);
+        trace::FunctionScope fn("a\"b\\c");
+        trace::Span span("Span");
+    }
+    std::ostringstream os;
+    recorder.writeJSON(os);
+    EXPECT_NE(os.str().find("\"function\":\"a\\\"b\\\\c\""), std::string::npos);
+}
+
+}   // namespace
@@ -0,0 +1,186 @@
+#include "ion/CFG.h"
+#include "ion/Peephole.h"
+#include "ion/Pipeline.h"
+#include "ion/Reader.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Target.h"
+#include "ion/Verifier.h"
+#include "utils/h/IRGenerator.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Spills with two registers; LOOP is a merge, so its reloads depend on both of its predecessors
+const char* kPressure =
+    "ENTRY:\n"
+    "    MOV %1, 1\n"
+    "    MOV %2, 2\n"
+    "    MOV %3, 3\n"
+    "    JMP LOOP\n"
+    "LOOP:\n"
+    "    ADD %4, %1, %2\n"
+    "    ADD %5, %4, %3\n"
+    "    ADD %6, %5, %1\n"
+    "    BEQ %6, 0, EXIT, LOOP\n"
+    "EXIT:\n"
+    "    RET\n";
+
+/* Deletes the first spill store; returns false if there is none */
+bool dropSpillStore(Function& fn) {
+    for (auto& block : fn.blocks) {
+        auto& code = block->instructions;
+        auto it = std::find_if(code.begin(), code.end(),
+                               [](const Instruction& instr) { return instr.spill && instr.op == OpCode::STORE; });
+        if (it != code.end()) {
+            code.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string joined(const std::vector<std::string>& errors) {
+    std::string result;
+    for (const auto& e : errors) result += e + "\n";
+    return result;
+}
+
+}   // namespace
+
+TEST(VerifierTest, SamplePrograms_Pass) {
+    for (const char* file : {"docs/iON_IR/StraightLineDAG.ion", "docs/iON_IR/SimpleLoop.ion",
+                             "docs/iON_IR/NestedLoop.ion", "docs/iON_IR/Diamond.ion"}) {
+        SCOPED_TRACE(file);
+        Reader reader;
+        Function fn = reader.BuildCFG(file);
+        Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+        EXPECT_EQ(joined(verifyAllocation(fn, alloc, targets::RISC16)), "");
+    }
+}
+
+TEST(VerifierTest, SpillCode_Passes) {
+    Function fn = readIR("ion_verify_pressure.ion", kPressure);
+    auto cfg = parseTarget("class gpr r 2\n");
+    Allocation alloc = RegisterAllocator(cfg->desc).allocate(fn);
+    ASSERT_GT(alloc.numSpillSlots, 0);
+    EXPECT_EQ(joined(verifyAllocation(fn, alloc, cfg->desc)), "");
+}
+
+TEST(VerifierTest, GeneratedPrograms_Pass) {
+    for (unsigned seed : {1u, 2u, 3u}) {
+        SCOPED_TRACE(seed);
+        GeneratorOptions opts;
+        opts.seed = seed;
+        opts.instructions = 2000;
+        opts.loopDepth = 3;
+        opts.pressure = 24;
+        std::string source = generateIR(opts);
+        for (bool speculative : {false, true}) {
+            Function fn = readIR("ion_verify_generated.ion", source);
+            RegisterAllocator allocator(targets::RISC16);
+            allocator.speculativeSpills(speculative);
+            Allocation alloc = allocator.allocate(fn);
+            EXPECT_EQ(joined(verifyAllocation(fn, alloc, targets::RISC16)), "");
+        }
+    }
+}
+
+TEST(VerifierTest, PeepholeOutput_CheckedAndCorruptionReported) {
+    GeneratorOptions opts;
+    opts.seed = 4;
+    opts.instructions = 2000;
+    opts.loopDepth = 3;
+    opts.pressure = 24;
+    Function fn = readIR("ion_verify_peephole.ion", generateIR(opts));
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    PeepholeStats stats = runPeephole(fn, alloc, targets::RISC16);
+    ASSERT_GT(stats.reloadsToCopies, 0u);
+    ASSERT_GT(stats.instructionsRemoved(), 0u);
+    EXPECT_EQ(joined(verifyAllocation(fn, alloc, targets::RISC16)), "");
+
+    // A forward across a clobber, the mistake the peephole pass must not make: write the register of a
+    // reload turned into a copy just before the copy reads it
+    for (auto& block : fn.blocks) {
+        auto& code = block->instructions;
+        for (size_t i = 0; i < code.size(); ++i) {
+            auto* src = std::get_if<VReg>(&code[i].operands[0]);
+            if (code[i].op != OpCode::MOV || code[i].spill || !src ||
+                alloc.origin[code[i].def->id] != alloc.origin[src->id])
+                continue;
+            for (size_t w = 0; w < alloc.reg.size(); ++w) {
+                if (alloc.reg[w] != alloc.reg[src->id] || alloc.regClass[w] != alloc.regClass[src->id] ||
+                    alloc.origin[w] != static_cast<int>(w))
+                    continue;
+                int read = src->id;
+                code.insert(code.begin() + static_cast<std::ptrdiff_t>(i),
+                            Instruction{.op = OpCode::MOV, .def = VReg{static_cast<int>(w)}, .labels = {},
+                                        .operands = {7, std::monostate{}}, .spill = false});
+                std::vector<std::string> errors = verifyAllocation(fn, alloc, targets::RISC16);
+                std::string at = block->label + "[" + std::to_string(i + 1) + "]: %" + std::to_string(read);
+                EXPECT_TRUE(std::ranges::any_of(errors, [&](const std::string& e) { return e.find(at) != std::string::npos; }))
+                    << testing::PrintToString(errors);
+                return;
+            }
+        }
+    }
+    FAIL() << "no reload was turned into a copy";
+}
+
+TEST(VerifierTest, SharedRegister_Reported) {
+    Function fn = readIR("ion_verify_shared.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    ADD %3, %1, %2\n"
+        "    RET\n");
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    ASSERT_NE(alloc.reg[1], alloc.reg[2]);
+    alloc.reg[2] = alloc.reg[1];
+
+    std::vector<std::string> errors = verifyAllocation(fn, alloc, targets::RISC16);
+    ASSERT_EQ(errors.size(), 1u) << joined(errors);
+    EXPECT_NE(errors[0].find("ENTRY[2]: %1 reads"), std::string::npos) << errors[0];
+    EXPECT_NE(errors[0].find("which holds %2"), std::string::npos) << errors[0];
+}
+
+TEST(VerifierTest, DroppedSpillStore_Reported) {
+    Function fn = readIR("ion_verify_dropped.ion", kPressure);
+    auto cfg = parseTarget("class gpr r 2\n");
+    Allocation alloc = RegisterAllocator(cfg->desc).allocate(fn);
+    ASSERT_TRUE(dropSpillStore(fn));
+
+    std::vector<std::string> errors = verifyAllocation(fn, alloc, cfg->desc);
+    ASSERT_FALSE(errors.empty());
+    EXPECT_NE(errors[0].find("reads slot"), std::string::npos) << errors[0];
+    EXPECT_LE(verifyAllocation(fn, alloc, cfg->desc, 1).size(), 1u);
+}
+
+TEST(VerifierTest, UndefinedVR_NotChecked) {
+    // %1 is read before anything defines it, which is the input's problem, not the allocator's
+    Function fn = readIR("ion_verify_undefined.ion",
+        "ENTRY:\n"
+        "    MOV %2, 2\n"
+        "    ADD %3, %1, %2\n"
+        "    RET\n");
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    alloc.reg[1] = alloc.reg[2];
+    EXPECT_EQ(joined(verifyAllocation(fn, alloc, targets::RISC16)), "");
+}
+
+TEST(VerifierTest, Pipeline_FailsBadAllocation) {
+    Function fn = readIR("ion_verify_pipeline.ion", kPressure);
+    auto cfg = parseTarget("class gpr r 2\n");
+    PipelineOptions opts{.target = &cfg->desc};
+    opts.afterAllocation = [](Function& f, const Allocation&) { dropSpillStore(f); };
+    EXPECT_THROW(runPipeline(fn, opts), std::runtime_error);
+
+    Function unchecked = readIR("ion_verify_pipeline.ion", kPressure);
+    opts.verify = false;
+    EXPECT_NO_THROW(runPipeline(unchecked, opts));
+}
@@ -0,0 +1,80 @@
+#include "ion/CFG.h"
+#include "ion/Liveness.h"
+#include "ion/Reader.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Target.h"
+#include "ion/Visualize.h"
+
+#include "utils/IRFixtures.h"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <sstream>
+
+namespace {
+
+Function diamond() {
+    return readIR("ion_dot.ion",
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    BEQ %1, 0, LEFT, RIGHT\n"
+        "LEFT:\n"
+        "    ADD %2, %1, 1\n"
+        "    JMP EXIT\n"
+        "RIGHT:\n"
+        "    MOV %2, 2\n"
+        "    JMP EXIT\n"
+        "EXIT:\n"
+        "    ADD %3, %2, %1\n"
+        "    RET\n");
+}
+
+TEST(VisualizeTest, BuildCFG_WritesNoFile) {
+    std::filesystem::remove("test.dot");
+    Reader reader;
+    reader.BuildCFG("docs/iON_IR/SimpleLoop.ion");
+    EXPECT_FALSE(std::filesystem::exists("test.dot"));
+}
+
+TEST(VisualizeTest, CFG_EdgesAndLabels) {
+    Function fn = diamond();
+    std::ostringstream os;
+    writeCFGDot(os, fn);
+    std::string dot = os.str();
+
+    EXPECT_EQ(dot.rfind("digraph CFG {", 0), 0u);
+    EXPECT_NE(dot.find("b0 [label=\"ENTRY\"];"), std::string::npos);
+    EXPECT_NE(dot.find("b0 -> b1;"), std::string::npos);
+    EXPECT_NE(dot.find("b0 -> b2;"), std::string::npos);
+    EXPECT_NE(dot.find("b2 -> b3;"), std::string::npos);
+    EXPECT_EQ(dot.find("ADD"), std::string::npos);
+}
+
+TEST(VisualizeTest, CFG_Annotations) {
+    Function fn = diamond();
+    LivenessResult lr = LivenessAnalysis().analyse(fn);
+    std::ostringstream os;
+    writeCFGDot(os, fn, {.instructions = true, .liveness = &lr});
+    std::string dot = os.str();
+
+    EXPECT_NE(dot.find("\"ENTRY:\\lin:\\l    MOV %1, 1\\l    BEQ %1, 0, LEFT, RIGHT\\lout: %1\\l\""),
+              std::string::npos);
+    EXPECT_NE(dot.find("in: %1 %2\\l    ADD %3, %2, %1"), std::string::npos);
+}
+
+TEST(VisualizeTest, Coloring_NodesFilledByRegister) {
+    Function fn = diamond();
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    std::ostringstream os;
+    writeColoringDot(os, fn, alloc, targets::RISC16);
+    std::string dot = os.str();
+
+    EXPECT_EQ(dot.rfind("graph bank0 {", 0), 0u);
+    EXPECT_NE(dot.find("style=filled"), std::string::npos);
+    EXPECT_NE(dot.find("v1 -- v2;"), std::string::npos);
+    std::string reg1 = "r" + std::to_string(alloc.reg[1]);
+    EXPECT_NE(dot.find("v1 [label=\"%1\\n" + reg1 + "\""), std::string::npos);
+}
+
+}   // namespace
@@ -0,0 +1,157 @@
+#include "ion/CFG.h"
+#include "ion/Reader.h"
+#include "ion/RegisterAllocator.h"
+#include "ion/Target.h"
+#include "ion/Writer.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace {
+
+TEST(WriterTest, VirtualText_RoundTrip) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/StraightLineDAG.ion");
+    std::string out;
+    {
+        Writer writer(out);
+        writer.write(fn);
+    }
+    EXPECT_EQ(out,
+        "INIT_BLOCK:\n"
+        "    MOV %1, 10\n"
+        "    MOV %2, 20\n"
+        "    JMP BLOCK_B\n"
+        "\n"
+        "BLOCK_B:\n"
+        "    ADD %3, %1, %2\n"
+        "    BEQ %3, 30, BLOCK_C, BLOCK_X\n"
+        "\n"
+        "BLOCK_C:\n"
+        "    RET\n"
+        "\n"
+        "BLOCK_X:\n"
+        "    RET\n"
+        "\n");
+}
+
+TEST(WriterTest, AllocatedText) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/SimpleLoop.ion");
+    Allocation alloc = RegisterAllocator(targets::RISC16).allocate(fn);
+    std::string out;
+    {
+        Writer writer(out);
+        writer.write(fn, alloc, targets::RISC16);
+    }
+    EXPECT_EQ(out.find('%'), std::string::npos);
+    EXPECT_NE(out.find("    ADD r0, r0, 1\n"), std::string::npos) << out;
+}
+
+TEST(WriterTest, SpillCodeAndRemovedCopies) {
+    Function fn;
+    fn.name = "spill";
+    auto block = std::make_unique<BasicBlock>();
+    block->id = 0;
+    block->label = "ENTRY";
+    block->instructions = {
+        Instruction{.op = OpCode::MOV, .def = VReg{1}, .operands = {VReg{2}, std::monostate{}}},
+        Instruction{.op = OpCode::STORE, .operands = {VReg{1}, 3}, .spill = true},
+        Instruction{.op = OpCode::RET},
+    };
+    fn.labelToBlock["ENTRY"] = block.get();
+    fn.blocks.push_back(std::move(block));
+
+    Allocation alloc;
+    alloc.reg = {-1, 2, 2};
+    alloc.regClass = {0, 0, 0};
+    alloc.origin = {0, 1, 2};
+
+    std::string out;
+    {
+        Writer writer(out);
+        writer.write(fn, alloc, targets::RISC16);
+    }
+    EXPECT_EQ(out, "ENTRY:\n    STORE r2, [slot3]\n    RET\n\n");
+}
+
+TEST(WriterTest, SpilledText_ReadsBack) {
+    Reader reader;
+    Function fn = reader.BuildCFGFromSource(
+        "ENTRY:\n"
+        "    MOV %1, 1\n"
+        "    MOV %2, 2\n"
+        "    MOV %3, 3\n"
+        "    ADD %4, %1, %2\n"
+        "    ADD %5, %4, %3\n"
+        "    ADD %6, %5, %1\n"
+        "    RET\n", "spilled");
+    auto cfg = parseTarget("class gpr r 2\n");
+    Allocation alloc = RegisterAllocator(cfg->desc).allocate(fn);
+    ASSERT_GT(alloc.numSpillSlots, 0);
+
+    std::string out;
+    {
+        Writer writer(out);
+        writer.write(fn);
+    }
+    ASSERT_NE(out.find("[slot0]"), std::string::npos) << out;
+    Function back = reader.BuildCFGFromSource(out, "spilled");
+    std::string again;
+    {
+        Writer writer(again);
+        writer.write(back);
+    }
+    EXPECT_EQ(again, out);
+    // Its spill slots are taken, so it cannot be allocated again
+    EXPECT_THROW(RegisterAllocator(cfg->desc).allocate(back), std::runtime_error);
+}
+
+TEST(WriterTest, WriteErrorsReported) {
+    Function fn;
+    auto block = std::make_unique<BasicBlock>();
+    block->id = 0;
+    block->label = std::string(1000, 'L');  // larger than the buffer, so it bypasses it
+    block->instructions = {Instruction{.op = OpCode::RET}};
+    fn.labelToBlock[block->label] = block.get();
+    fn.blocks.push_back(std::move(block));
+
+    std::FILE* readOnly = std::fopen("/dev/null", "r");
+    ASSERT_NE(readOnly, nullptr);
+    {
+        Writer writer(readOnly, Writer::Format::Text, 256);
+        EXPECT_THROW(writer.write(fn), std::runtime_error);
+    }
+    std::fclose(readOnly);
+}
+
+TEST(WriterTest, SmallBufferFlushes) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/NestedLoop.ion");
+    std::string small, large;
+    {
+        Writer a(small, Writer::Format::Text, 1);
+        a.write(fn);
+        Writer b(large);
+        b.write(fn);
+    }
+    EXPECT_EQ(small, large);
+}
+
+TEST(WriterTest, Binary_Header) {
+    Reader reader;
+    Function fn = reader.BuildCFG("docs/iON_IR/Diamond.ion");
+    std::string out;
+    {
+        Writer writer(out, Writer::Format::Binary);
+        writer.write(fn);
+    }
+    ASSERT_GE(out.size(), 9u);
+    EXPECT_EQ(out.substr(0, 4), "IONB");
+    EXPECT_EQ(static_cast<uint8_t>(out[4]), kBinaryVersion);
+    EXPECT_EQ(static_cast<uint8_t>(out[5]), fn.blocks.size());
+}
+
+}
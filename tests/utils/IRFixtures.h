@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ion/CFG.h"
+#include "ion/Reader.h"
+#include "utils/h/IRGenerator.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+/* Writes source to a temporary .ion file and builds its CFG */
+inline Function readIR(const std::string& name, const std::string& source) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::ofstream(path) << source;
+    Reader reader;
+    return reader.BuildCFG(path.string());
+}
+
+/* A generated program of about the given size, the generator's other options left at their defaults */
+inline std::string generatedIR(uint64_t seed, size_t instructions) {
+    GeneratorOptions opts;
+    opts.seed = seed;
+    opts.instructions = instructions;
+    return generateIR(opts);
+}